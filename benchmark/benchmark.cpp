@@ -0,0 +1,1229 @@
+﻿// Benchmark bez okna do uruchamiania na maszynach CI bez GPU (np. Mesa llvmpipe).
+// Kontekst OpenGL 3.3 core powstaje przez EGL (pbuffer albo kontekst bez powierzchni), a sceny
+// z grafika_2 (kolorowy sześcian), grafika_5 (oświetlony sześcian z podłogą) i grafika_7 (model OBJ)
+// rysowane są do FBO przez N klatek po stałych ścieżkach kamery. Wynik - czasy klatek i liczniki - w JSON.
+//
+// --backend software rysuje sceny rasteryzerem programowym (common/soft_raster.h) bez kontekstu GL,
+// --backend compare rysuje jedną klatkę obiema ścieżkami i porównuje piksele: scena jest "failed", gdy
+// więcej niż --tolerance pikseli różni się o ponad CHANNEL_TOLERANCE na którymś kanale.
+// --backend raytrace śledzi promienie na CPU (common/ray_tracer.h, BVH z common/bvh.h) dla scen lit i obj;
+// raport zawiera czas budowy BVH i przepustowość w milionach promieni na sekundę (pierwotne + cienia).
+// Każda scena raportuje też liczbę wywołań malloc na mierzoną klatkę (common/alloc_counter.h).
+//
+// Użycie (z katalogu głównego repozytorium):
+//   benchmark [--frames N] [--warmup N] [--width W] [--height H] [--scene cube|lit|obj]...
+//             [--obj plik.obj] [--root katalog] [--out wynik.json]
+//             [--backend gl|software|compare|raytrace] [--threads N] [--tolerance 0.01] [--png-dir katalog]
+// Brak pliku OBJ oznacza scenę "skipped"; błąd shadera lub GL to "failed" i kod wyjścia 2.
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "../common/obj_model.h"
+#include "../common/mesh_normals.h"
+#include "../common/soft_raster.h"
+#include "../common/ray_tracer.h"
+#include "../common/png_writer.h"
+#define ALLOC_COUNTER_IMPLEMENTATION
+#include "../common/alloc_counter.h"
+
+// Różnica kanału (0-255), od której piksel GL i programowy uznawany jest za różny
+const int CHANNEL_TOLERANCE = 16;
+// Położenie kamery na ścieżce dla klatki porównywanej w --backend compare
+const float COMPARE_T = 0.125f;
+const glm::vec3 CLEAR_COLOR(0.1f, 0.1f, 0.12f);
+
+struct Options {
+    int frames = 300;
+    int warmup = 20;
+    int width = 800;
+    int height = 600;
+    std::vector<std::string> scenes;
+    std::string root = ".";
+    std::string objPath = "grafika_7/stół3.obj";
+    std::string outPath;
+    std::string backend = "gl";
+    std::string pngDir;
+    double tolerance = 0.01;
+    unsigned threads = 0;
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--frames") options.frames = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--warmup") options.warmup = std::max(0, std::atoi(value.c_str()));
+        else if (arg == "--width") options.width = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--height") options.height = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--scene") options.scenes.push_back(value);
+        else if (arg == "--root") options.root = value;
+        else if (arg == "--obj") options.objPath = value;
+        else if (arg == "--out") options.outPath = value;
+        else if (arg == "--backend") options.backend = value;
+        else if (arg == "--png-dir") options.pngDir = value;
+        else if (arg == "--tolerance") options.tolerance = std::atof(value.c_str());
+        else if (arg == "--threads") options.threads = (unsigned)std::max(0, std::atoi(value.c_str()));
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.scenes.empty())
+        options.scenes = { "cube", "lit", "obj" };
+    if (options.backend != "gl" && options.backend != "software" && options.backend != "compare" && options.backend != "raytrace") {
+        std::cerr << "Unknown backend: " << options.backend << std::endl;
+        return false;
+    }
+    return true;
+}
+
+struct HeadlessContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+// Najpierw domyślny wyświetlacz EGL, a gdy go nie ma (brak X/Wayland) - platforma surfaceless z Mesy
+EGLDisplay openDisplay() {
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+        return display;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay)
+        return EGL_NO_DISPLAY;
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+        return display;
+    return EGL_NO_DISPLAY;
+}
+
+bool createHeadlessContext(HeadlessContext& headless) {
+    headless.display = openDisplay();
+    if (headless.display == EGL_NO_DISPLAY) {
+        std::cerr << "Cannot open an EGL display" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(headless.display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        std::cerr << "No EGL config with OpenGL and pbuffer support" << std::endl;
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    headless.context = eglCreateContext(headless.display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (headless.context == EGL_NO_CONTEXT) {
+        std::cerr << "Cannot create an OpenGL 3.3 core context" << std::endl;
+        return false;
+    }
+
+    // Rysujemy do własnego FBO, więc pbuffer jest potrzebny tylko, jeśli sterownik nie ma EGL_KHR_surfaceless_context
+    const EGLint pbufferAttribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+    headless.surface = eglCreatePbufferSurface(headless.display, config, pbufferAttribs);
+    if (!eglMakeCurrent(headless.display, headless.surface, headless.surface, headless.context)) {
+        std::cerr << "eglMakeCurrent failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void destroyHeadlessContext(HeadlessContext& headless) {
+    if (headless.display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (headless.surface != EGL_NO_SURFACE)
+        eglDestroySurface(headless.display, headless.surface);
+    if (headless.context != EGL_NO_CONTEXT)
+        eglDestroyContext(headless.display, headless.context);
+    eglTerminate(headless.display);
+}
+
+bool readTextFile(const std::string& path, std::string& text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    text = buffer.str();
+    return true;
+}
+
+GLuint compileShader(GLenum type, const std::string& source, std::string& error) {
+    GLuint shader = glCreateShader(type);
+    const GLchar* text = source.c_str();
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        error = log;
+    }
+    return shader;
+}
+
+GLuint linkProgram(const std::string& vertexSource, const std::string& fragmentSource,
+    const std::vector<const char*>& attribs, std::string& error) {
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, error);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource, error);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    for (size_t i = 0; i < attribs.size(); ++i)
+        glBindAttribLocation(program, (GLuint)i, attribs[i]);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        error += log;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Szachownica zamiast metal.jpg - wynik nie zależy od plików graficznych ani dekodera
+const int CHECKER_SIZE = 256;
+
+std::vector<unsigned char> checkerPixels() {
+    const int size = CHECKER_SIZE;
+    std::vector<unsigned char> pixels(size * size * 3);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            unsigned char value = ((x / 32 + y / 32) % 2) ? 200 : 90;
+            unsigned char* pixel = &pixels[(y * size + x) * 3];
+            pixel[0] = value;
+            pixel[1] = value;
+            pixel[2] = (unsigned char)(value + 30);
+        }
+    }
+    return pixels;
+}
+
+GLuint createCheckerTexture() {
+    const int size = CHECKER_SIZE;
+    std::vector<unsigned char> pixels = checkerPixels();
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, size, size, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+// Ścieżka kamery: pełny obrót wokół celu w trakcie pomiaru, z lekkim falowaniem wysokości
+glm::mat4 orbitCamera(float t, const glm::vec3& target, float radius, float height, glm::vec3& eye) {
+    float angle = t * 6.2831853f;
+    eye = target + glm::vec3(std::sin(angle) * radius, height + 0.3f * radius * std::sin(angle * 2.0f), std::cos(angle) * radius);
+    return glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+struct FrameCounters {
+    unsigned drawCalls = 0;
+    unsigned long long triangles = 0;
+    unsigned long long uploadBytes = 0;
+};
+
+class Scene {
+public:
+    virtual ~Scene() {}
+    // false i opis w `error`; `skipped` oznacza brak danych wejściowych, a nie błąd
+    virtual bool setup(const Options& options, std::string& error, bool& skipped) = 0;
+    // t w [0, 1) - położenie na ścieżce kamery
+    virtual void render(float t, FrameCounters& counters) = 0;
+
+    // Ta sama scena dla rasteryzera programowego; domyślnie nieobsługiwana
+    virtual bool setupSoftware(const Options&, std::string& error, bool& skipped) {
+        error = "not supported by the software backend";
+        skipped = true;
+        return false;
+    }
+
+    virtual void renderSoftware(float, SoftRasterizer&, SoftFramebuffer&, FrameCounters&) {
+    }
+
+    // Śledzenie promieni: setup przekazuje geometrię do tracer.setMesh (tam budowane jest BVH)
+    virtual bool setupRayTrace(const Options&, RayTracer&, std::string& error, bool& skipped) {
+        error = "not supported by the ray tracing backend";
+        skipped = true;
+        return false;
+    }
+
+    virtual void renderRayTrace(float, RayTracer&, SoftFramebuffer&, FrameCounters&) {
+    }
+};
+
+// Shadery dla SoftRasterizer odpowiadające shaderom GL scen
+struct ColorShader {
+    static constexpr int VARYINGS = 3;
+    glm::mat4 mvp;
+
+    glm::vec4 vertex(const float* in, float* varyings) const {
+        varyings[0] = in[3];
+        varyings[1] = in[4];
+        varyings[2] = in[5];
+        return mvp * glm::vec4(in[0], in[1], in[2], 1.0f);
+    }
+
+    glm::vec3 fragment(const float* varyings) const {
+        return glm::vec3(varyings[0], varyings[1], varyings[2]);
+    }
+};
+
+struct TexturedShader {
+    static constexpr int VARYINGS = 2;
+    glm::mat4 mvp;
+    const SoftTexture* texture = nullptr;
+    // Przesunięcie UV w wierzchołku; bez UV atrybut GL ma wartość domyślną (0, 0)
+    int texCoordOffset = -1;
+
+    glm::vec4 vertex(const float* in, float* varyings) const {
+        varyings[0] = texCoordOffset >= 0 ? in[texCoordOffset] : 0.0f;
+        varyings[1] = texCoordOffset >= 0 ? in[texCoordOffset + 1] : 0.0f;
+        return mvp * glm::vec4(in[0], in[1], in[2], 1.0f);
+    }
+
+    glm::vec3 fragment(const float* varyings) const {
+        return texture->sample(glm::vec2(varyings[0], varyings[1]));
+    }
+};
+
+SoftTexture createSoftCheckerTexture() {
+    SoftTexture texture;
+    texture.width = CHECKER_SIZE;
+    texture.height = CHECKER_SIZE;
+    texture.rgb = checkerPixels();
+    return texture;
+}
+
+// grafika_2: pozycja i kolor, 6 floatów na wierzchołek
+const GLfloat cubeVertices[] = {
+    -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.0f,   0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f,   0.5f, 0.5f, -0.5f, 1.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, -0.5f, 1.0f, 1.0f, 0.0f,     -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,   -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 0.0f,    0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f,    0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f,      -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f,    -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
+    -0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,     -0.5f, 0.5f, -0.5f, 1.0f, 1.0f, 0.0f,   -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,   -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 0.0f,   -0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,      0.5f, 0.5f, -0.5f, 1.0f, 1.0f, 0.0f,    0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+    0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,    0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 0.0f,    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,   0.5f, -0.5f, -0.5f, 1.0f, 1.0f, 0.0f,   0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f,
+    0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f,     -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 0.0f,   -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+    -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,    0.5f, 0.5f, -0.5f, 1.0f, 1.0f, 0.0f,    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,      -0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,    -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+};
+
+// grafika_2: sześcian z kolorami wierzchołków, 6 floatów na wierzchołek
+class CubeScene : public Scene {
+public:
+    // Nazwy zostają 0 przy backendach CPU - bez kontekstu GL wskaźniki funkcji GLEW są puste
+    ~CubeScene() {
+        if (program != 0)
+            glDeleteProgram(program);
+        if (vbo != 0)
+            glDeleteBuffers(1, &vbo);
+        if (vao != 0)
+            glDeleteVertexArrays(1, &vao);
+    }
+
+    bool setup(const Options& options, std::string& error, bool&) override {
+        const char* vertexSource = R"glsl(
+#version 150 core
+in vec3 position;
+in vec3 color;
+out vec3 Color;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+
+void main() {
+    Color = color;
+    gl_Position = proj * view * model * vec4(position, 1.0);
+}
+)glsl";
+        const char* fragmentSource = R"glsl(
+#version 150 core
+in vec3 Color;
+out vec4 outColor;
+void main() {
+    outColor = vec4(Color, 1.0);
+}
+)glsl";
+        program = linkProgram(vertexSource, fragmentSource, { "position", "color" }, error);
+        if (!program)
+            return false;
+        glBindFragDataLocation(program, 0, "outColor");
+        glLinkProgram(program);
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(1);
+
+        glUseProgram(program);
+        uniModel = glGetUniformLocation(program, "model");
+        uniView = glGetUniformLocation(program, "view");
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.1f, 100.0f);
+        glUniformMatrix4fv(glGetUniformLocation(program, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+        return true;
+    }
+
+    void render(float t, FrameCounters& counters) override {
+        glm::vec3 eye;
+        glm::mat4 view = orbitCamera(t, glm::vec3(0.0f), 3.0f, 0.5f, eye);
+        glm::mat4 model = glm::mat4(1.0f);
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        counters.drawCalls += 1;
+        counters.triangles += 12;
+        counters.uploadBytes += 2 * sizeof(glm::mat4);
+    }
+
+    bool setupSoftware(const Options& options, std::string&, bool&) override {
+        softProj = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.1f, 100.0f);
+        return true;
+    }
+
+    void renderSoftware(float t, SoftRasterizer& raster, SoftFramebuffer& target, FrameCounters& counters) override {
+        glm::vec3 eye;
+        ColorShader shader;
+        shader.mvp = softProj * orbitCamera(t, glm::vec3(0.0f), 3.0f, 0.5f, eye);
+        raster.drawTriangles(target, cubeVertices, 36, 6, shader);
+        counters.drawCalls += 1;
+        counters.triangles += 12;
+    }
+
+private:
+    glm::mat4 softProj;
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLint uniModel = -1;
+    GLint uniView = -1;
+};
+
+// grafika_5: pozycja, kolor, UV i normalna, 11 floatów na wierzchołek
+const GLfloat litCubeVertices[] = {
+    -0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  0.0f,  0.0f,  1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,  0.0f,  0.0f,  1.0f,
+     0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,  0.0f,  0.0f,  1.0f,
+    -0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f,  0.0f,  0.0f,  1.0f,
+    -0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  0.0f,  0.0f, -1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,  0.0f,  0.0f, -1.0f,
+     0.5f,  0.5f, -0.5f,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,  0.0f,  0.0f, -1.0f,
+    -0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f,  0.0f,  0.0f, -1.0f,
+    -0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f, -1.0f,  0.0f,  0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f, -1.0f,  0.0f,  0.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f, -1.0f,  0.0f,  0.0f,
+    -0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, -1.0f,  0.0f,  0.0f,
+     0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  1.0f,  0.0f,  0.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,  1.0f,  0.0f,  0.0f,
+     0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,  1.0f,  0.0f,  0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f,  1.0f,  0.0f,  0.0f,
+    -0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  0.0f, -1.0f,  0.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,  0.0f, -1.0f,  0.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,  0.0f, -1.0f,  0.0f,
+    -0.5f, -0.5f,  0.5f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f,  0.0f, -1.0f,  0.0f,
+    -0.5f,  0.5f, -0.5f,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  0.0f,  1.0f,  0.0f,
+     0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,  0.0f,  1.0f,  0.0f,
+     0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,  0.0f,  1.0f,  0.0f,
+    -0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f,  0.0f,  1.0f,  0.0f,
+};
+const GLuint litCubeIndices[] = {
+    0, 1, 2, 0, 2, 3,   4, 5, 6, 4, 6, 7,   8, 9, 10, 8, 10, 11,
+    12, 13, 14, 12, 14, 15,   16, 17, 18, 16, 18, 19,   20, 21, 22, 20, 22, 23,
+};
+
+// grafika_5: sześcian i podłoga z shaderami z grafika_5/shaders w wariancie LIGHTING | TEXTURE
+class LitCubeScene : public Scene {
+public:
+    ~LitCubeScene() {
+        if (program != 0)
+            glDeleteProgram(program);
+        if (texture != 0)
+            glDeleteTextures(1, &texture);
+        if (vbo != 0)
+            glDeleteBuffers(1, &vbo);
+        if (ebo != 0)
+            glDeleteBuffers(1, &ebo);
+        if (vao != 0)
+            glDeleteVertexArrays(1, &vao);
+    }
+
+    bool setup(const Options& options, std::string& error, bool&) override {
+        std::string vertexBody, fragmentBody;
+        std::string shaderDir = options.root + "/grafika_5/shaders/";
+        if (!readTextFile(shaderDir + "cube.vert", vertexBody) || !readTextFile(shaderDir + "cube.frag", fragmentBody)) {
+            error = "cannot read " + shaderDir + "cube.vert/.frag";
+            return false;
+        }
+        const std::string header = "#version 150 core\n#define LIGHTING\n#define TEXTURE\n";
+        program = linkProgram(header + vertexBody, header + fragmentBody, { "position", "color", "texCoord", "aNormal" }, error);
+        if (!program)
+            return false;
+        glBindFragDataLocation(program, 0, "outColor");
+        glLinkProgram(program);
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(litCubeVertices), litCubeVertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(litCubeIndices), litCubeIndices, GL_STATIC_DRAW);
+        const int sizes[4] = { 3, 3, 2, 3 };
+        const int offsets[4] = { 0, 3, 6, 8 };
+        for (int i = 0; i < 4; ++i) {
+            glEnableVertexAttribArray(i);
+            glVertexAttribPointer(i, sizes[i], GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(offsets[i] * sizeof(GLfloat)));
+        }
+        texture = createCheckerTexture();
+
+        glUseProgram(program);
+        uniModel = glGetUniformLocation(program, "model");
+        uniView = glGetUniformLocation(program, "view");
+        uniViewPos = glGetUniformLocation(program, "viewPos");
+        glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.1f, 100.0f);
+        glUniformMatrix4fv(glGetUniformLocation(program, "proj"), 1, GL_FALSE, glm::value_ptr(proj));
+        glUniform3f(glGetUniformLocation(program, "lightPos"), 1.2f, 1.0f, 2.0f);
+        glUniform3f(glGetUniformLocation(program, "ambientLightColor"), 1.0f, 1.0f, 1.0f);
+        glUniform3f(glGetUniformLocation(program, "diffuseLightColor"), 1.0f, 1.0f, 1.0f);
+        glUniform1f(glGetUniformLocation(program, "ambientStrength"), 0.1f);
+        glUniform1f(glGetUniformLocation(program, "lightStrength"), 1.0f);
+        return true;
+    }
+
+    void render(float t, FrameCounters& counters) override {
+        glm::vec3 eye;
+        glm::mat4 view = orbitCamera(t, glm::vec3(0.0f), 4.0f, 1.5f, eye);
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+        glUniform3fv(uniViewPos, 1, glm::value_ptr(eye));
+
+        glm::mat4 model = glm::mat4(1.0f);
+        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+
+        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(floorModel()));
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+
+        counters.drawCalls += 2;
+        counters.triangles += 24;
+        counters.uploadBytes += 3 * sizeof(glm::mat4) + sizeof(glm::vec3);
+    }
+
+    // Sześcian i podłoga rozwinięte z indeksów do jednego strumienia w przestrzeni świata
+    bool setupRayTrace(const Options& options, RayTracer& tracer, std::string&, bool&) override {
+        const glm::mat4 models[2] = { glm::mat4(1.0f), floorModel() };
+        traceVertices.clear();
+        for (const glm::mat4& model : models) {
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+            for (GLuint index : litCubeIndices) {
+                const GLfloat* in = &litCubeVertices[index * 11];
+                glm::vec3 position = glm::vec3(model * glm::vec4(in[0], in[1], in[2], 1.0f));
+                glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(in[8], in[9], in[10]));
+                const float out[11] = { position.x, position.y, position.z, in[3], in[4], in[5], in[6], in[7], normal.x, normal.y, normal.z };
+                traceVertices.insert(traceVertices.end(), out, out + 11);
+            }
+        }
+        tracer.setMesh(traceVertices.data(), traceVertices.size() / 11, 11, 8, 6);
+        softTexture = createSoftCheckerTexture();
+        proj = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.1f, 100.0f);
+        light.position = glm::vec3(1.2f, 1.0f, 2.0f);
+        return true;
+    }
+
+    void renderRayTrace(float t, RayTracer& tracer, SoftFramebuffer& framebuffer, FrameCounters& counters) override {
+        glm::vec3 eye;
+        glm::mat4 view = orbitCamera(t, glm::vec3(0.0f), 4.0f, 1.5f, eye);
+        tracer.render(framebuffer, view, proj, light, &softTexture, CLEAR_COLOR);
+        counters.triangles += traceVertices.size() / 11 / 3;
+    }
+
+private:
+    static glm::mat4 floorModel() {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.55f, 0.0f));
+        return glm::scale(model, glm::vec3(12.0f, 0.1f, 12.0f));
+    }
+
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLuint texture = 0;
+    GLint uniModel = -1;
+    GLint uniView = -1;
+    GLint uniViewPos = -1;
+    std::vector<float> traceVertices;
+    SoftTexture softTexture;
+    glm::mat4 proj;
+    RayTraceLight light;
+};
+
+// grafika_7: model OBJ ze strumienia wierzchołków i shaderów z grafika_7/shaders
+class ObjScene : public Scene {
+public:
+    explicit ObjScene(ThreadPool& pool)
+        : pool(pool) {
+    }
+
+    ~ObjScene() {
+        if (program != 0)
+            glDeleteProgram(program);
+        if (texture != 0)
+            glDeleteTextures(1, &texture);
+        if (vbo != 0)
+            glDeleteBuffers(1, &vbo);
+        if (vao != 0)
+            glDeleteVertexArrays(1, &vao);
+    }
+
+    bool setup(const Options& options, std::string& error, bool& skipped) override {
+        if (!loadModel(options, error, skipped))
+            return false;
+
+        std::string vertexSource, fragmentSource;
+        std::string shaderDir = options.root + "/grafika_7/shaders/";
+        if (!readTextFile(shaderDir + "model.vert", vertexSource) || !readTextFile(shaderDir + "model.frag", fragmentSource)) {
+            error = "cannot read " + shaderDir + "model.vert/.frag";
+            return false;
+        }
+        program = linkProgram(vertexSource, fragmentSource, {}, error);
+        if (!program)
+            return false;
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        size_t offset = 0;
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)(stride * sizeof(float)), (void*)0);
+        glEnableVertexAttribArray(0);
+        offset += 3;
+        if (hasNormals) {
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, (GLsizei)(stride * sizeof(float)), (void*)(offset * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            offset += 3;
+        }
+        if (texCoordOffset >= 0) {
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, (GLsizei)(stride * sizeof(float)), (void*)(offset * sizeof(float)));
+            glEnableVertexAttribArray(2);
+        }
+        texture = createCheckerTexture();
+
+        glUseProgram(program);
+        uniModel = glGetUniformLocation(program, "model");
+        uniView = glGetUniformLocation(program, "view");
+        glUniform1i(glGetUniformLocation(program, "texture1"), 0);
+        glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(proj));
+        return true;
+    }
+
+    void render(float t, FrameCounters& counters) override {
+        glm::vec3 eye;
+        glm::mat4 view = orbitCamera(t, target, 1.5f * radius, 0.4f * radius, eye);
+        glm::mat4 model = glm::mat4(1.0f);
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        counters.drawCalls += 1;
+        counters.triangles += vertexCount / 3;
+        counters.uploadBytes += 2 * sizeof(glm::mat4);
+    }
+
+    bool setupSoftware(const Options& options, std::string& error, bool& skipped) override {
+        if (!loadModel(options, error, skipped))
+            return false;
+        softTexture = createSoftCheckerTexture();
+        return true;
+    }
+
+    void renderSoftware(float t, SoftRasterizer& raster, SoftFramebuffer& framebuffer, FrameCounters& counters) override {
+        glm::vec3 eye;
+        TexturedShader shader;
+        shader.mvp = proj * orbitCamera(t, target, 1.5f * radius, 0.4f * radius, eye);
+        shader.texture = &softTexture;
+        shader.texCoordOffset = texCoordOffset;
+        raster.drawTriangles(framebuffer, vertices.data(), vertexCount, stride, shader);
+        counters.drawCalls += 1;
+        counters.triangles += vertexCount / 3;
+    }
+
+    // Model oświetlony jak sześcian z grafika_5; światło nad modelem, z przodu z prawej
+    bool setupRayTrace(const Options& options, RayTracer& tracer, std::string& error, bool& skipped) override {
+        if (!loadModel(options, error, skipped))
+            return false;
+        tracer.setMesh(vertices.data(), vertexCount, stride, hasNormals ? 3 : -1, texCoordOffset);
+        softTexture = createSoftCheckerTexture();
+        light.position = target + glm::vec3(0.6f, 0.5f, 1.0f) * radius;
+        return true;
+    }
+
+    void renderRayTrace(float t, RayTracer& tracer, SoftFramebuffer& framebuffer, FrameCounters& counters) override {
+        glm::vec3 eye;
+        glm::mat4 view = orbitCamera(t, target, 1.5f * radius, 0.4f * radius, eye);
+        tracer.render(framebuffer, view, proj, light, &softTexture, CLEAR_COLOR);
+        counters.triangles += vertexCount / 3;
+    }
+
+private:
+    // Wspólne dla obu ścieżek: strumień wierzchołków, kamera dopasowana do rozmiaru modelu
+    bool loadModel(const Options& options, std::string& error, bool& skipped) {
+        std::ifstream probe(options.objPath);
+        if (!probe.is_open()) {
+            error = "cannot open " + options.objPath;
+            skipped = true;
+            return false;
+        }
+        probe.close();
+
+        ObjModel model = loadObjModel(options.objPath);
+        if (model.faces.empty() || model.vertices.empty()) {
+            error = "no faces in " + options.objPath;
+            return false;
+        }
+        // Brak vn - normalne liczone równolegle przy wczytywaniu, czas na stderr
+        if (model.normals.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            generateObjNormals(model, pool);
+            std::cerr << "  generated " << model.normals.size() << " normals for " << model.faces.size() << " faces in "
+                << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+        }
+        vertices = buildObjVertexStream(model);
+        stride = objVertexStride(model);
+        vertexCount = (GLsizei)(vertices.size() / stride);
+        hasNormals = !model.normals.empty();
+        texCoordOffset = model.texCoords.empty() ? -1 : (hasNormals ? 6 : 3);
+
+        glm::vec3 boundsMin(model.vertices[0].x, model.vertices[0].y, model.vertices[0].z);
+        glm::vec3 boundsMax = boundsMin;
+        for (const Vertex& vertex : model.vertices) {
+            glm::vec3 position(vertex.x, vertex.y, vertex.z);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+        target = (boundsMin + boundsMax) * 0.5f;
+        radius = std::max(glm::length(boundsMax - boundsMin), 0.01f);
+        proj = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.01f * radius, 10.0f * radius);
+        return true;
+    }
+
+    ThreadPool& pool;
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint texture = 0;
+    GLsizei vertexCount = 0;
+    GLint uniModel = -1;
+    GLint uniView = -1;
+    std::vector<float> vertices;
+    size_t stride = 3;
+    bool hasNormals = false;
+    int texCoordOffset = -1;
+    glm::vec3 target;
+    float radius = 1.0f;
+    glm::mat4 proj;
+    SoftTexture softTexture;
+    RayTraceLight light;
+};
+
+struct Summary {
+    double min = 0.0;
+    double avg = 0.0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty())
+        return summary;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+    auto percentile = [&](double p) {
+        size_t index = (size_t)std::ceil(p * samples.size());
+        return samples[std::min(samples.size() - 1, index > 0 ? index - 1 : 0)];
+    };
+    summary.min = samples.front();
+    summary.avg = sum / samples.size();
+    summary.p50 = percentile(0.5);
+    summary.p99 = percentile(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+struct SceneResult {
+    std::string name;
+    std::string status;
+    std::string error;
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs;
+    FrameCounters counters;
+    // Tylko --backend compare: część różniących się pikseli i największa różnica kanału
+    double mismatch = -1.0;
+    int maxDiff = 0;
+    // Tylko --backend raytrace
+    double bvhBuildMs = -1.0;
+    size_t bvhNodes = 0;
+    unsigned long long rays = 0;
+    double traceSeconds = 0.0;
+    // malloc w mierzonych klatkach; w stanie ustalonym powinno być 0
+    unsigned long long allocations = 0;
+    unsigned long long maxFrameAllocations = 0;
+};
+
+void countAllocations(SceneResult& result, uint64_t frameAllocations) {
+    result.allocations += frameAllocations;
+    result.maxFrameAllocations = std::max<unsigned long long>(result.maxFrameAllocations, frameAllocations);
+}
+
+void prepareGlTarget(GLuint fbo, const Options& options) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, options.width, options.height);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(CLEAR_COLOR.r, CLEAR_COLOR.g, CLEAR_COLOR.b, 1.0f);
+}
+
+// Każda klatka kończy się glFinish, więc czas CPU obejmuje całe rysowanie - przy llvmpipe
+// to właśnie koszt rasteryzacji. Czas GPU z GL_TIME_ELAPSED jest czytany od razu, bo potok jest pusty.
+void runScene(Scene& scene, const Options& options, GLuint fbo, SceneResult& result) {
+    bool skipped = false;
+    if (!scene.setup(options, result.error, skipped)) {
+        result.status = skipped ? "skipped" : "failed";
+        return;
+    }
+
+    GLuint query;
+    glGenQueries(1, &query);
+    prepareGlTarget(fbo, options);
+
+    int total = options.warmup + options.frames;
+    result.cpuMs.reserve(options.frames);
+    result.gpuMs.reserve(options.frames);
+    for (int frame = 0; frame < total; ++frame) {
+        bool measured = frame >= options.warmup;
+        float t = measured ? (float)(frame - options.warmup) / options.frames : 0.0f;
+        FrameCounters frameCounters;
+
+        uint64_t allocationsBefore = allocationCount();
+        auto start = std::chrono::steady_clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        scene.render(t, frameCounters);
+        glEndQuery(GL_TIME_ELAPSED);
+        glFinish();
+        auto end = std::chrono::steady_clock::now();
+        uint64_t frameAllocations = allocationCount() - allocationsBefore;
+
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+        if (!measured)
+            continue;
+        result.cpuMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        countAllocations(result, frameAllocations);
+        result.gpuMs.push_back(elapsedNs / 1.0e6);
+        result.counters.drawCalls += frameCounters.drawCalls;
+        result.counters.triangles += frameCounters.triangles;
+        result.counters.uploadBytes += frameCounters.uploadBytes;
+    }
+    glDeleteQueries(1, &query);
+
+    GLenum glError = glGetError();
+    if (glError != GL_NO_ERROR) {
+        std::ostringstream message;
+        message << "GL error 0x" << std::hex << glError;
+        result.error = message.str();
+        result.status = "failed";
+        return;
+    }
+    result.status = "ok";
+}
+
+// Te same klatki rasteryzerem programowym; czas CPU obejmuje czyszczenie bufora i całe rysowanie
+void runSceneSoftware(Scene& scene, const Options& options, SoftRasterizer& raster, SceneResult& result) {
+    bool skipped = false;
+    if (!scene.setupSoftware(options, result.error, skipped)) {
+        result.status = skipped ? "skipped" : "failed";
+        return;
+    }
+
+    SoftFramebuffer framebuffer(options.width, options.height);
+    int total = options.warmup + options.frames;
+    result.cpuMs.reserve(options.frames);
+    for (int frame = 0; frame < total; ++frame) {
+        bool measured = frame >= options.warmup;
+        float t = measured ? (float)(frame - options.warmup) / options.frames : 0.0f;
+        FrameCounters frameCounters;
+
+        uint64_t allocationsBefore = allocationCount();
+        auto start = std::chrono::steady_clock::now();
+        framebuffer.clear(CLEAR_COLOR);
+        scene.renderSoftware(t, raster, framebuffer, frameCounters);
+        auto end = std::chrono::steady_clock::now();
+        uint64_t frameAllocations = allocationCount() - allocationsBefore;
+        if (!measured)
+            continue;
+        result.cpuMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        countAllocations(result, frameAllocations);
+        result.counters.drawCalls += frameCounters.drawCalls;
+        result.counters.triangles += frameCounters.triangles;
+    }
+
+    if (!options.pngDir.empty()) {
+        std::string path = options.pngDir + "/" + result.name + "_software.png";
+        if (!writePng(path, options.width, options.height, framebuffer.color.data(), true))
+            std::cerr << "Cannot write " << path << std::endl;
+    }
+    result.status = "ok";
+}
+
+// Klatki śledzeniem promieni; BVH budowane raz w setupRayTrace, przepustowość liczona z czasu render()
+void runSceneRayTrace(Scene& scene, const Options& options, RayTracer& tracer, SceneResult& result) {
+    bool skipped = false;
+    if (!scene.setupRayTrace(options, tracer, result.error, skipped)) {
+        result.status = skipped ? "skipped" : "failed";
+        return;
+    }
+    result.bvhBuildMs = tracer.buildMilliseconds();
+    result.bvhNodes = tracer.nodeCount();
+
+    SoftFramebuffer framebuffer(options.width, options.height);
+    int total = options.warmup + options.frames;
+    result.cpuMs.reserve(options.frames);
+    for (int frame = 0; frame < total; ++frame) {
+        bool measured = frame >= options.warmup;
+        float t = measured ? (float)(frame - options.warmup) / options.frames : 0.0f;
+        FrameCounters frameCounters;
+
+        uint64_t allocationsBefore = allocationCount();
+        auto start = std::chrono::steady_clock::now();
+        scene.renderRayTrace(t, tracer, framebuffer, frameCounters);
+        auto end = std::chrono::steady_clock::now();
+        uint64_t frameAllocations = allocationCount() - allocationsBefore;
+        if (!measured)
+            continue;
+        result.cpuMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        countAllocations(result, frameAllocations);
+        result.traceSeconds += std::chrono::duration<double>(end - start).count();
+        result.rays += tracer.raysTraced();
+        result.counters.triangles += frameCounters.triangles;
+    }
+
+    if (!options.pngDir.empty()) {
+        std::string path = options.pngDir + "/" + result.name + "_raytrace.png";
+        if (!writePng(path, options.width, options.height, framebuffer.color.data(), true))
+            std::cerr << "Cannot write " << path << std::endl;
+    }
+    result.status = "ok";
+}
+
+// Jedna klatka (t = COMPARE_T) przez GL i rasteryzer programowy, porównanie piksel po pikselu
+void compareScene(Scene& scene, const Options& options, GLuint fbo, SoftRasterizer& raster, SceneResult& result) {
+    bool skipped = false;
+    if (!scene.setup(options, result.error, skipped) || !scene.setupSoftware(options, result.error, skipped)) {
+        result.status = skipped ? "skipped" : "failed";
+        return;
+    }
+
+    FrameCounters counters;
+    prepareGlTarget(fbo, options);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    scene.render(COMPARE_T, counters);
+    std::vector<unsigned char> glPixels((size_t)options.width * options.height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, glPixels.data());
+    GLenum glError = glGetError();
+    if (glError != GL_NO_ERROR) {
+        std::ostringstream message;
+        message << "GL error 0x" << std::hex << glError;
+        result.error = message.str();
+        result.status = "failed";
+        return;
+    }
+
+    SoftFramebuffer framebuffer(options.width, options.height);
+    framebuffer.clear(CLEAR_COLOR);
+    scene.renderSoftware(COMPARE_T, raster, framebuffer, counters);
+
+    size_t pixelCount = (size_t)options.width * options.height;
+    size_t different = 0;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        int pixelDiff = 0;
+        for (int channel = 0; channel < 3; ++channel)
+            pixelDiff = std::max(pixelDiff, std::abs((int)glPixels[i * 4 + channel] - (int)framebuffer.color[i * 4 + channel]));
+        result.maxDiff = std::max(result.maxDiff, pixelDiff);
+        if (pixelDiff > CHANNEL_TOLERANCE)
+            ++different;
+    }
+    result.mismatch = (double)different / pixelCount;
+
+    if (!options.pngDir.empty()) {
+        std::string glPath = options.pngDir + "/" + result.name + "_gl.png";
+        std::string softPath = options.pngDir + "/" + result.name + "_software.png";
+        if (!writePng(glPath, options.width, options.height, glPixels.data(), true) ||
+            !writePng(softPath, options.width, options.height, framebuffer.color.data(), true))
+            std::cerr << "Cannot write images to " << options.pngDir << std::endl;
+    }
+
+    if (result.mismatch > options.tolerance) {
+        std::ostringstream message;
+        message << result.mismatch * 100.0 << "% of pixels differ from GL";
+        result.error = message.str();
+        result.status = "failed";
+        return;
+    }
+    result.status = "ok";
+}
+
+void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c == '\n')
+            out << "\\n";
+        else if ((unsigned char)c >= 0x20)
+            out << c;
+    }
+    out << '"';
+}
+
+void writeSummary(std::ostream& out, const char* name, const Summary& summary) {
+    out << "\"" << name << "\": {\"min\": " << summary.min << ", \"avg\": " << summary.avg << ", \"p50\": " << summary.p50
+        << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "}";
+}
+
+void writeReport(std::ostream& out, const Options& options, const std::string& renderer, const std::string& version,
+    const std::vector<SceneResult>& results) {
+    out << "{\n  \"renderer\": ";
+    writeJsonString(out, renderer);
+    out << ",\n  \"version\": ";
+    writeJsonString(out, version);
+    out << ",\n  \"backend\": ";
+    writeJsonString(out, options.backend);
+    out << ",\n  \"width\": " << options.width << ",\n  \"height\": " << options.height
+        << ",\n  \"frames\": " << options.frames << ",\n  \"warmup\": " << options.warmup << ",\n  \"scenes\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SceneResult& result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": ";
+        writeJsonString(out, result.name);
+        out << ", \"status\": ";
+        writeJsonString(out, result.status);
+        if (!result.error.empty()) {
+            out << ", \"error\": ";
+            writeJsonString(out, result.error);
+        }
+        if (result.mismatch >= 0.0)
+            out << ", \"mismatch\": " << result.mismatch << ", \"max_channel_diff\": " << result.maxDiff;
+        if (result.bvhBuildMs >= 0.0) {
+            out << ",\n     \"bvh_build_ms\": " << result.bvhBuildMs << ", \"bvh_nodes\": " << result.bvhNodes
+                << ", \"rays_per_frame\": " << (result.cpuMs.empty() ? 0.0 : (double)result.rays / result.cpuMs.size())
+                << ", \"mrays_per_s\": " << (result.traceSeconds > 0.0 ? result.rays / result.traceSeconds / 1.0e6 : 0.0);
+        }
+        if (result.status == "ok" && !result.cpuMs.empty()) {
+            double frames = (double)result.cpuMs.size();
+            out << ",\n     ";
+            writeSummary(out, "cpu_ms", summarize(result.cpuMs));
+            if (!result.gpuMs.empty()) {
+                out << ",\n     ";
+                writeSummary(out, "gpu_ms", summarize(result.gpuMs));
+            }
+            out << ",\n     \"draw_calls_per_frame\": " << result.counters.drawCalls / frames
+                << ", \"triangles_per_frame\": " << result.counters.triangles / frames
+                << ", \"upload_bytes_per_frame\": " << result.counters.uploadBytes / frames
+                << ",\n     \"allocations_per_frame\": " << result.allocations / frames
+                << ", \"max_frame_allocations\": " << result.maxFrameAllocations
+                << ",\n     \"frame_ms\": [";
+            for (size_t frame = 0; frame < result.cpuMs.size(); ++frame)
+                out << (frame ? ", " : "") << result.cpuMs[frame];
+            out << "]";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // Kontekst GL nie jest potrzebny dla rasteryzera programowego ani śledzenia promieni
+    bool useGl = options.backend != "software" && options.backend != "raytrace";
+    HeadlessContext headless;
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    std::string renderer, version;
+    if (useGl) {
+        if (!createHeadlessContext(headless)) {
+            destroyHeadlessContext(headless);
+            return 1;
+        }
+
+        glewExperimental = GL_TRUE;
+        GLenum err = glewInit();
+        // GLEW zbudowany dla GLX zgłasza brak wyświetlacza X, ale wskaźniki funkcji GL są już wczytane
+        if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY) {
+            std::cerr << "GLEW initialization error: " << glewGetErrorString(err) << std::endl;
+            destroyHeadlessContext(headless);
+            return 1;
+        }
+        renderer = (const char*)glGetString(GL_RENDERER);
+        version = (const char*)glGetString(GL_VERSION);
+
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, options.width, options.height);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+            destroyHeadlessContext(headless);
+            return 1;
+        }
+    }
+
+    ThreadPool pool(options.threads > 0 ? options.threads : std::thread::hardware_concurrency());
+    SoftRasterizer raster(pool);
+    RayTracer tracer(pool);
+    std::ostringstream softwareName;
+    softwareName << "software rasterizer (" << pool.size() << " threads, " << SoftRasterizer::simdPath() << ")";
+    if (options.backend == "software") {
+        renderer = softwareName.str();
+        version = "-";
+    }
+    else if (options.backend == "compare") {
+        renderer += " vs " + softwareName.str();
+    }
+    else if (options.backend == "raytrace") {
+        std::ostringstream tracerName;
+        tracerName << "CPU ray tracer (" << pool.size() << " threads, " << Bvh::simdPath() << ")";
+        renderer = tracerName.str();
+        version = "-";
+    }
+    std::cerr << "Benchmark on " << renderer << " (" << version << ")" << std::endl;
+
+    std::vector<SceneResult> results;
+    bool failed = false;
+    for (const std::string& name : options.scenes) {
+        SceneResult result;
+        result.name = name;
+        Scene* scene = nullptr;
+        if (name == "cube")
+            scene = new CubeScene();
+        else if (name == "lit")
+            scene = new LitCubeScene();
+        else if (name == "obj")
+            scene = new ObjScene(pool);
+
+        if (scene) {
+            if (options.backend == "software")
+                runSceneSoftware(*scene, options, raster, result);
+            else if (options.backend == "raytrace")
+                runSceneRayTrace(*scene, options, tracer, result);
+            else if (options.backend == "compare")
+                compareScene(*scene, options, fbo, raster, result);
+            else
+                runScene(*scene, options, fbo, result);
+            delete scene;
+        }
+        else {
+            result.status = "failed";
+            result.error = "unknown scene";
+        }
+        std::cerr << "  " << name << ": " << result.status << (result.error.empty() ? "" : " (" + result.error + ")") << std::endl;
+        if (result.bvhBuildMs >= 0.0 && result.traceSeconds > 0.0) {
+            std::cerr << "    BVH " << result.bvhNodes << " nodes in " << result.bvhBuildMs << " ms, "
+                << result.rays / result.traceSeconds / 1.0e6 << " Mrays/s" << std::endl;
+        }
+        failed = failed || result.status == "failed";
+        results.push_back(result);
+    }
+
+    if (options.outPath.empty()) {
+        writeReport(std::cout, options, renderer, version, results);
+    }
+    else {
+        std::ofstream out(options.outPath);
+        if (!out.is_open()) {
+            std::cerr << "Cannot write " << options.outPath << std::endl;
+            failed = true;
+        }
+        else {
+            writeReport(out, options, renderer, version, results);
+        }
+    }
+
+    if (useGl) {
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteFramebuffers(1, &fbo);
+        destroyHeadlessContext(headless);
+    }
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,262 @@
+﻿#pragma once
+// Licznik alokacji do sprawdzania, że klatka w stanie ustalonym nie woła malloc. Implementacja trafia do
+// dokładnie jednego pliku .cpp: #define ALLOC_COUNTER_IMPLEMENTATION przed dołączeniem (jak w stb_image).
+// Z glibc podmieniane są malloc/calloc/realloc oraz aligned_alloc/posix_memalign/memalign/valloc/pvalloc
+// programu, więc liczą się też alokacje bibliotek (libstdc++ z wyrównanymi i nothrow operator new, sterownik
+// GL). Nie liczą się alokacje wewnątrz samej glibc (strdup, fopen), które nie przechodzą przez PLT.
+// Na innych platformach liczone są globalne operator new/new[] we wszystkich wariantach (wyrównane, nothrow),
+// ale nie malloc wołane bezpośrednio.
+// Podmiana dokłada atomowy licznik do każdej alokacji, więc dema włączają ją tylko przy -DCOUNT_ALLOCATIONS;
+// bez tego definiują ALLOC_COUNTER_DISABLED, a licznik stoi na 0 i raport nic nie wypisuje.
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <atomic>
+#include <new>
+#include <ostream>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#ifdef ALLOC_COUNTER_DISABLED
+inline uint64_t allocationCount() {
+    return 0;
+}
+#else
+uint64_t allocationCount();
+#endif
+
+// Alokacje między beginFrame a endFrame; klatki po warmupFrames liczą się do stanu ustalonego
+class AllocationWatch {
+public:
+    explicit AllocationWatch(int warmupFrames = 60) : warmupFrames(warmupFrames) {
+    }
+
+    void beginFrame() {
+        start = allocationCount();
+    }
+
+    void endFrame() {
+        last = allocationCount() - start;
+        if (++frames <= warmupFrames)
+            return;
+        ++steadyFrames;
+        steadyAllocations += last;
+        if (last > 0)
+            ++allocatingFrames;
+        maxAllocations = std::max(maxAllocations, last);
+    }
+
+    uint64_t lastFrameAllocations() const {
+        return last;
+    }
+
+    uint64_t steadyStateAllocations() const {
+        return steadyAllocations;
+    }
+
+    uint64_t steadyStateFrames() const {
+        return steadyFrames;
+    }
+
+    void report(std::ostream& out) const {
+#ifndef ALLOC_COUNTER_DISABLED
+        out << "Allocations: " << steadyAllocations << " in " << steadyFrames << " steady-state frames ("
+            << allocatingFrames << " frames allocated, max " << maxAllocations << " per frame)\n";
+#else
+        (void)out;
+#endif
+    }
+
+private:
+    int warmupFrames;
+    int frames = 0;
+    uint64_t start = 0;
+    uint64_t last = 0;
+    uint64_t steadyFrames = 0;
+    uint64_t steadyAllocations = 0;
+    uint64_t allocatingFrames = 0;
+    uint64_t maxAllocations = 0;
+};
+
+#ifdef ALLOC_COUNTER_IMPLEMENTATION
+
+namespace alloc_counter_detail {
+std::atomic<uint64_t> count(0);
+}
+
+uint64_t allocationCount() {
+    return alloc_counter_detail::count.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+
+void* malloc(size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    void* result = __libc_memalign(alignment, size);
+    if (!result)
+        return ENOMEM;
+    *pointer = result;
+    return 0;
+}
+
+void* valloc(size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_pvalloc(size);
+}
+}
+#else
+void* operator new(size_t size) {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+namespace alloc_counter_detail {
+inline void* alignedAllocate(size_t size, size_t alignment) {
+#if defined(_MSC_VER)
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    // aligned_alloc wymaga rozmiaru będącego wielokrotnością wyrównania
+    return std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+#endif
+}
+
+inline void alignedFree(void* pointer) {
+#if defined(_MSC_VER)
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = alloc_counter_detail::alignedAllocate(size, (size_t)alignment))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    alloc_counter_detail::count.fetch_add(1, std::memory_order_relaxed);
+    return alloc_counter_detail::alignedAllocate(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    alloc_counter_detail::alignedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    alloc_counter_detail::alignedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    alloc_counter_detail::alignedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    alloc_counter_detail::alignedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    alloc_counter_detail::alignedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    alloc_counter_detail::alignedFree(pointer);
+}
+#endif
+
+#endif
@@ -0,0 +1,224 @@
+﻿#pragma once
+// Wsadowe rysowanie kształtów 2D w Allegro. Zamiast osobnego al_draw_filled_rectangle/al_draw_line
+// na każdy kształt wierzchołki trafiają do tablic grupowanych po stanie (tekstura + tryb mieszania),
+// a flush() wysyła każdą grupę jednym al_draw_indexed_prim - grupy w kolejności klucza stanu.
+// Kolejność rysowania zachowana jest tylko w obrębie grupy; kształty z różnym stanem, które muszą
+// się przykrywać w określonej kolejności, wymagają osobnego flush(). Tablice są czyszczone, ale nie
+// zwalniane, więc po rozgrzaniu kolejne klatki nie alokują pamięci.
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+enum class BlendMode {
+    Alpha,
+    Additive,
+};
+
+class Batch2D {
+public:
+    Batch2D() {
+        groups.reserve(8);
+    }
+
+    Batch2D(const Batch2D&) = delete;
+    Batch2D& operator=(const Batch2D&) = delete;
+
+    void fillRect(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color,
+        ALLEGRO_BITMAP* texture = nullptr, BlendMode blend = BlendMode::Alpha) {
+        Group& group = groupFor(texture, blend);
+        int base = (int)group.vertices.size();
+        // Współrzędne tekstury w pikselach, jak w al_draw_prim
+        float u2 = texture ? (float)al_get_bitmap_width(texture) : 0.0f;
+        float v2 = texture ? (float)al_get_bitmap_height(texture) : 0.0f;
+        pushVertex(group, x1, y1, 0.0f, 0.0f, color);
+        pushVertex(group, x2, y1, u2, 0.0f, color);
+        pushVertex(group, x2, y2, u2, v2, color);
+        pushVertex(group, x1, y2, 0.0f, v2, color);
+        pushQuadIndices(group, base);
+    }
+
+    void fillTriangle(float x1, float y1, float x2, float y2, float x3, float y3, ALLEGRO_COLOR color,
+        BlendMode blend = BlendMode::Alpha) {
+        Group& group = groupFor(nullptr, blend);
+        int base = (int)group.vertices.size();
+        pushVertex(group, x1, y1, 0.0f, 0.0f, color);
+        pushVertex(group, x2, y2, 0.0f, 0.0f, color);
+        pushVertex(group, x3, y3, 0.0f, 0.0f, color);
+        group.indices.push_back(base);
+        group.indices.push_back(base + 1);
+        group.indices.push_back(base + 2);
+    }
+
+    // Odcinek o grubości thickness jako prostokąt wzdłuż kierunku odcinka
+    void line(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color, float thickness,
+        BlendMode blend = BlendMode::Alpha) {
+        float dx = x2 - x1;
+        float dy = y2 - y1;
+        float length = std::sqrt(dx * dx + dy * dy);
+        if (length <= 0.0f)
+            return;
+        float nx = -dy / length * thickness * 0.5f;
+        float ny = dx / length * thickness * 0.5f;
+
+        Group& group = groupFor(nullptr, blend);
+        int base = (int)group.vertices.size();
+        pushVertex(group, x1 + nx, y1 + ny, 0.0f, 0.0f, color);
+        pushVertex(group, x2 + nx, y2 + ny, 0.0f, 0.0f, color);
+        pushVertex(group, x2 - nx, y2 - ny, 0.0f, 0.0f, color);
+        pushVertex(group, x1 - nx, y1 - ny, 0.0f, 0.0f, color);
+        pushQuadIndices(group, base);
+    }
+
+    void triangle(float x1, float y1, float x2, float y2, float x3, float y3, ALLEGRO_COLOR color, float thickness,
+        BlendMode blend = BlendMode::Alpha) {
+        line(x1, y1, x2, y2, color, thickness, blend);
+        line(x2, y2, x3, y3, color, thickness, blend);
+        line(x3, y3, x1, y1, color, thickness, blend);
+    }
+
+    // Miejsce na count prostokątów wypełnianych później przez setRect, także z wielu wątków naraz
+    // (każdy wątek pisze do swojego zakresu). Wskaźniki są ważne do następnego dodania kształtu lub flush().
+    struct QuadSpan {
+        ALLEGRO_VERTEX* vertices;
+        int* indices;
+        int baseVertex;
+    };
+
+    QuadSpan appendQuads(size_t count, BlendMode blend = BlendMode::Alpha) {
+        Group& group = groupFor(nullptr, blend);
+        size_t firstVertex = group.vertices.size();
+        size_t firstIndex = group.indices.size();
+        group.vertices.resize(firstVertex + count * 4);
+        group.indices.resize(firstIndex + count * 6);
+        QuadSpan span = { group.vertices.data() + firstVertex, group.indices.data() + firstIndex, (int)firstVertex };
+        return span;
+    }
+
+    static void setRect(const QuadSpan& span, size_t index, float x1, float y1, float x2, float y2, ALLEGRO_COLOR color) {
+        ALLEGRO_VERTEX* vertex = span.vertices + index * 4;
+        setVertex(vertex[0], x1, y1, color);
+        setVertex(vertex[1], x2, y1, color);
+        setVertex(vertex[2], x2, y2, color);
+        setVertex(vertex[3], x1, y2, color);
+        const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+        int base = span.baseVertex + (int)index * 4;
+        int* indices = span.indices + index * 6;
+        for (int i = 0; i < 6; ++i)
+            indices[i] = base + quad[i];
+    }
+
+    // Rysuje wszystkie grupy i czyści bufory. Zwraca liczbę wywołań al_draw_indexed_prim.
+    int flush() {
+        order.clear();
+        for (size_t i = 0; i < groups.size(); ++i) {
+            if (!groups[i].indices.empty())
+                order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return groups[a].key < groups[b].key;
+        });
+
+        int op, src, dst;
+        al_get_blender(&op, &src, &dst);
+        int calls = 0;
+        for (size_t index : order) {
+            Group& group = groups[index];
+            if (group.blend == BlendMode::Additive)
+                al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE);
+            else
+                al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+            al_draw_indexed_prim(group.vertices.data(), NULL, group.texture, group.indices.data(),
+                (int)group.indices.size(), ALLEGRO_PRIM_TRIANGLE_LIST);
+            ++calls;
+            lastVertices += group.vertices.size();
+            group.vertices.clear();
+            group.indices.clear();
+        }
+        al_set_blender(op, src, dst);
+        lastCalls += calls;
+        return calls;
+    }
+
+    // Liczniki od ostatniego resetStats - do porównania z rysowaniem kształt po kształcie
+    int drawCalls() const {
+        return lastCalls;
+    }
+
+    size_t vertexCount() const {
+        return lastVertices;
+    }
+
+    void resetStats() {
+        lastCalls = 0;
+        lastVertices = 0;
+    }
+
+private:
+    struct Group {
+        uint64_t key = 0;
+        ALLEGRO_BITMAP* texture = nullptr;
+        BlendMode blend = BlendMode::Alpha;
+        std::vector<ALLEGRO_VERTEX> vertices;
+        std::vector<int> indices;
+    };
+
+    // Klucz: tryb mieszania w najstarszym bicie, potem adres tekstury - grupy z tą samą teksturą sąsiadują
+    static uint64_t stateKey(ALLEGRO_BITMAP* texture, BlendMode blend) {
+        return ((uint64_t)(blend == BlendMode::Additive) << 63) | ((uint64_t)(uintptr_t)texture >> 1);
+    }
+
+    Group& groupFor(ALLEGRO_BITMAP* texture, BlendMode blend) {
+        uint64_t key = stateKey(texture, blend);
+        if (current < groups.size() && groups[current].key == key)
+            return groups[current];
+        for (size_t i = 0; i < groups.size(); ++i) {
+            if (groups[i].key == key) {
+                current = i;
+                return groups[i];
+            }
+        }
+        groups.emplace_back();
+        current = groups.size() - 1;
+        Group& group = groups.back();
+        group.key = key;
+        group.texture = texture;
+        group.blend = blend;
+        return group;
+    }
+
+    static void pushVertex(Group& group, float x, float y, float u, float v, ALLEGRO_COLOR color) {
+        ALLEGRO_VERTEX vertex;
+        vertex.x = x;
+        vertex.y = y;
+        vertex.z = 0.0f;
+        vertex.u = u;
+        vertex.v = v;
+        vertex.color = color;
+        group.vertices.push_back(vertex);
+    }
+
+    static void setVertex(ALLEGRO_VERTEX& vertex, float x, float y, ALLEGRO_COLOR color) {
+        vertex.x = x;
+        vertex.y = y;
+        vertex.z = 0.0f;
+        vertex.u = 0.0f;
+        vertex.v = 0.0f;
+        vertex.color = color;
+    }
+
+    static void pushQuadIndices(Group& group, int base) {
+        const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int offset : quad)
+            group.indices.push_back(base + offset);
+    }
+
+    std::vector<Group> groups;
+    std::vector<size_t> order;
+    size_t current = 0;
+    int lastCalls = 0;
+    size_t lastVertices = 0;
+};
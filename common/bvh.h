@@ -0,0 +1,659 @@
+﻿#pragma once
+// Hierarchia brył otaczających (BVH) nad trójkątami ze strumienia wierzchołków, budowana heurystyką SAH
+// na kubełkach (BINS na oś). Górne poziomy dzielone są szeregowo, ale z równoległym kubełkowaniem po
+// trójkątach; gdy zadań jest dość dla wszystkich wątków, poddrzewa budowane są równolegle do osobnych
+// tablic i doklejane do wspólnej. Przecinanie po 4 promienie naraz (pakiet, SSE2) albo po jednym.
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVH_SSE2 1
+#endif
+
+struct Aabb {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void grow(const Aabb& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    float area() const {
+        glm::vec3 size = max - min;
+        if (size.x < 0.0f)
+            return 0.0f;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+// Węzeł 32 B: liść - count > 0 trójkątów od first; węzeł wewnętrzny - dzieci first i first + 1
+struct BvhNode {
+    float min[3];
+    uint32_t first;
+    float max[3];
+    uint16_t count;
+    uint16_t axis;
+};
+
+// Trójkąt w postaci do testu Möllera-Trumbore'a
+struct BvhTriangle {
+    glm::vec3 v0;
+    glm::vec3 e1;
+    glm::vec3 e2;
+};
+
+struct BvhHit {
+    float t;
+    float u, v;
+    int triangle;
+};
+
+// Pakiet 4 promieni; bit i w active - promień i jest używany
+struct RayPacket {
+    alignas(16) float ox[4];
+    alignas(16) float oy[4];
+    alignas(16) float oz[4];
+    alignas(16) float dx[4];
+    alignas(16) float dy[4];
+    alignas(16) float dz[4];
+    alignas(16) float tmax[4];
+    int active;
+};
+
+struct HitPacket {
+    alignas(16) float t[4];
+    alignas(16) float u[4];
+    alignas(16) float v[4];
+    int triangle[4];
+};
+
+class Bvh {
+public:
+    static constexpr int BINS = 16;
+    static constexpr int MAX_LEAF = 4;
+    // Zakres mniejszy niż ten nie jest już dzielony z równoległym kubełkowaniem
+    static constexpr size_t PARALLEL_SPLIT = 16384;
+    static constexpr int STACK_SIZE = 64;
+    // Od tej głębokości zamiast SAH podział po medianie - połowienie zamyka drzewo przed STACK_SIZE - 1
+    // poziomami nawet dla 2^32 trójkątów, więc stosy budowy i przejścia nie mogą się przepełnić
+    static constexpr uint32_t MEDIAN_DEPTH = 24;
+
+    // Trójkąty to kolejne trójki wierzchołków strumienia; pozycja to pierwsze 3 floaty wierzchołka
+    void build(const float* stream, size_t triangleCount, size_t stride, ThreadPool& pool) {
+        nodes.clear();
+        triangles.clear();
+        triangleIds.clear();
+        if (triangleCount == 0)
+            return;
+
+        std::vector<BvhTriangle> source(triangleCount);
+        bounds.resize(triangleCount);
+        centroids.resize(triangleCount);
+        pool.parallelFor(triangleCount, 4096, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                const float* v = stream + i * 3 * stride;
+                glm::vec3 p0(v[0], v[1], v[2]);
+                glm::vec3 p1(v[stride], v[stride + 1], v[stride + 2]);
+                glm::vec3 p2(v[2 * stride], v[2 * stride + 1], v[2 * stride + 2]);
+                source[i] = BvhTriangle{ p0, p1 - p0, p2 - p0 };
+                Aabb box;
+                box.grow(p0);
+                box.grow(p1);
+                box.grow(p2);
+                bounds[i] = box;
+                centroids[i] = (box.min + box.max) * 0.5f;
+            }
+        });
+        ids.resize(triangleCount);
+        std::iota(ids.begin(), ids.end(), 0u);
+
+        // Górne poziomy: zawsze dzielony największy zakres, aż zadań będzie kilka na wątek
+        nodes.reserve(triangleCount * 2);
+        nodes.emplace_back();
+        std::vector<Task> tasks = { Task{ 0, 0, (uint32_t)triangleCount, 0 } };
+        size_t wanted = (size_t)pool.size() * 4;
+        while (tasks.size() < wanted) {
+            size_t largest = 0;
+            for (size_t i = 1; i < tasks.size(); ++i) {
+                if (tasks[i].end - tasks[i].begin > tasks[largest].end - tasks[largest].begin)
+                    largest = i;
+            }
+            Task task = tasks[largest];
+            if (task.end - task.begin < PARALLEL_SPLIT)
+                break;
+            uint32_t mid = splitNode(nodes, task, &pool);
+            if (mid == task.begin)
+                break;
+            uint32_t left = nodes[task.node].first;
+            tasks[largest] = Task{ left, task.begin, mid, task.depth + 1 };
+            tasks.push_back(Task{ left + 1, mid, task.end, task.depth + 1 });
+        }
+
+        std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+        pool.parallelFor(tasks.size(), 1, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i)
+                buildSubtree(subtrees[i], tasks[i].begin, tasks[i].end, tasks[i].depth);
+        });
+
+        // Korzeń poddrzewa zastępuje węzeł zadania, reszta węzłów idzie na koniec z przesuniętymi indeksami
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            std::vector<BvhNode>& subtree = subtrees[i];
+            uint32_t base = (uint32_t)nodes.size() - 1;
+            for (BvhNode& node : subtree) {
+                if (node.count == 0)
+                    node.first += base;
+            }
+            nodes[tasks[i].node] = subtree[0];
+            nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+        }
+
+        triangles.resize(triangleCount);
+        triangleIds.resize(triangleCount);
+        for (size_t i = 0; i < triangleCount; ++i) {
+            triangles[i] = source[ids[i]];
+            triangleIds[i] = ids[i];
+        }
+        bounds.clear();
+        bounds.shrink_to_fit();
+        centroids.clear();
+        centroids.shrink_to_fit();
+        ids.clear();
+        ids.shrink_to_fit();
+    }
+
+    static const char* simdPath() {
+#if defined(BVH_SSE2)
+        return "SSE2 packets";
+#else
+        return "scalar";
+#endif
+    }
+
+    size_t nodeCount() const {
+        return nodes.size();
+    }
+
+    // Prostopadłościan całej sceny (pusty przed build)
+    Aabb sceneBounds() const {
+        Aabb box;
+        if (!nodes.empty()) {
+            box.min = glm::vec3(nodes[0].min[0], nodes[0].min[1], nodes[0].min[2]);
+            box.max = glm::vec3(nodes[0].max[0], nodes[0].max[1], nodes[0].max[2]);
+        }
+        return box;
+    }
+
+    // Numer trójkąta w strumieniu wejściowym dla trafienia hit.triangle
+    uint32_t sourceTriangle(int triangle) const {
+        return triangleIds[triangle];
+    }
+
+    // Najbliższe trafienie dla każdego aktywnego promienia; triangle = -1 przy braku trafienia
+    void intersect(const RayPacket& rays, HitPacket& hits) const {
+        if (nodes.empty()) {
+            for (int lane = 0; lane < 4; ++lane) {
+                hits.t[lane] = rays.tmax[lane];
+                hits.u[lane] = hits.v[lane] = 0.0f;
+                hits.triangle[lane] = -1;
+            }
+            return;
+        }
+#if defined(BVH_SSE2)
+        intersectPacket(rays, hits);
+#else
+        for (int lane = 0; lane < 4; ++lane) {
+            BvhHit hit = { rays.tmax[lane], 0.0f, 0.0f, -1 };
+            if (rays.active & (1 << lane))
+                intersectRay(rays, lane, hit, false);
+            hits.t[lane] = hit.t;
+            hits.u[lane] = hit.u;
+            hits.v[lane] = hit.v;
+            hits.triangle[lane] = hit.triangle;
+        }
+#endif
+    }
+
+    // Maska aktywnych promieni, które trafiają cokolwiek przed tmax (promienie cienia)
+    int occluded(const RayPacket& rays) const {
+        if (nodes.empty())
+            return 0;
+#if defined(BVH_SSE2)
+        return occludedPacket(rays);
+#else
+        int mask = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+            BvhHit hit = { rays.tmax[lane], 0.0f, 0.0f, -1 };
+            if ((rays.active & (1 << lane)) && intersectRay(rays, lane, hit, true))
+                mask |= 1 << lane;
+        }
+        return mask;
+#endif
+    }
+
+private:
+    struct Task {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+
+    struct Bins {
+        Aabb bounds[3][BINS];
+        uint32_t counts[3][BINS] = {};
+    };
+
+    void buildSubtree(std::vector<BvhNode>& out, uint32_t begin, uint32_t end, uint32_t depth) {
+        out.reserve((end - begin) * 2 / MAX_LEAF + 1);
+        out.emplace_back();
+        Task stack[STACK_SIZE * 2];
+        int size = 0;
+        stack[size++] = Task{ 0, begin, end, depth };
+        while (size > 0) {
+            Task task = stack[--size];
+            uint32_t mid = splitNode(out, task, nullptr);
+            if (mid == task.begin)
+                continue;
+            uint32_t left = out[task.node].first;
+            assert(size + 2 <= STACK_SIZE * 2);
+            stack[size++] = Task{ left + 1, mid, task.end, task.depth + 1 };
+            stack[size++] = Task{ left, task.begin, mid, task.depth + 1 };
+        }
+    }
+
+    // Ustawia węzeł task.node jako liść albo dzieli go; zwraca granicę podziału lub task.begin dla liścia
+    uint32_t splitNode(std::vector<BvhNode>& out, const Task& task, ThreadPool* pool) {
+        uint32_t count = task.end - task.begin;
+        Aabb box, centroidBox;
+        Bins bins;
+        rangeBounds(task.begin, task.end, pool, box, centroidBox);
+        BvhNode& node = out[task.node];
+        for (int a = 0; a < 3; ++a) {
+            node.min[a] = box.min[a];
+            node.max[a] = box.max[a];
+        }
+        node.axis = 0;
+
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        if (count > 2 && task.depth < MEDIAN_DEPTH) {
+            binRange(task.begin, task.end, centroidBox, pool, bins);
+            for (int axis = 0; axis < 3; ++axis) {
+                if (centroidBox.max[axis] <= centroidBox.min[axis])
+                    continue;
+                // Koszty podziałów za kubełkiem 0..BINS-2: powierzchnia * liczba trójkątów po obu stronach
+                float leftCost[BINS];
+                Aabb accumulated;
+                uint32_t accumulatedCount = 0;
+                for (int i = 0; i < BINS - 1; ++i) {
+                    accumulated.grow(bins.bounds[axis][i]);
+                    accumulatedCount += bins.counts[axis][i];
+                    leftCost[i] = accumulated.area() * accumulatedCount;
+                }
+                accumulated = Aabb();
+                accumulatedCount = 0;
+                for (int i = BINS - 1; i > 0; --i) {
+                    accumulated.grow(bins.bounds[axis][i]);
+                    accumulatedCount += bins.counts[axis][i];
+                    float cost = leftCost[i - 1] + accumulated.area() * accumulatedCount;
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                }
+            }
+        }
+
+        // Liść, gdy podział nie jest tańszy od przecięcia wszystkich trójkątów (koszt przejścia = 1 trójkąt)
+        float leafCost = box.area() * count;
+        float splitCost = box.area() + bestCost;
+        uint32_t mid = task.begin;
+        if (bestAxis >= 0 && (splitCost < leafCost || count > MAX_LEAF)) {
+            float binScale = BINS / (centroidBox.max[bestAxis] - centroidBox.min[bestAxis]);
+            float axisMin = centroidBox.min[bestAxis];
+            uint32_t* split = std::partition(ids.data() + task.begin, ids.data() + task.end, [&](uint32_t id) {
+                return binIndex(centroids[id][bestAxis], axisMin, binScale) < bestSplit;
+            });
+            mid = (uint32_t)(split - ids.data());
+        }
+        // Głęboko w drzewie (zdegenerowana, skośna siatka): mediana wzdłuż najdłuższej osi środków
+        if (task.depth >= MEDIAN_DEPTH && count > MAX_LEAF) {
+            glm::vec3 extent = centroidBox.max - centroidBox.min;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+            mid = task.begin + count / 2;
+            std::nth_element(ids.data() + task.begin, ids.data() + mid, ids.data() + task.end, [&](uint32_t a, uint32_t b) {
+                return centroids[a][axis] < centroids[b][axis];
+            });
+            bestAxis = axis;
+        }
+        // Wszystkie środki w jednym punkcie - podział po połowie, żeby liście nie rosły ponad MAX_LEAF
+        if ((mid == task.begin || mid == task.end) && count > MAX_LEAF)
+            mid = task.begin + count / 2;
+        if (mid == task.begin || mid == task.end) {
+            out[task.node].first = task.begin;
+            out[task.node].count = (uint16_t)count;
+            return task.begin;
+        }
+
+        uint32_t left = (uint32_t)out.size();
+        out[task.node].first = left;
+        out[task.node].count = 0;
+        out[task.node].axis = (uint16_t)std::max(bestAxis, 0);
+        out.emplace_back();
+        out.emplace_back();
+        return mid;
+    }
+
+    static int binIndex(float value, float axisMin, float binScale) {
+        return std::min(BINS - 1, (int)((value - axisMin) * binScale));
+    }
+
+    void rangeBounds(uint32_t begin, uint32_t end, ThreadPool* pool, Aabb& box, Aabb& centroidBox) const {
+        auto accumulate = [&](size_t from, size_t to, Aabb& partBox, Aabb& partCentroids) {
+            for (size_t i = from; i < to; ++i) {
+                partBox.grow(bounds[ids[i]]);
+                partCentroids.grow(centroids[ids[i]]);
+            }
+        };
+        if (!pool || end - begin < PARALLEL_SPLIT) {
+            accumulate(begin, end, box, centroidBox);
+            return;
+        }
+        size_t chunk = 4096;
+        size_t chunks = (end - begin + chunk - 1) / chunk;
+        std::vector<Aabb> boxes(chunks), centroidBoxes(chunks);
+        pool->parallelFor(chunks, 1, [&](size_t first, size_t last, unsigned) {
+            for (size_t c = first; c < last; ++c)
+                accumulate(begin + c * chunk, std::min<size_t>(end, begin + (c + 1) * chunk), boxes[c], centroidBoxes[c]);
+        });
+        for (size_t c = 0; c < chunks; ++c) {
+            box.grow(boxes[c]);
+            centroidBox.grow(centroidBoxes[c]);
+        }
+    }
+
+    void binRange(uint32_t begin, uint32_t end, const Aabb& centroidBox, ThreadPool* pool, Bins& bins) const {
+        float scale[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = centroidBox.max[axis] - centroidBox.min[axis];
+            scale[axis] = extent > 0.0f ? BINS / extent : 0.0f;
+        }
+        auto accumulate = [&](size_t from, size_t to, Bins& part) {
+            for (size_t i = from; i < to; ++i) {
+                uint32_t id = ids[i];
+                for (int axis = 0; axis < 3; ++axis) {
+                    int bin = binIndex(centroids[id][axis], centroidBox.min[axis], scale[axis]);
+                    part.bounds[axis][bin].grow(bounds[id]);
+                    ++part.counts[axis][bin];
+                }
+            }
+        };
+        if (!pool || end - begin < PARALLEL_SPLIT) {
+            accumulate(begin, end, bins);
+            return;
+        }
+        size_t chunk = 4096;
+        size_t chunks = (end - begin + chunk - 1) / chunk;
+        std::vector<Bins> parts(chunks);
+        pool->parallelFor(chunks, 1, [&](size_t first, size_t last, unsigned) {
+            for (size_t c = first; c < last; ++c)
+                accumulate(begin + c * chunk, std::min<size_t>(end, begin + (c + 1) * chunk), parts[c]);
+        });
+        for (const Bins& part : parts) {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (int bin = 0; bin < BINS; ++bin) {
+                    bins.bounds[axis][bin].grow(part.bounds[axis][bin]);
+                    bins.counts[axis][bin] += part.counts[axis][bin];
+                }
+            }
+        }
+    }
+
+    // Jeden promień pakietu; anyHit - wystarczy dowolne trafienie (cień)
+    bool intersectRay(const RayPacket& rays, int lane, BvhHit& hit, bool anyHit) const {
+        glm::vec3 origin(rays.ox[lane], rays.oy[lane], rays.oz[lane]);
+        glm::vec3 direction(rays.dx[lane], rays.dy[lane], rays.dz[lane]);
+        glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        uint32_t stack[STACK_SIZE];
+        int size = 0;
+        stack[size++] = 0;
+        bool found = false;
+        while (size > 0) {
+            const BvhNode& node = nodes[stack[--size]];
+            float tNear = 0.0f;
+            float tFar = hit.t;
+            for (int axis = 0; axis < 3; ++axis) {
+                float t1 = (node.min[axis] - origin[axis]) * inverse[axis];
+                float t2 = (node.max[axis] - origin[axis]) * inverse[axis];
+                tNear = std::max(tNear, std::min(t1, t2));
+                tFar = std::min(tFar, std::max(t1, t2));
+            }
+            if (tNear > tFar)
+                continue;
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    if (intersectTriangle(triangles[i], origin, direction, hit)) {
+                        hit.triangle = (int)i;
+                        found = true;
+                        if (anyHit)
+                            return true;
+                    }
+                }
+                continue;
+            }
+            // Najpierw dziecko bliższe wzdłuż osi podziału
+            bool reverse = direction[node.axis] < 0.0f;
+            assert(size + 2 <= STACK_SIZE);
+            stack[size++] = node.first + (reverse ? 0 : 1);
+            stack[size++] = node.first + (reverse ? 1 : 0);
+        }
+        return found;
+    }
+
+    static bool intersectTriangle(const BvhTriangle& tri, const glm::vec3& origin, const glm::vec3& direction, BvhHit& hit) {
+        glm::vec3 p = glm::cross(direction, tri.e2);
+        float det = glm::dot(tri.e1, p);
+        if (std::fabs(det) < 1e-12f)
+            return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - tri.v0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, tri.e1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float t = glm::dot(tri.e2, q) * invDet;
+        if (t <= 0.0f || t >= hit.t)
+            return false;
+        hit.t = t;
+        hit.u = u;
+        hit.v = v;
+        return true;
+    }
+
+#if defined(BVH_SSE2)
+    static __m128 select(__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+        return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+    }
+
+    static __m128 laneMask(int active) {
+        return _mm_castsi128_ps(_mm_set_epi32((active & 8) ? -1 : 0, (active & 4) ? -1 : 0, (active & 2) ? -1 : 0, (active & 1) ? -1 : 0));
+    }
+
+    struct PacketState {
+        __m128 ox, oy, oz;
+        __m128 dx, dy, dz;
+        __m128 ix, iy, iz;
+        __m128 tmax;
+    };
+
+    static PacketState loadPacket(const RayPacket& rays) {
+        PacketState s;
+        s.ox = _mm_load_ps(rays.ox);
+        s.oy = _mm_load_ps(rays.oy);
+        s.oz = _mm_load_ps(rays.oz);
+        s.dx = _mm_load_ps(rays.dx);
+        s.dy = _mm_load_ps(rays.dy);
+        s.dz = _mm_load_ps(rays.dz);
+        const __m128 one = _mm_set1_ps(1.0f);
+        s.ix = _mm_div_ps(one, s.dx);
+        s.iy = _mm_div_ps(one, s.dy);
+        s.iz = _mm_div_ps(one, s.dz);
+        // Nieaktywne promienie mają tmax < 0, więc nie trafiają w żaden węzeł
+        s.tmax = select(laneMask(rays.active), _mm_load_ps(rays.tmax), _mm_set1_ps(-1.0f));
+        return s;
+    }
+
+    // Maska promieni przecinających prostopadłościan węzła przed tmax
+    static int hitNode(const BvhNode& node, const PacketState& s) {
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[0]), s.ox), s.ix);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[0]), s.ox), s.ix);
+        __m128 tNear = _mm_min_ps(t1, t2);
+        __m128 tFar = _mm_max_ps(t1, t2);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[1]), s.oy), s.iy);
+        t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[1]), s.oy), s.iy);
+        tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2));
+        tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[2]), s.oz), s.iz);
+        t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[2]), s.oz), s.iz);
+        tNear = _mm_max_ps(_mm_max_ps(tNear, _mm_min_ps(t1, t2)), _mm_setzero_ps());
+        tFar = _mm_min_ps(_mm_min_ps(tFar, _mm_max_ps(t1, t2)), s.tmax);
+        return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+    }
+
+    // Möller-Trumbore dla 4 promieni i jednego trójkąta; zwraca maskę trafień bliższych niż tmax
+    static __m128 hitTriangle(const BvhTriangle& tri, const PacketState& s, __m128& t, __m128& u, __m128& v) {
+        __m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y), e1z = _mm_set1_ps(tri.e1.z);
+        __m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y), e2z = _mm_set1_ps(tri.e2.z);
+        __m128 px = _mm_sub_ps(_mm_mul_ps(s.dy, e2z), _mm_mul_ps(s.dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(s.dz, e2x), _mm_mul_ps(s.dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(s.dx, e2y), _mm_mul_ps(s.dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        __m128 sx = _mm_sub_ps(s.ox, _mm_set1_ps(tri.v0.x));
+        __m128 sy = _mm_sub_ps(s.oy, _mm_set1_ps(tri.v0.y));
+        __m128 sz = _mm_sub_ps(s.oz, _mm_set1_ps(tri.v0.z));
+        u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s.dx, qx), _mm_mul_ps(s.dy, qy)), _mm_mul_ps(s.dz, qz)), invDet);
+        t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 hit = _mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, zero));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(t, s.tmax));
+        return hit;
+    }
+
+    void intersectPacket(const RayPacket& rays, HitPacket& hits) const {
+        PacketState s = loadPacket(rays);
+        __m128 hitU = _mm_setzero_ps();
+        __m128 hitV = _mm_setzero_ps();
+        __m128i hitTriangle4 = _mm_set1_epi32(-1);
+        int first = 0;
+        while (first < 4 && !(rays.active & (1 << first)))
+            ++first;
+        float leadDirection[3] = { rays.dx[first & 3], rays.dy[first & 3], rays.dz[first & 3] };
+
+        uint32_t stack[STACK_SIZE];
+        int size = 0;
+        stack[size++] = 0;
+        while (size > 0) {
+            const BvhNode& node = nodes[stack[--size]];
+            if (!hitNode(node, s))
+                continue;
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    __m128 t, u, v;
+                    __m128 mask = hitTriangle(triangles[i], s, t, u, v);
+                    if (!_mm_movemask_ps(mask))
+                        continue;
+                    s.tmax = select(mask, t, s.tmax);
+                    hitU = select(mask, u, hitU);
+                    hitV = select(mask, v, hitV);
+                    __m128i maskInt = _mm_castps_si128(mask);
+                    hitTriangle4 = _mm_or_si128(_mm_and_si128(maskInt, _mm_set1_epi32((int)i)), _mm_andnot_si128(maskInt, hitTriangle4));
+                }
+                continue;
+            }
+            // Kolejność dzieci według kierunku pierwszego aktywnego promienia - promienie pakietu są spójne
+            bool reverse = leadDirection[node.axis] < 0.0f;
+            assert(size + 2 <= STACK_SIZE);
+            stack[size++] = node.first + (reverse ? 0 : 1);
+            stack[size++] = node.first + (reverse ? 1 : 0);
+        }
+
+        _mm_store_ps(hits.t, s.tmax);
+        _mm_store_ps(hits.u, hitU);
+        _mm_store_ps(hits.v, hitV);
+        _mm_storeu_si128((__m128i*)hits.triangle, hitTriangle4);
+    }
+
+    int occludedPacket(const RayPacket& rays) const {
+        PacketState s = loadPacket(rays);
+        int occluded = 0;
+        uint32_t stack[STACK_SIZE];
+        int size = 0;
+        stack[size++] = 0;
+        while (size > 0) {
+            const BvhNode& node = nodes[stack[--size]];
+            if (!hitNode(node, s))
+                continue;
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    __m128 t, u, v;
+                    __m128 mask = hitTriangle(triangles[i], s, t, u, v);
+                    int laneHits = _mm_movemask_ps(mask);
+                    if (!laneHits)
+                        continue;
+                    // Zasłonięte promienie wyłączane z dalszego przejścia
+                    occluded |= laneHits;
+                    s.tmax = select(mask, _mm_set1_ps(-1.0f), s.tmax);
+                    if (occluded == rays.active)
+                        return occluded;
+                }
+                continue;
+            }
+            assert(size + 2 <= STACK_SIZE);
+            stack[size++] = node.first + 1;
+            stack[size++] = node.first;
+        }
+        return occluded;
+    }
+#endif
+
+    std::vector<BvhNode> nodes;
+    std::vector<BvhTriangle> triangles;
+    std::vector<uint32_t> triangleIds;
+
+    // Tylko na czas budowy
+    std::vector<Aabb> bounds;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> ids;
+};
@@ -0,0 +1,360 @@
+﻿#pragma once
+// Stronicowanie sceny z pliku ObjChunkFile wokół kamery. Kawałki indeksowane są rzadką siatką komórek
+// (tylko zajęte komórki z katalogu), więc zapytanie o otoczenie punktu odwiedza komórki w promieniu, a nie
+// wszystkie kawałki. Co klatkę:
+//  - kawałki w promieniu loadRadius od kamery są potrzebne: obecne dotykane w LRU, brakujące liczą klatkę
+//    jako przestój (stall),
+//  - kolejka wątku I/O budowana jest od nowa: najpierw potrzebne (od najbliższych), potem kawałki wokół
+//    punktu przewidzianego z prędkości kamery; niepobrane jeszcze żądania z poprzedniej klatki są anulowane,
+//  - wątek I/O czyta kawałki do pamięci (najwyżej MAX_READY czeka na wysłanie), a wątek GL wysyła do
+//    maxUploadsPerFrame z nich; przy przekroczeniu gpuBudget zwalniane są najdawniej używane kawałki,
+//    nigdy te dotknięte w bieżącej klatce. Zawartość VBO kopiuje UploadScheduler w ramach budżetu bajtów
+//    na klatkę, kawałek jest rysowany dopiero po ostatniej kopii.
+// Daleko od kamery kawałki zostają więc w pamięci GPU, dopóki budżet na to pozwala.
+// Układ atrybutów jak w grafika_7: 0 - pozycja, 1 - normalna, 2 - UV.
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "obj_stream.h"
+#include "upload_scheduler.h"
+
+// --stream plik.obj: model konwertowany (raz) do plik.obj.chunks i stronicowany wokół kamery,
+// --stream-memory MB: limit pamięci konwersji, --stream-radius r: promień wczytywania,
+// --stream-budget MB: budżet pamięci GPU na kawałki
+struct ChunkStreamConfig {
+    std::string objPath;
+    ObjStreamOptions options;
+    float loadRadius = 20.0f;
+    size_t gpuBudget = (size_t)256 << 20;
+};
+
+inline ChunkStreamConfig parseChunkStreamArgs(int argc, char** argv) {
+    ChunkStreamConfig config;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--stream") == 0)
+            config.objPath = argv[++i];
+        else if (std::strcmp(argv[i], "--stream-memory") == 0)
+            config.options.memoryCap = (size_t)std::atoi(argv[++i]) << 20;
+        else if (std::strcmp(argv[i], "--stream-radius") == 0)
+            config.loadRadius = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--stream-budget") == 0)
+            config.gpuBudget = (size_t)std::atoi(argv[++i]) << 20;
+    }
+    return config;
+}
+
+struct ChunkPagerStats {
+    size_t residentCells = 0;
+    size_t residentChunks = 0;
+    size_t residentBytes = 0;
+    // Żądania w kolejce, czytany kawałek i kawałki czekające na wysłanie
+    size_t queueDepth = 0;
+    // Potrzebne kawałki nieobecne (albo jeszcze wysyłane) w bieżącej klatce
+    size_t missingChunks = 0;
+    uint64_t stallFrames = 0;
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+};
+
+class ChunkPager {
+public:
+    static constexpr float PREFETCH_SECONDS = 1.0f;
+    static constexpr float VELOCITY_SMOOTHING = 0.2f;
+    static constexpr size_t MAX_READY = 16;
+
+    // readChunk wywołuje tylko wątek I/O; katalog i nagłówek pliku są po otwarciu niezmienne
+    ChunkPager(ObjChunkFile& file, UploadScheduler& uploads, float loadRadius, size_t gpuBudget, int maxUploadsPerFrame = 4)
+        : file(file), uploads(uploads), loadRadius(loadRadius), gpuBudget(gpuBudget), maxUploadsPerFrame(maxUploadsPerFrame),
+          chunks(file.chunks().size()) {
+        const ObjChunkHeader& header = file.header();
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const uint32_t* cell = file.chunks()[i].cell;
+            Cell& entry = cells[cellKey(cell[0], cell[1], cell[2])];
+            entry.chunks.push_back((uint32_t)i);
+            chunks[i].cell = &entry;
+        }
+        origin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        ioThread = std::thread(&ChunkPager::ioLoop, this);
+    }
+
+    ~ChunkPager() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        ioThread.join();
+        for (uint32_t index : lru)
+            release(chunks[index]);
+    }
+
+    ChunkPager(const ChunkPager&) = delete;
+    ChunkPager& operator=(const ChunkPager&) = delete;
+
+    void update(const glm::vec3& camera, float deltaTime) {
+        ++frame;
+        if (hasCamera && deltaTime > 0.0f)
+            velocity = glm::mix(velocity, (camera - lastCamera) / deltaTime, VELOCITY_SMOOTHING);
+        lastCamera = camera;
+        hasCamera = true;
+
+        // Kawałki odłożone przy pełnym budżecie wracają do kolejki dopiero, gdy kamera zmieni komórkę
+        // albo coś zwolni miejsce - inaczej ten sam kawałek byłby czytany z dysku co klatkę
+        cameraCell = glm::ivec3(glm::floor((camera - origin) / file.header().cellSize));
+        if (!deferred.empty() && (cameraCell != deferredCell || releases != deferredReleases)) {
+            for (uint32_t index : deferred) {
+                if (chunks[index].state == State::Deferred)
+                    chunks[index].state = State::Unloaded;
+            }
+            deferred.clear();
+        }
+
+        gather(camera, needed);
+        stats.missingChunks = 0;
+        for (const auto& entry : needed) {
+            Chunk& chunk = chunks[entry.second];
+            if (chunk.state == State::Resident)
+                touch(entry.second);
+            if (chunk.state == State::Resident ? !chunk.uploaded : chunk.state != State::Failed)
+                ++stats.missingChunks;
+        }
+        if (stats.missingChunks > 0)
+            ++stats.stallFrames;
+        gather(camera + velocity * PREFETCH_SECONDS, prefetch);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (uint32_t index : requests)
+                chunks[index].state = State::Unloaded;
+            requests.clear();
+            for (const auto* list : { &needed, &prefetch }) {
+                for (const auto& entry : *list) {
+                    Chunk& chunk = chunks[entry.second];
+                    if (chunk.state == State::Unloaded) {
+                        chunk.state = State::Requested;
+                        requests.push_back(entry.second);
+                    }
+                }
+            }
+            size_t take = std::min(ready.size(), (size_t)maxUploadsPerFrame);
+            arrived.assign(std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.begin() + take));
+            ready.erase(ready.begin(), ready.begin() + take);
+            stats.queueDepth = requests.size() + inFlight + ready.size();
+        }
+        wake.notify_one();
+
+        for (ReadChunk& read : arrived)
+            upload(read);
+        arrived.clear();
+    }
+
+    void draw() const {
+        for (uint32_t index : lru) {
+            if (!chunks[index].uploaded)
+                continue;
+            glBindVertexArray(chunks[index].vao);
+            glDrawArrays(GL_TRIANGLES, 0, chunks[index].vertexCount);
+        }
+        glBindVertexArray(0);
+    }
+
+    const ChunkPagerStats& statistics() const {
+        return stats;
+    }
+
+private:
+    enum class State { Unloaded, Requested, Resident, Deferred, Failed };
+
+    struct Cell {
+        std::vector<uint32_t> chunks;
+        size_t resident = 0;
+    };
+
+    struct Chunk {
+        State state = State::Unloaded;
+        Cell* cell = nullptr;
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLsizei vertexCount = 0;
+        bool uploaded = false;
+        uint64_t lastUsed = 0;
+        std::list<uint32_t>::iterator lruPosition;
+    };
+
+    struct ReadChunk {
+        uint32_t index;
+        bool ok;
+        std::vector<float> vertices;
+    };
+
+    uint64_t cellKey(uint32_t x, uint32_t y, uint32_t z) const {
+        const uint32_t* grid = file.header().grid;
+        return ((uint64_t)z * grid[1] + y) * grid[0] + x;
+    }
+
+    static float boxDistance(const ObjChunkInfo& chunk, const glm::vec3& point) {
+        glm::vec3 low(chunk.boundsMin[0], chunk.boundsMin[1], chunk.boundsMin[2]);
+        glm::vec3 high(chunk.boundsMax[0], chunk.boundsMax[1], chunk.boundsMax[2]);
+        return glm::length(glm::max(glm::max(low - point, point - high), glm::vec3(0.0f)));
+    }
+
+    // Kawałki, których AABB leży w promieniu od punktu, posortowane według odległości
+    void gather(const glm::vec3& point, std::vector<std::pair<float, uint32_t>>& out) const {
+        out.clear();
+        const ObjChunkHeader& header = file.header();
+        int low[3], high[3];
+        for (int i = 0; i < 3; ++i) {
+            int last = (int)header.grid[i] - 1;
+            low[i] = std::max(0, std::min(last, (int)std::floor((point[i] - loadRadius - origin[i]) / header.cellSize)));
+            high[i] = std::max(0, std::min(last, (int)std::floor((point[i] + loadRadius - origin[i]) / header.cellSize)));
+        }
+        for (int z = low[2]; z <= high[2]; ++z) {
+            for (int y = low[1]; y <= high[1]; ++y) {
+                for (int x = low[0]; x <= high[0]; ++x) {
+                    auto cell = cells.find(cellKey(x, y, z));
+                    if (cell == cells.end())
+                        continue;
+                    for (uint32_t index : cell->second.chunks) {
+                        float distance = boxDistance(file.chunks()[index], point);
+                        if (distance <= loadRadius)
+                            out.push_back(std::make_pair(distance, index));
+                    }
+                }
+            }
+        }
+        std::sort(out.begin(), out.end());
+    }
+
+    void touch(uint32_t index) {
+        Chunk& chunk = chunks[index];
+        chunk.lastUsed = frame;
+        lru.splice(lru.end(), lru, chunk.lruPosition);
+    }
+
+    void upload(ReadChunk& read) {
+        Chunk& chunk = chunks[read.index];
+        if (!read.ok) {
+            chunk.state = State::Failed;
+            return;
+        }
+        size_t size = read.vertices.size() * sizeof(float);
+        while (stats.residentBytes + size > gpuBudget && !lru.empty() && chunks[lru.front()].lastUsed != frame) {
+            uint32_t victim = lru.front();
+            lru.pop_front();
+            release(chunks[victim]);
+            ++stats.evictions;
+        }
+        if (stats.residentBytes + size > gpuBudget) {
+            // Budżet zajęty przez kawałki tej klatki - spróbujemy ponownie, gdy kamera się przesunie
+            if (deferred.empty()) {
+                deferredCell = cameraCell;
+                deferredReleases = releases;
+            }
+            chunk.state = State::Deferred;
+            deferred.push_back(read.index);
+            return;
+        }
+
+        const GLsizei stride = (GLsizei)(file.header().floatsPerVertex * sizeof(float));
+        glGenVertexArrays(1, &chunk.vao);
+        glGenBuffers(1, &chunk.vbo);
+        glBindVertexArray(chunk.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        const uint32_t index = read.index;
+        uploads.queueBuffer(chunk.vbo, read.vertices.data(), size, GL_STATIC_DRAW, [this, index]() { chunks[index].uploaded = true; });
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+
+        chunk.state = State::Resident;
+        chunk.vertexCount = (GLsizei)file.chunks()[read.index].vertexCount;
+        chunk.lastUsed = frame;
+        chunk.lruPosition = lru.insert(lru.end(), read.index);
+        if (chunk.cell->resident++ == 0)
+            ++stats.residentCells;
+        ++stats.residentChunks;
+        stats.residentBytes += size;
+        ++stats.loads;
+    }
+
+    void release(Chunk& chunk) {
+        uploads.cancelBuffer(chunk.vbo);
+        glDeleteBuffers(1, &chunk.vbo);
+        glDeleteVertexArrays(1, &chunk.vao);
+        chunk.vao = 0;
+        chunk.vbo = 0;
+        chunk.uploaded = false;
+        chunk.state = State::Unloaded;
+        ++releases;
+        if (--chunk.cell->resident == 0)
+            --stats.residentCells;
+        --stats.residentChunks;
+        stats.residentBytes -= (size_t)chunk.vertexCount * file.header().floatsPerVertex * sizeof(float);
+    }
+
+    void ioLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this]() { return stopping || (!requests.empty() && ready.size() < MAX_READY); });
+            if (stopping)
+                return;
+            ReadChunk read;
+            read.index = requests.front();
+            requests.pop_front();
+            ++inFlight;
+            lock.unlock();
+            read.ok = file.readChunk(read.index, read.vertices);
+            lock.lock();
+            --inFlight;
+            ready.push_back(std::move(read));
+        }
+    }
+
+    ObjChunkFile& file;
+    UploadScheduler& uploads;
+    float loadRadius;
+    size_t gpuBudget;
+    int maxUploadsPerFrame;
+    glm::vec3 origin;
+    std::unordered_map<uint64_t, Cell> cells;
+    std::vector<Chunk> chunks;
+    // Obecne kawałki od najdawniej używanego
+    std::list<uint32_t> lru;
+    std::vector<std::pair<float, uint32_t>> needed;
+    std::vector<std::pair<float, uint32_t>> prefetch;
+    std::vector<ReadChunk> arrived;
+    uint64_t frame = 0;
+    glm::vec3 lastCamera = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+    bool hasCamera = false;
+    glm::ivec3 cameraCell = glm::ivec3(0);
+    // Kawałki, które nie zmieściły się w budżecie, oraz komórka kamery i licznik zwolnień z chwili odłożenia
+    std::vector<uint32_t> deferred;
+    glm::ivec3 deferredCell = glm::ivec3(0);
+    uint64_t deferredReleases = 0;
+    uint64_t releases = 0;
+    ChunkPagerStats stats;
+
+    std::thread ioThread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<uint32_t> requests;
+    std::deque<ReadChunk> ready;
+    size_t inFlight = 0;
+    bool stopping = false;
+};
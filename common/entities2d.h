@@ -0,0 +1,141 @@
+﻿#pragma once
+// Poruszające się obiekty 2D w układzie SoA (osobne tablice x, y, vx, vy). Aktualizacja przesuwa
+// pozycje i odbija je od krawędzi prostokąta bez rozgałęzień: maski porównań wybierają pozycję odbitą
+// od krawędzi i odwracają znak prędkości. Ścieżki: AVX2 (8 obiektów naraz), SSE2 (4) i skalarna
+// dla pozostałych architektur oraz końcówek tablic. Z pulą wątków praca dzielona jest na kawałki.
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "thread_pool.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ENTITIES2D_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENTITIES2D_SSE2 1
+#endif
+
+class Entities2D {
+public:
+    // Wielokrotność szerokości AVX2, żeby kawałki dla wątków zaczynały się na pełnym wektorze
+    static constexpr size_t CHUNK = 16384;
+
+    static const char* simdPath() {
+#if defined(ENTITIES2D_AVX2)
+        return "AVX2";
+#elif defined(ENTITIES2D_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    void resize(size_t count) {
+        x.resize(count);
+        y.resize(count);
+        vx.resize(count);
+        vy.resize(count);
+    }
+
+    size_t size() const {
+        return x.size();
+    }
+
+    // Krok symulacji. Obiekt mieści się w [minX, maxX] x [minY, maxY] (lewy górny róg).
+    void update(float dt, float minX, float minY, float maxX, float maxY, ThreadPool* pool = nullptr) {
+        Bounds bounds = { dt, minX, minY, maxX, maxY };
+        if (!pool) {
+            updateRange(0, size(), bounds);
+            return;
+        }
+        pool->parallelFor(size(), CHUNK, [&](size_t begin, size_t end, unsigned) {
+            updateRange(begin, end, bounds);
+        });
+    }
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+
+private:
+    struct Bounds {
+        float dt;
+        float minX, minY;
+        float maxX, maxY;
+    };
+
+    void updateRange(size_t begin, size_t end, const Bounds& b) {
+        size_t i = begin;
+#if defined(ENTITIES2D_AVX2)
+        const __m256 dt = _mm256_set1_ps(b.dt);
+        for (; i + 8 <= end; i += 8) {
+            moveAxis8(&x[i], &vx[i], dt, b.minX, b.maxX);
+            moveAxis8(&y[i], &vy[i], dt, b.minY, b.maxY);
+        }
+#elif defined(ENTITIES2D_SSE2)
+        const __m128 dt = _mm_set1_ps(b.dt);
+        for (; i + 4 <= end; i += 4) {
+            moveAxis4(&x[i], &vx[i], dt, b.minX, b.maxX);
+            moveAxis4(&y[i], &vy[i], dt, b.minY, b.maxY);
+        }
+#endif
+        for (; i < end; ++i) {
+            moveAxis(x[i], vx[i], b.dt, b.minX, b.maxX);
+            moveAxis(y[i], vy[i], b.dt, b.minY, b.maxY);
+        }
+    }
+
+    // Wersja skalarna tej samej arytmetyki - wyniki identyczne z wektorowymi
+    static void moveAxis(float& position, float& velocity, float dt, float low, float high) {
+        float p = position + velocity * dt;
+        bool below = p < low;
+        bool above = p > high;
+        p = below ? 2.0f * low - p : p;
+        p = above ? 2.0f * high - p : p;
+        uint32_t bits;
+        std::memcpy(&bits, &velocity, sizeof(bits));
+        bits ^= (below || above) ? 0x80000000u : 0u;
+        std::memcpy(&velocity, &bits, sizeof(bits));
+        position = p;
+    }
+
+#if defined(ENTITIES2D_AVX2)
+    static void moveAxis8(float* position, float* velocity, __m256 dt, float low, float high) {
+        const __m256 lowV = _mm256_set1_ps(low);
+        const __m256 highV = _mm256_set1_ps(high);
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 v = _mm256_loadu_ps(velocity);
+        __m256 p = _mm256_add_ps(_mm256_loadu_ps(position), _mm256_mul_ps(v, dt));
+        __m256 below = _mm256_cmp_ps(p, lowV, _CMP_LT_OQ);
+        __m256 above = _mm256_cmp_ps(p, highV, _CMP_GT_OQ);
+        p = _mm256_blendv_ps(p, _mm256_sub_ps(_mm256_add_ps(lowV, lowV), p), below);
+        p = _mm256_blendv_ps(p, _mm256_sub_ps(_mm256_add_ps(highV, highV), p), above);
+        v = _mm256_xor_ps(v, _mm256_and_ps(_mm256_or_ps(below, above), sign));
+        _mm256_storeu_ps(position, p);
+        _mm256_storeu_ps(velocity, v);
+    }
+#elif defined(ENTITIES2D_SSE2)
+    static __m128 select4(__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+        return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+    }
+
+    static void moveAxis4(float* position, float* velocity, __m128 dt, float low, float high) {
+        const __m128 lowV = _mm_set1_ps(low);
+        const __m128 highV = _mm_set1_ps(high);
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 v = _mm_loadu_ps(velocity);
+        __m128 p = _mm_add_ps(_mm_loadu_ps(position), _mm_mul_ps(v, dt));
+        __m128 below = _mm_cmplt_ps(p, lowV);
+        __m128 above = _mm_cmpgt_ps(p, highV);
+        p = select4(below, _mm_sub_ps(_mm_add_ps(lowV, lowV), p), p);
+        p = select4(above, _mm_sub_ps(_mm_add_ps(highV, highV), p), p);
+        v = _mm_xor_ps(v, _mm_and_ps(_mm_or_ps(below, above), sign));
+        _mm_storeu_ps(position, p);
+        _mm_storeu_ps(velocity, v);
+    }
+#endif
+};
@@ -0,0 +1,172 @@
+﻿#pragma once
+// Alokator liniowy dla danych jednej klatki (listy rysowania, wyniki odrzucania, dane uniformów).
+// allocate przesuwa wskaźnik w bieżącym bloku, pojedyncze zwolnienia są ignorowane (poza ostatnią alokacją,
+// żeby rosnący wektor mógł się przesunąć w miejscu), a reset() na końcu klatki oddaje wszystko naraz.
+// Bloki dobrane w pierwszych klatkach zostają, więc w stanie ustalonym arena nie woła malloc.
+// FrameArenas trzyma osobną arenę na wątek - indeks jak w ThreadPool::parallelFor, bez blokad.
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+class FrameArena {
+public:
+    static constexpr size_t BLOCK_BYTES = 1 << 20;
+
+    explicit FrameArena(size_t blockBytes = BLOCK_BYTES) : blockBytes(blockBytes) {
+        blocks.reserve(16);
+        addBlock(blockBytes);
+    }
+
+    ~FrameArena() {
+        for (Block& block : blocks)
+            std::free(block.data);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        for (;;) {
+            Block& block = blocks[current];
+            uintptr_t base = (uintptr_t)block.data;
+            size_t offset = (size_t)(((base + top + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+            if (offset + bytes <= block.size) {
+                top = offset + bytes;
+                return block.data + offset;
+            }
+            // Zachowany blok za mały dla tej alokacji zostaje w tej klatce pominięty
+            filledBytes += top;
+            top = 0;
+            if (++current == blocks.size())
+                addBlock(std::max(blockBytes, bytes + alignment));
+        }
+    }
+
+    void deallocate(void* pointer, size_t bytes) {
+        char* begin = (char*)pointer;
+        if (begin >= blocks[current].data && begin + bytes == blocks[current].data + top)
+            top = begin - blocks[current].data;
+    }
+
+    // Na końcu klatki, gdy nic z areny nie jest już używane
+    void reset() {
+        peak = std::max(peak, bytesUsed());
+        current = 0;
+        top = 0;
+        filledBytes = 0;
+    }
+
+    size_t bytesUsed() const {
+        return filledBytes + top;
+    }
+
+    size_t peakBytes() const {
+        return std::max(peak, bytesUsed());
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks)
+            total += block.size;
+        return total;
+    }
+
+    size_t blockCount() const {
+        return blocks.size();
+    }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void addBlock(size_t size) {
+        char* data = (char*)std::malloc(size);
+        if (!data)
+            throw std::bad_alloc();
+        blocks.push_back(Block{ data, size });
+    }
+
+    size_t blockBytes;
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t top = 0;
+    size_t filledBytes = 0;
+    size_t peak = 0;
+};
+
+class FrameArenas {
+public:
+    explicit FrameArenas(unsigned threadCount, size_t blockBytes = FrameArena::BLOCK_BYTES) {
+        for (unsigned i = 0; i < threadCount; ++i)
+            arenas.emplace_back(new FrameArena(blockBytes));
+    }
+
+    FrameArena& operator[](unsigned thread) {
+        return *arenas[thread];
+    }
+
+    unsigned size() const {
+        return (unsigned)arenas.size();
+    }
+
+    void reset() {
+        for (auto& arena : arenas)
+            arena->reset();
+    }
+
+    size_t bytesUsed() const {
+        size_t total = 0;
+        for (const auto& arena : arenas)
+            total += arena->bytesUsed();
+        return total;
+    }
+
+private:
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+};
+
+// Alokator STL na arenie klatki; kontener musi zniknąć (albo zostać wyczyszczony) przed reset()
+template<typename T>
+class FrameAllocator {
+public:
+    using value_type = T;
+
+    explicit FrameAllocator(FrameArena& arena) noexcept : arena(&arena) {
+    }
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) noexcept : arena(other.arena) {
+    }
+
+    T* allocate(size_t count) {
+        return (T*)arena->allocate(count * sizeof(T), alignof(T));
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        arena->deallocate(pointer, count * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const FrameAllocator<U>& other) const noexcept {
+        return arena != other.arena;
+    }
+
+    FrameArena* arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+using FrameString = std::basic_string<char, std::char_traits<char>, FrameAllocator<char>>;
@@ -0,0 +1,155 @@
+﻿#pragma once
+// Przekazywanie klatek z wątku symulacji do wątku renderującego. SpscRing to bezblokadowa kolejka
+// jeden producent - jeden konsument; zmienna warunkowa jest używana tylko wtedy, gdy któraś strona musi
+// zasnąć (kolejka pełna albo pusta), więc w zwykłym przebiegu push/pop to kilka operacji atomowych.
+// LatencyMeter mierzy czas od odczytu wejścia do powrotu z display() i liczbę klatek na sekundę.
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+// --render-thread: GL i prezentacja na osobnym wątku, zdarzenia i symulacja na głównym
+inline bool parseRenderThread(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--render-thread") == 0)
+            return true;
+    }
+    return false;
+}
+
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Tylko wątek producenta
+    bool tryPush(const T& item) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == Capacity)
+            return false;
+        slots[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    // Tylko wątek konsumenta
+    bool tryPop(T& item) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (tailIndex.load(std::memory_order_acquire) == head)
+            return false;
+        item = slots[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    // Wersje blokujące - czekają uśpione, aż druga strona zwolni lub doda element
+    void push(const T& item) {
+        while (!tryPush(item)) {
+            sleepUntil([this] {
+                return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire) < Capacity;
+            });
+        }
+    }
+
+    void pop(T& item) {
+        while (!tryPop(item)) {
+            sleepUntil([this] {
+                return tailIndex.load(std::memory_order_acquire) != headIndex.load(std::memory_order_acquire);
+            });
+        }
+    }
+
+private:
+    // Bariery po obu stronach: albo śpiący zobaczy nowy indeks przed zaśnięciem, albo budzący zobaczy śpiącego
+    void signal() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_all();
+        }
+    }
+
+    template <typename Ready>
+    void sleepUntil(Ready ready) {
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake.wait(lock, ready);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    T slots[Capacity];
+    alignas(64) std::atomic<size_t> headIndex{ 0 };
+    alignas(64) std::atomic<size_t> tailIndex{ 0 };
+    alignas(64) std::atomic<int> sleepers{ 0 };
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+class LatencyMeter {
+public:
+    static constexpr int HISTORY = 256;
+
+    // Sekundy na zegarze monotonicznym - ten sam zegar na obu wątkach
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    LatencyMeter() {
+        windowStart = now();
+    }
+
+    // Wywoływane po display(); inputTime to now() z chwili odczytu wejścia dla tej klatki
+    void frameShown(double inputTime) {
+        history[next] = (float)((now() - inputTime) * 1000.0);
+        next = (next + 1) % HISTORY;
+        if (count < HISTORY)
+            ++count;
+        ++windowFrames;
+    }
+
+    // Średnie i p99 opóźnienia z ostatnich HISTORY klatek oraz liczba klatek na sekundę od ostatniego raportu
+    void report(std::ostream& out, const char* mode) {
+        double current = now();
+        double fps = windowFrames / std::max(current - windowStart, 1.0e-6);
+        windowStart = current;
+        windowFrames = 0;
+        if (count == 0)
+            return;
+
+        float sum = 0.0f;
+        for (int i = 0; i < count; ++i) {
+            scratch[i] = history[i];
+            sum += history[i];
+        }
+        int p99Index = std::max(0, (int)std::ceil(count * 0.99f) - 1);
+        std::nth_element(scratch, scratch + p99Index, scratch + count);
+
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(2) << "[" << mode << "] input-to-present avg " << sum / count
+            << " p99 " << scratch[p99Index] << " ms, " << std::setprecision(1) << fps << " FPS" << std::endl;
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    float history[HISTORY] = {};
+    float scratch[HISTORY] = {};
+    int next = 0;
+    int count = 0;
+    int windowFrames = 0;
+    double windowStart = 0.0;
+};
@@ -0,0 +1,143 @@
+﻿#pragma once
+// Statystyki klatek do HUD-a i pliku CSV. Liczniki zbierane są co klatkę, a tekst formatowany jest
+// do stałego bufora tylko co updateInterval sekund - w pętli nie ma żadnej alokacji na stercie.
+#include <cstdio>
+#include <cstddef>
+#include <algorithm>
+
+class FrameStats {
+public:
+    // Przedziały histogramu czasu klatki w ms; ostatni przedział jest otwarty
+    static constexpr int BIN_COUNT = 8;
+    static constexpr int BAR_WIDTH = 20;
+    // Znak rysowany przez TextOverlay jako pełny blok
+    static constexpr char BAR_CHAR = '\x7f';
+
+    explicit FrameStats(float updateInterval = 0.25f) : updateInterval(updateInterval) {
+        buffer[0] = '\0';
+        resetWindow();
+    }
+
+    void countDraw(unsigned triangles) {
+        ++drawCalls;
+        triangleCount += triangles;
+    }
+
+    void countUpload(size_t bytes) {
+        uploadBytes += bytes;
+    }
+
+    // Zamyka klatkę. Zwraca true, gdy minęło updateInterval i text() zawiera nowe wartości.
+    bool endFrame(float frameSeconds) {
+        float ms = frameSeconds * 1000.0f;
+        ++frames;
+        windowTime += frameSeconds;
+        totalTime += frameSeconds;
+        minMs = std::min(minMs, ms);
+        maxMs = std::max(maxMs, ms);
+        int bin = 0;
+        while (bin < BIN_COUNT - 1 && ms >= binEdges[bin])
+            ++bin;
+        ++bins[bin];
+        totalDraws += drawCalls;
+        totalTriangles += triangleCount;
+        totalUpload += uploadBytes;
+        drawCalls = 0;
+        triangleCount = 0;
+        uploadBytes = 0;
+
+        if (windowTime < updateInterval)
+            return false;
+        publish();
+        resetWindow();
+        return true;
+    }
+
+    const char* text() const {
+        return buffer;
+    }
+
+    void writeCsvHeader(FILE* file) const {
+        std::fputs("time_s,fps,avg_ms,min_ms,max_ms,draws,triangles,upload_bytes", file);
+        for (int i = 0; i < BIN_COUNT; ++i)
+            std::fprintf(file, ",bin_%s", binLabels[i]);
+        std::fputc('\n', file);
+    }
+
+    // Jeden wiersz na odświeżenie - wartości z ostatniego okna, liczniki jako średnie na klatkę
+    void writeCsvRow(FILE* file) const {
+        std::fprintf(file, "%.3f,%.2f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f", totalTime, published.fps, published.avgMs,
+            published.minMs, published.maxMs, published.draws, published.triangles, published.uploadBytes);
+        for (int i = 0; i < BIN_COUNT; ++i)
+            std::fprintf(file, ",%d", published.bins[i]);
+        std::fputc('\n', file);
+    }
+
+private:
+    struct Snapshot {
+        float fps = 0.0f;
+        float avgMs = 0.0f;
+        float minMs = 0.0f;
+        float maxMs = 0.0f;
+        double draws = 0.0;
+        double triangles = 0.0;
+        double uploadBytes = 0.0;
+        int bins[BIN_COUNT] = {};
+    };
+
+    void publish() {
+        published.fps = frames / windowTime;
+        published.avgMs = windowTime * 1000.0f / frames;
+        published.minMs = minMs;
+        published.maxMs = maxMs;
+        published.draws = (double)totalDraws / frames;
+        published.triangles = (double)totalTriangles / frames;
+        published.uploadBytes = (double)totalUpload / frames;
+        std::copy(bins, bins + BIN_COUNT, published.bins);
+
+        int length = std::snprintf(buffer, sizeof(buffer),
+            "FPS %.1f  %.2f MS (MIN %.2f MAX %.2f)\nDRAWS %.0f  TRIS %.0f  UPLOAD %.0f B/FRAME\n",
+            published.fps, published.avgMs, published.minMs, published.maxMs,
+            published.draws, published.triangles, published.uploadBytes);
+        for (int i = 0; i < BIN_COUNT && length > 0 && length < (int)sizeof(buffer); ++i) {
+            char bar[BAR_WIDTH + 1];
+            int width = (bins[i] * BAR_WIDTH + frames - 1) / frames;
+            std::fill(bar, bar + width, BAR_CHAR);
+            bar[width] = '\0';
+            length += std::snprintf(buffer + length, sizeof(buffer) - length, "%5s %-*s %3d%%\n",
+                binLabels[i], BAR_WIDTH, bar, bins[i] * 100 / frames);
+        }
+    }
+
+    void resetWindow() {
+        frames = 0;
+        windowTime = 0.0f;
+        minMs = 1.0e9f;
+        maxMs = 0.0f;
+        totalDraws = 0;
+        totalTriangles = 0;
+        totalUpload = 0;
+        std::fill(bins, bins + BIN_COUNT, 0);
+    }
+
+    const float binEdges[BIN_COUNT - 1] = { 8.0f, 17.0f, 25.0f, 34.0f, 50.0f, 67.0f, 100.0f };
+    const char* const binLabels[BIN_COUNT] = { "<8", "<17", "<25", "<34", "<50", "<67", "<100", "100+" };
+
+    float updateInterval;
+    char buffer[1024];
+    Snapshot published;
+
+    int frames = 0;
+    float windowTime = 0.0f;
+    double totalTime = 0.0;
+    float minMs = 0.0f;
+    float maxMs = 0.0f;
+    int bins[BIN_COUNT] = {};
+    unsigned long long totalDraws = 0;
+    unsigned long long totalTriangles = 0;
+    unsigned long long totalUpload = 0;
+
+    unsigned drawCalls = 0;
+    unsigned long long triangleCount = 0;
+    size_t uploadBytes = 0;
+};
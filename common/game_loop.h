@@ -0,0 +1,75 @@
+﻿#pragma once
+// Stały krok symulacji niezależny od częstotliwości rysowania. Czas klatki trafia do akumulatora,
+// z którego pętla wykonuje tyle kroków update, ile się w nim mieści; reszta (alpha) służy do interpolacji
+// rysowanego stanu między dwoma ostatnimi krokami, więc ruch jest płynny przy 30, 60 czy 144 Hz.
+// Nagłówek nie zależy od SFML ani Allegro - czas klatki podaje wywołujący.
+#include <cmath>
+#include <cstring>
+
+enum class PresentMode {
+    VSync,
+    Uncapped,
+};
+
+// Domyślnie synchronizacja z odświeżaniem monitora; --uncapped rysuje tak szybko, jak się da
+inline PresentMode parsePresentMode(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--uncapped") == 0)
+            return PresentMode::Uncapped;
+    }
+    return PresentMode::VSync;
+}
+
+class FixedTimestep {
+public:
+    // maxSteps ogranicza nadrabianie po długiej klatce (debugger, przeciąganie okna) - nadmiar jest odrzucany
+    explicit FixedTimestep(double stepSeconds = 1.0 / 60.0, int maxSteps = 8)
+        : stepSeconds(stepSeconds), maxSteps(maxSteps) {
+    }
+
+    // Dodaje czas klatki i zwraca liczbę kroków symulacji do wykonania przed rysowaniem
+    int advance(double frameSeconds) {
+        accumulator += frameSeconds;
+        int steps = 0;
+        while (accumulator >= stepSeconds && steps < maxSteps) {
+            accumulator -= stepSeconds;
+            ++steps;
+        }
+        if (accumulator >= stepSeconds) {
+            droppedSeconds += accumulator - std::fmod(accumulator, stepSeconds);
+            accumulator = std::fmod(accumulator, stepSeconds);
+        }
+        ticks += steps;
+        return steps;
+    }
+
+    float step() const {
+        return (float)stepSeconds;
+    }
+
+    // Ułamek kroku, który już upłynął od ostatniego update: 0 - poprzedni stan, 1 - bieżący
+    float alpha() const {
+        return (float)(accumulator / stepSeconds);
+    }
+
+    unsigned long long tickCount() const {
+        return ticks;
+    }
+
+    double dropped() const {
+        return droppedSeconds;
+    }
+
+private:
+    double stepSeconds;
+    int maxSteps;
+    double accumulator = 0.0;
+    double droppedSeconds = 0.0;
+    unsigned long long ticks = 0;
+};
+
+// Stan do narysowania między krokiem poprzednim a bieżącym
+template <typename T>
+T interpolate(const T& previous, const T& current, float alpha) {
+    return previous + (current - previous) * alpha;
+}
@@ -0,0 +1,411 @@
+﻿#pragma once
+// Cień stanu GL: program, VAO, tekstury na jednostkach, bufory, framebuffer, przełączniki (depth, blend,
+// cull), funkcje depth/blend oraz wartości uniformów dla każdego programu. Wywołanie, które nie zmienia
+// stanu, nie trafia do sterownika i jest tylko liczone. Kod, który zmienia stan z pominięciem cache
+// (konfiguracja przy starcie, nakładka, pager), musi potem wywołać invalidateBindings() albo invalidate().
+// DrawList sortuje rysowania po 64-bitowym kluczu stanu, żeby obiekty z tym samym programem, teksturą
+// i VAO szły jeden po drugim. Tylko z wątku, który ma kontekst GL.
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <ostream>
+
+enum class GlStateKind {
+    Program,
+    VertexArray,
+    Texture,
+    Buffer,
+    Framebuffer,
+    Fixed,
+    Uniform,
+    Count
+};
+
+struct GlStateStats {
+    // Dla każdego GlStateKind: ile razy poproszono o zmianę i ile z tego dotarło do GL
+    uint64_t requested[(int)GlStateKind::Count] = {};
+    uint64_t issued[(int)GlStateKind::Count] = {};
+    uint64_t uniformBytes = 0;
+
+    uint64_t totalRequested() const {
+        uint64_t total = 0;
+        for (uint64_t count : requested)
+            total += count;
+        return total;
+    }
+
+    uint64_t totalIssued() const {
+        uint64_t total = 0;
+        for (uint64_t count : issued)
+            total += count;
+        return total;
+    }
+};
+
+class GlStateCache {
+public:
+    static constexpr int TEXTURE_UNITS = 16;
+
+    GlStateCache() {
+        invalidate();
+    }
+
+    GlStateCache(const GlStateCache&) = delete;
+    GlStateCache& operator=(const GlStateCache&) = delete;
+
+    void useProgram(GLuint program) {
+        if (!request(GlStateKind::Program, program != currentProgram))
+            return;
+        glUseProgram(program);
+        currentProgram = program;
+        currentUniforms = &uniforms[program];
+    }
+
+    // Element buffer należy do VAO, więc po zmianie VAO jego cień jest nieznany
+    void bindVertexArray(GLuint vertexArray) {
+        if (!request(GlStateKind::VertexArray, vertexArray != currentVertexArray))
+            return;
+        glBindVertexArray(vertexArray);
+        currentVertexArray = vertexArray;
+        buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+
+    // Jedna pamiętana tekstura na jednostkę - wiązanie innego celu na tej samej jednostce zawsze przechodzi
+    void bindTexture(int unit, GLenum target, GLuint texture) {
+        TextureBinding& binding = textures[unit];
+        if (!request(GlStateKind::Texture, binding.target != target || binding.texture != texture))
+            return;
+        if (activeUnit != unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+        glBindTexture(target, texture);
+        binding.target = target;
+        binding.texture = texture;
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer) {
+        int slot = bufferSlot(target);
+        if (!request(GlStateKind::Buffer, slot < 0 || buffers[slot] != buffer))
+            return;
+        glBindBuffer(target, buffer);
+        if (slot >= 0)
+            buffers[slot] = buffer;
+    }
+
+    void bindFramebuffer(GLuint framebuffer) {
+        if (!request(GlStateKind::Framebuffer, framebuffer != currentFramebuffer))
+            return;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        currentFramebuffer = framebuffer;
+    }
+
+    void enable(GLenum capability) {
+        setCapability(capability, true);
+    }
+
+    void disable(GLenum capability) {
+        setCapability(capability, false);
+    }
+
+    void depthMask(bool write) {
+        GLuint value = write ? 1 : 0;
+        if (!request(GlStateKind::Fixed, depthWrite != value))
+            return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        depthWrite = value;
+    }
+
+    void depthFunc(GLenum function) {
+        if (!request(GlStateKind::Fixed, depthFunction != function))
+            return;
+        glDepthFunc(function);
+        depthFunction = function;
+    }
+
+    void blendFunc(GLenum source, GLenum destination) {
+        if (!request(GlStateKind::Fixed, blendSource != source || blendDestination != destination))
+            return;
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+    }
+
+    void cullFace(GLenum face) {
+        if (!request(GlStateKind::Fixed, culledFace != face))
+            return;
+        glCullFace(face);
+        culledFace = face;
+    }
+
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        GLint value[4] = { x, y, width, height };
+        if (!request(GlStateKind::Fixed, std::memcmp(value, currentViewport, sizeof(value)) != 0))
+            return;
+        glViewport(x, y, width, height);
+        std::memcpy(currentViewport, value, sizeof(value));
+    }
+
+    // Uniformy trafiają do bieżącego programu, tak jak glUniform*; lokalizacja -1 jest pomijana jak w GL
+    void uniform1i(GLint location, GLint value) {
+        if (changeUniform(location, &value, sizeof(value)))
+            glUniform1i(location, value);
+    }
+
+    void uniform1f(GLint location, GLfloat value) {
+        if (changeUniform(location, &value, sizeof(value)))
+            glUniform1f(location, value);
+    }
+
+    void uniform2f(GLint location, GLfloat x, GLfloat y) {
+        GLfloat value[2] = { x, y };
+        if (changeUniform(location, value, sizeof(value)))
+            glUniform2f(location, x, y);
+    }
+
+    void uniform1fv(GLint location, GLsizei count, const GLfloat* value) {
+        if (changeUniform(location, value, count * sizeof(GLfloat)))
+            glUniform1fv(location, count, value);
+    }
+
+    void uniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+        if (changeUniform(location, value, count * 3 * sizeof(GLfloat)))
+            glUniform3fv(location, count, value);
+    }
+
+    void uniformMatrix4fv(GLint location, GLsizei count, const GLfloat* value) {
+        if (changeUniform(location, value, count * 16 * sizeof(GLfloat)))
+            glUniformMatrix4fv(location, count, GL_FALSE, value);
+    }
+
+    // Po wiązaniach zrobionych z pominięciem cache; zapamiętane uniformy programów zostają
+    void invalidateBindings() {
+        currentProgram = UNKNOWN;
+        currentUniforms = nullptr;
+        currentVertexArray = UNKNOWN;
+        currentFramebuffer = UNKNOWN;
+        activeUnit = -1;
+        for (TextureBinding& binding : textures)
+            binding = TextureBinding{ GL_NONE, UNKNOWN };
+        for (GLuint& buffer : buffers)
+            buffer = UNKNOWN;
+        for (GLuint& enabled : capabilities)
+            enabled = UNKNOWN;
+        depthWrite = UNKNOWN;
+        depthFunction = UNKNOWN;
+        blendSource = UNKNOWN;
+        blendDestination = UNKNOWN;
+        culledFace = UNKNOWN;
+        currentViewport[0] = currentViewport[1] = currentViewport[2] = currentViewport[3] = -1;
+    }
+
+    // Także uniformy - po przeładowaniu shaderów, gdy nazwy programów mogą zostać użyte ponownie
+    void invalidate() {
+        invalidateBindings();
+        uniforms.clear();
+    }
+
+    void forgetProgram(GLuint program) {
+        uniforms.erase(program);
+        if (program == currentProgram)
+            invalidateBindings();
+    }
+
+    // Raz na klatkę; statistics() zwraca liczniki zakończonej klatki
+    void endFrame() {
+        last = frame;
+        frame = GlStateStats();
+    }
+
+    const GlStateStats& statistics() const {
+        return last;
+    }
+
+    void report(std::ostream& out) const {
+        static const char* names[] = { "program", "vao", "texture", "buffer", "fbo", "fixed", "uniform" };
+        out << "State: " << last.totalIssued() << " of " << last.totalRequested() << " calls issued (";
+        for (int kind = 0; kind < (int)GlStateKind::Count; ++kind)
+            out << (kind ? ", " : "") << names[kind] << " " << last.issued[kind] << "/" << last.requested[kind];
+        out << "), " << last.uniformBytes << " uniform bytes\n";
+    }
+
+private:
+    static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+    static constexpr int BUFFER_TARGETS = 7;
+    static constexpr int CAPABILITIES = 6;
+
+    struct TextureBinding {
+        GLenum target;
+        GLuint texture;
+    };
+
+    // Wartości uniformów jednego programu według lokalizacji; bajty kopiowane przy każdej zmianie
+    struct UniformValue {
+        std::vector<unsigned char> bytes;
+        bool known = false;
+    };
+
+    bool request(GlStateKind kind, bool changed) {
+        ++frame.requested[(int)kind];
+        if (changed)
+            ++frame.issued[(int)kind];
+        return changed;
+    }
+
+    static int bufferSlot(GLenum target) {
+        switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        case GL_COPY_READ_BUFFER: return 4;
+        case GL_COPY_WRITE_BUFFER: return 5;
+        case GL_PIXEL_UNPACK_BUFFER: return 6;
+        default: return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum capability) {
+        switch (capability) {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_POLYGON_OFFSET_FILL: return 3;
+        case GL_SCISSOR_TEST: return 4;
+        case GL_STENCIL_TEST: return 5;
+        default: return -1;
+        }
+    }
+
+    void setCapability(GLenum capability, bool enabled) {
+        int slot = capabilitySlot(capability);
+        GLuint value = enabled ? 1 : 0;
+        if (!request(GlStateKind::Fixed, slot < 0 || capabilities[slot] != value))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        if (slot >= 0)
+            capabilities[slot] = value;
+    }
+
+    bool changeUniform(GLint location, const void* data, size_t bytes) {
+        if (location < 0)
+            return false;
+        if (!currentUniforms) {
+            // Program ustawiony poza cache - wartość nieznana, więc zawsze wysyłamy
+            request(GlStateKind::Uniform, true);
+            frame.uniformBytes += bytes;
+            return true;
+        }
+        if ((size_t)location >= currentUniforms->size())
+            currentUniforms->resize(location + 1);
+        UniformValue& value = (*currentUniforms)[location];
+        bool changed = !value.known || value.bytes.size() != bytes || std::memcmp(value.bytes.data(), data, bytes) != 0;
+        if (!request(GlStateKind::Uniform, changed))
+            return false;
+        value.bytes.assign((const unsigned char*)data, (const unsigned char*)data + bytes);
+        value.known = true;
+        frame.uniformBytes += bytes;
+        return true;
+    }
+
+    GLuint currentProgram;
+    std::vector<UniformValue>* currentUniforms;
+    GLuint currentVertexArray;
+    GLuint currentFramebuffer;
+    int activeUnit;
+    TextureBinding textures[TEXTURE_UNITS];
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint capabilities[CAPABILITIES];
+    GLuint depthWrite;
+    GLenum depthFunction;
+    GLenum blendSource;
+    GLenum blendDestination;
+    GLenum culledFace;
+    GLint currentViewport[4];
+    std::unordered_map<GLuint, std::vector<UniformValue>> uniforms;
+    GlStateStats frame;
+    GlStateStats last;
+};
+
+// Klucz stanu od najdroższej zmiany: program, tekstura, VAO, na końcu 16 bitów wywołującego (np. materiał).
+// Nazwy GL są małymi liczbami, więc 16 bitów na każdą wystarcza do grupowania.
+inline uint64_t makeStateKey(GLuint program, GLuint texture, GLuint vertexArray, uint16_t extra = 0) {
+    return (uint64_t)(program & 0xFFFF) << 48 | (uint64_t)(texture & 0xFFFF) << 32 |
+        (uint64_t)(vertexArray & 0xFFFF) << 16 | extra;
+}
+
+// Jedno rysowanie z pełnym stanem; indexType == 0 oznacza glDrawArrays
+struct DrawCommand {
+    uint64_t stateKey = 0;
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLenum textureTarget = GL_TEXTURE_2D;
+    GLuint texture = 0;
+    GLint modelLocation = -1;
+    float model[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    // Przezroczystość dla warstwy przezroczystej RenderQueue; -1 gdy shader jej nie ma
+    GLint alphaLocation = -1;
+    float alpha = 1.0f;
+    GLenum mode = GL_TRIANGLES;
+    GLint first = 0;
+    GLsizei count = 0;
+    GLenum indexType = 0;
+};
+
+inline void submitDraw(GlStateCache& state, const DrawCommand& draw) {
+    state.useProgram(draw.program);
+    state.bindVertexArray(draw.vertexArray);
+    if (draw.texture != 0)
+        state.bindTexture(0, draw.textureTarget, draw.texture);
+    state.uniformMatrix4fv(draw.modelLocation, 1, draw.model);
+    state.uniform1f(draw.alphaLocation, draw.alpha);
+    if (draw.indexType != 0) {
+        size_t indexBytes = draw.indexType == GL_UNSIGNED_INT ? 4 : draw.indexType == GL_UNSIGNED_SHORT ? 2 : 1;
+        glDrawElements(draw.mode, draw.count, draw.indexType, (const void*)(draw.first * indexBytes));
+    }
+    else {
+        glDrawArrays(draw.mode, draw.first, draw.count);
+    }
+}
+
+// Lista rysowań klatki: add() w dowolnej kolejności, submit() po kluczu stanu. Pamięć zostaje między klatkami.
+class DrawList {
+public:
+    void clear() {
+        commands.clear();
+        order.clear();
+    }
+
+    void add(const DrawCommand& command) {
+        order.push_back(SortEntry{ command.stateKey, (uint32_t)commands.size() });
+        commands.push_back(command);
+    }
+
+    size_t size() const {
+        return commands.size();
+    }
+
+    void submit(GlStateCache& state) {
+        std::sort(order.begin(), order.end(), [](const SortEntry& a, const SortEntry& b) {
+            return a.key != b.key ? a.key < b.key : a.index < b.index;
+        });
+        for (const SortEntry& entry : order)
+            submitDraw(state, commands[entry.index]);
+    }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawCommand> commands;
+    std::vector<SortEntry> order;
+};
@@ -0,0 +1,268 @@
+﻿#pragma once
+// Rejestr obiektów GL (bufory, VAO, tekstury, programy, framebuffery) za typowanymi uchwytami z HandlePool.
+// Nieaktualny uchwyt daje nazwę 0 zamiast obiektu, który dostał po nim tę samą nazwę. release() nie usuwa
+// obiektu od razu: nazwa czeka na fence klatki, w której ją zwolniono, więc usunięcie nie trafia w środek
+// rysowania, które jeszcze jej używa. Przy zamknięciu obiekty, których nikt nie zwolnił, wypisywane są jako
+// wycieki i usuwane. Używać tylko z wątku, który ma kontekst GL.
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include "handle_pool.h"
+
+enum class GpuResourceType {
+    Buffer,
+    VertexArray,
+    Texture,
+    Program,
+    Framebuffer,
+    Count
+};
+
+template<GpuResourceType Type>
+struct GpuResourceTag {
+};
+
+typedef Handle<GpuResourceTag<GpuResourceType::Buffer>> BufferHandle;
+typedef Handle<GpuResourceTag<GpuResourceType::VertexArray>> VertexArrayHandle;
+typedef Handle<GpuResourceTag<GpuResourceType::Texture>> TextureHandle;
+typedef Handle<GpuResourceTag<GpuResourceType::Program>> ProgramHandle;
+typedef Handle<GpuResourceTag<GpuResourceType::Framebuffer>> FramebufferHandle;
+
+struct GpuResource {
+    GLuint name = 0;
+    // Literał podany przy tworzeniu, nie jest kopiowany
+    const char* label = "";
+    size_t bytes = 0;
+};
+
+class GpuResources {
+public:
+    GpuResources() {
+        for (Pool& pool : pools)
+            pool.reserve(64);
+        retired.reserve(64);
+        fences.reserve(8);
+    }
+
+    ~GpuResources() {
+        shutdown(std::cerr);
+    }
+
+    GpuResources(const GpuResources&) = delete;
+    GpuResources& operator=(const GpuResources&) = delete;
+
+    BufferHandle createBuffer(const char* label) {
+        GLuint name;
+        glGenBuffers(1, &name);
+        return add<GpuResourceType::Buffer>(name, label);
+    }
+
+    VertexArrayHandle createVertexArray(const char* label) {
+        GLuint name;
+        glGenVertexArrays(1, &name);
+        return add<GpuResourceType::VertexArray>(name, label);
+    }
+
+    TextureHandle createTexture(const char* label) {
+        GLuint name;
+        glGenTextures(1, &name);
+        return add<GpuResourceType::Texture>(name, label);
+    }
+
+    FramebufferHandle createFramebuffer(const char* label) {
+        GLuint name;
+        glGenFramebuffers(1, &name);
+        return add<GpuResourceType::Framebuffer>(name, label);
+    }
+
+    // Programy powstają zlinkowane (AsyncShaderCompiler, ręczne glLinkProgram) - rejestr przejmuje własność
+    ProgramHandle adoptProgram(GLuint program, const char* label) {
+        return add<GpuResourceType::Program>(program, label);
+    }
+
+    // Nazwa GL albo 0 dla pustego lub nieaktualnego uchwytu
+    template<GpuResourceType Type>
+    GLuint get(Handle<GpuResourceTag<Type>> handle) const {
+        const GpuResource* resource = pools[(int)Type].find(untyped(handle));
+        if (resource)
+            return resource->name;
+        if (handle)
+            ++staleLookups;
+        return 0;
+    }
+
+    template<GpuResourceType Type>
+    bool valid(Handle<GpuResourceTag<Type>> handle) const {
+        return pools[(int)Type].find(untyped(handle)) != nullptr;
+    }
+
+    // Rozmiar w pamięci GPU, tylko do statystyk i raportu wycieków
+    template<GpuResourceType Type>
+    void setBytes(Handle<GpuResourceTag<Type>> handle, size_t bytes) {
+        if (GpuResource* resource = pools[(int)Type].find(untyped(handle)))
+            resource->bytes = bytes;
+    }
+
+    // Uchwyt od razu przestaje działać, a obiekt GL znika po zakończeniu bieżącej klatki na GPU
+    template<GpuResourceType Type>
+    void release(Handle<GpuResourceTag<Type>>& handle) {
+        GpuResource resource;
+        if (pools[(int)Type].erase(untyped(handle), &resource))
+            destroyLater(Type, resource.name);
+        handle = Handle<GpuResourceTag<Type>>();
+    }
+
+    // Odroczone usunięcie nazwy spoza rejestru, np. programu podmienionego przy przeładowaniu shaderów
+    void destroyLater(GpuResourceType type, GLuint name) {
+        if (name != 0)
+            retired.push_back(Retired{ type, name, frame });
+    }
+
+    // Raz na klatkę po wysłaniu rysowania: fence dla nazw zwolnionych w tej klatce i usunięcie tych,
+    // których klatka skończyła się już na GPU. Nie czeka.
+    void endFrame() {
+        if (!retired.empty() && retired.back().frame == frame)
+            fences.push_back(FrameFence{ frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+
+        size_t signaled = 0;
+        uint64_t finishedFrame = 0;
+        while (signaled < fences.size()) {
+            GLenum status = glClientWaitSync(fences[signaled].fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(fences[signaled].fence);
+            finishedFrame = fences[signaled].frame;
+            ++signaled;
+        }
+        if (signaled > 0) {
+            fences.erase(fences.begin(), fences.begin() + signaled);
+            size_t destroyed = 0;
+            while (destroyed < retired.size() && retired[destroyed].frame <= finishedFrame) {
+                destroyName(retired[destroyed].type, retired[destroyed].name);
+                ++destroyed;
+            }
+            retired.erase(retired.begin(), retired.begin() + destroyed);
+        }
+        ++frame;
+    }
+
+    size_t liveCount() const {
+        size_t count = 0;
+        for (const Pool& pool : pools)
+            count += pool.size();
+        return count;
+    }
+
+    size_t liveBytes() const {
+        size_t bytes = 0;
+        for (const Pool& pool : pools)
+            for (size_t i = 0; i < pool.size(); ++i)
+                bytes += pool.at(i).bytes;
+        return bytes;
+    }
+
+    size_t pendingCount() const {
+        return retired.size();
+    }
+
+    void report(std::ostream& out) const {
+        out << "Resources: " << liveCount() << " live (" << (liveBytes() >> 10) << " KB), " << pendingCount()
+            << " awaiting deletion, " << destroyedCount << " deleted, " << staleLookups << " stale lookups\n";
+    }
+
+    // Wypisuje obiekty, których nikt nie zwolnił; zwraca ich liczbę
+    size_t reportLeaks(std::ostream& out) const {
+        size_t leaks = liveCount();
+        if (leaks == 0)
+            return 0;
+        out << "GPU resource leaks: " << leaks << "\n";
+        for (int type = 0; type < (int)GpuResourceType::Count; ++type) {
+            const Pool& pool = pools[type];
+            for (size_t i = 0; i < pool.size(); ++i) {
+                const GpuResource& resource = pool.at(i);
+                out << "  " << typeName((GpuResourceType)type) << " '" << resource.label << "' (name " << resource.name;
+                if (resource.bytes > 0)
+                    out << ", " << (resource.bytes >> 10) << " KB";
+                out << ")\n";
+            }
+        }
+        return leaks;
+    }
+
+    // Przy zamknięciu, póki kontekst istnieje: raport wycieków, potem usunięcie wszystkiego bez czekania na fence
+    void shutdown(std::ostream& out) {
+        if (closed)
+            return;
+        closed = true;
+        reportLeaks(out);
+        for (int type = 0; type < (int)GpuResourceType::Count; ++type) {
+            Pool& pool = pools[type];
+            while (!pool.empty()) {
+                GpuResource resource;
+                pool.erase(pool.handleAt(pool.size() - 1), &resource);
+                destroyName((GpuResourceType)type, resource.name);
+            }
+        }
+        for (const FrameFence& fence : fences)
+            glDeleteSync(fence.fence);
+        fences.clear();
+        for (const Retired& entry : retired)
+            destroyName(entry.type, entry.name);
+        retired.clear();
+    }
+
+private:
+    typedef HandlePool<GpuResource> Pool;
+
+    struct Retired {
+        GpuResourceType type;
+        GLuint name;
+        uint64_t frame;
+    };
+
+    struct FrameFence {
+        uint64_t frame;
+        GLsync fence;
+    };
+
+    template<typename Tag>
+    static Pool::HandleType untyped(Handle<Tag> handle) {
+        return Pool::HandleType{ handle.index, handle.generation };
+    }
+
+    template<GpuResourceType Type>
+    Handle<GpuResourceTag<Type>> add(GLuint name, const char* label) {
+        GpuResource resource;
+        resource.name = name;
+        resource.label = label;
+        Pool::HandleType handle = pools[(int)Type].insert(resource);
+        return Handle<GpuResourceTag<Type>>{ handle.index, handle.generation };
+    }
+
+    void destroyName(GpuResourceType type, GLuint name) {
+        switch (type) {
+        case GpuResourceType::Buffer: glDeleteBuffers(1, &name); break;
+        case GpuResourceType::VertexArray: glDeleteVertexArrays(1, &name); break;
+        case GpuResourceType::Texture: glDeleteTextures(1, &name); break;
+        case GpuResourceType::Program: glDeleteProgram(name); break;
+        case GpuResourceType::Framebuffer: glDeleteFramebuffers(1, &name); break;
+        default: return;
+        }
+        ++destroyedCount;
+    }
+
+    static const char* typeName(GpuResourceType type) {
+        static const char* names[] = { "buffer", "vertex array", "texture", "program", "framebuffer" };
+        return names[(int)type];
+    }
+
+    Pool pools[(int)GpuResourceType::Count];
+    std::vector<Retired> retired;
+    std::vector<FrameFence> fences;
+    uint64_t frame = 0;
+    uint64_t destroyedCount = 0;
+    mutable uint64_t staleLookups = 0;
+    bool closed = false;
+};
@@ -0,0 +1,138 @@
+﻿#pragma once
+// Pula obiektów adresowana uchwytami: indeks slotu + generacja. Obiekty leżą ciasno w jednym wektorze,
+// usunięcie przenosi ostatni obiekt w zwolnione miejsce, a slot dostaje nową generację - stary uchwyt
+// przestaje pasować zamiast wskazywać na obiekt, który zajął jego miejsce. Wstawianie, wyszukiwanie
+// i usuwanie O(1), zwolnione sloty są używane ponownie, więc pula nie fragmentuje się przy wymianie obiektów.
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+// Tag rozróżnia typy uchwytów - uchwytu tekstury nie da się podać tam, gdzie oczekiwany jest bufor
+template<typename Tag>
+struct Handle {
+    uint32_t index = 0;
+    // 0 oznacza pusty uchwyt, żywe sloty mają generację od 1
+    uint32_t generation = 0;
+
+    explicit operator bool() const {
+        return generation != 0;
+    }
+
+    bool operator==(const Handle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+
+    bool operator!=(const Handle& other) const {
+        return !(*this == other);
+    }
+
+    // Jedna liczba do kluczy sortowania i map
+    uint64_t value() const {
+        return (uint64_t)generation << 32 | index;
+    }
+};
+
+template<typename T, typename Tag = T>
+class HandlePool {
+public:
+    typedef Handle<Tag> HandleType;
+
+    void reserve(size_t count) {
+        slots.reserve(count);
+        items.reserve(count);
+        owners.reserve(count);
+        freeSlots.reserve(count);
+    }
+
+    HandleType insert(T value) {
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            index = (uint32_t)slots.size();
+            slots.push_back(Slot{ 1, FREE });
+        }
+        slots[index].dense = (uint32_t)items.size();
+        items.push_back(std::move(value));
+        owners.push_back(index);
+        return HandleType{ index, slots[index].generation };
+    }
+
+    T* find(HandleType handle) {
+        return const_cast<T*>(static_cast<const HandlePool*>(this)->find(handle));
+    }
+
+    const T* find(HandleType handle) const {
+        if (handle.index >= slots.size())
+            return nullptr;
+        const Slot& slot = slots[handle.index];
+        if (slot.generation != handle.generation || slot.dense == FREE)
+            return nullptr;
+        return &items[slot.dense];
+    }
+
+    // Zwraca false dla nieaktualnego uchwytu; usunięty obiekt trafia do removed, jeśli podano
+    bool erase(HandleType handle, T* removed = nullptr) {
+        T* item = find(handle);
+        if (!item)
+            return false;
+        if (removed)
+            *removed = std::move(*item);
+
+        uint32_t dense = slots[handle.index].dense;
+        uint32_t last = (uint32_t)items.size() - 1;
+        if (dense != last) {
+            items[dense] = std::move(items[last]);
+            owners[dense] = owners[last];
+            slots[owners[dense]].dense = dense;
+        }
+        items.pop_back();
+        owners.pop_back();
+
+        Slot& slot = slots[handle.index];
+        slot.dense = FREE;
+        if (++slot.generation == 0)
+            slot.generation = 1;
+        freeSlots.push_back(handle.index);
+        return true;
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    bool empty() const {
+        return items.empty();
+    }
+
+    // Ciągła tablica żywych obiektów do przejścia bez skakania po slotach; kolejność zmienia się przy usuwaniu
+    T& at(size_t dense) {
+        return items[dense];
+    }
+
+    const T& at(size_t dense) const {
+        return items[dense];
+    }
+
+    HandleType handleAt(size_t dense) const {
+        uint32_t index = owners[dense];
+        return HandleType{ index, slots[index].generation };
+    }
+
+private:
+    static constexpr uint32_t FREE = 0xFFFFFFFFu;
+
+    struct Slot {
+        uint32_t generation;
+        uint32_t dense;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<T> items;
+    // Slot właściciela dla każdego obiektu w items - potrzebny przy przenoszeniu ostatniego obiektu
+    std::vector<uint32_t> owners;
+    std::vector<uint32_t> freeSlots;
+};
@@ -0,0 +1,234 @@
+﻿#pragma once
+// Stan wejścia na klatkę: wybrane klawisze, pozycja myszy i krok czasu symulacji. Zamiast pytać SFML
+// bezpośrednio, pętla czyta ten obiekt - dzięki temu wejście można nagrać do pliku (--record plik)
+// i odtworzyć (--replay plik) klatka po klatce z tymi samymi krokami czasu, więc kamera przechodzi
+// dokładnie tę samą ścieżkę niezależnie od szybkości renderowania. --fixed-step s zastępuje zmierzony
+// krok stałym. Ścieżka jest identyczna bit w bit tylko dla programu skompilowanego z tymi samymi
+// ustawieniami arytmetyki zmiennoprzecinkowej (np. bez -ffast-math w jednej z wersji).
+//
+// Format pliku (little-endian): nagłówek "INPT", u32 wersja, u32 liczba klawiszy, i32 kody klawiszy,
+// potem rekordy klatek: f32 krok czasu, u8 flagi, maska klawiszy na (liczba klawiszy + 7) / 8 bajtach
+// i - tylko gdy flagi mają INPUT_MOUSE_POSITION - dwa i32 z pozycją myszy.
+#include <SFML/Window.hpp>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <iostream>
+#include <initializer_list>
+
+enum class InputMode {
+    Live,
+    Record,
+    Replay,
+};
+
+struct InputConfig {
+    InputMode mode = InputMode::Live;
+    std::string path;
+    float fixedStep = 0.0f;
+};
+
+// --record plik, --replay plik, --fixed-step sekundy; pozostałe argumenty są pomijane
+inline InputConfig parseInputArgs(int argc, char** argv) {
+    InputConfig config;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--record") == 0) {
+            config.mode = InputMode::Record;
+            config.path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0) {
+            config.mode = InputMode::Replay;
+            config.path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--fixed-step") == 0) {
+            config.fixedStep = (float)std::atof(argv[++i]);
+        }
+    }
+    return config;
+}
+
+class InputState {
+public:
+    static constexpr int MAX_KEYS = 64;
+    static constexpr uint32_t VERSION = 1;
+
+    // keys - wszystkie klawisze, o które pętla pyta przez isKeyPressed; tylko one trafiają do nagrania
+    InputState(const InputConfig& config, std::initializer_list<sf::Keyboard::Key> keys)
+        : mode(config.mode), fixedStep(config.fixedStep) {
+        for (sf::Keyboard::Key key : keys) {
+            if (keyCount < MAX_KEYS)
+                keyCodes[keyCount++] = (int32_t)key;
+        }
+        keyBytes = (keyCount + 7) / 8;
+
+        if (mode == InputMode::Record)
+            openRecording(config.path);
+        else if (mode == InputMode::Replay)
+            openReplay(config.path);
+    }
+
+    ~InputState() {
+        if (file) {
+            std::fclose(file);
+            if (mode == InputMode::Record)
+                std::cout << "Input: recorded " << frames << " frames to " << path << std::endl;
+        }
+    }
+
+    InputState(const InputState&) = delete;
+    InputState& operator=(const InputState&) = delete;
+
+    // Wywoływane dla każdego zdarzenia z pollEvent - w trybie replay ruch myszy pochodzi z nagrania
+    void handleEvent(const sf::Event& event) {
+        if (event.type == sf::Event::MouseMoved && mode != InputMode::Replay)
+            pendingMouseMoved = true;
+    }
+
+    // Początek klatki po obsłudze zdarzeń. realDelta to zmierzony czas klatki. Zwraca false,
+    // gdy nagranie się skończyło (albo jest uszkodzone) - pętla powinna wtedy zakończyć program.
+    bool update(const sf::Window& window, float realDelta) {
+        if (mode == InputMode::Replay) {
+            if (!readFrame()) {
+                std::cout << "Input: replay finished after " << frames << " frames" << std::endl;
+                return false;
+            }
+        }
+        else {
+            step = fixedStep > 0.0f ? fixedStep : realDelta;
+            keyMask = 0;
+            for (int i = 0; i < keyCount; ++i) {
+                if (sf::Keyboard::isKeyPressed((sf::Keyboard::Key)keyCodes[i]))
+                    keyMask |= (uint64_t)1 << i;
+            }
+            sf::Vector2i position = sf::Mouse::getPosition(window);
+            flags = pendingMouseMoved ? INPUT_MOUSE_MOVED : 0;
+            if (frames == 0 || position.x != mouse.x || position.y != mouse.y)
+                flags |= INPUT_MOUSE_POSITION;
+            mouse = position;
+            pendingMouseMoved = false;
+            if (mode == InputMode::Record)
+                writeFrame();
+        }
+        time += step;
+        ++frames;
+        return true;
+    }
+
+    // Krok czasu symulacji: nagrany (replay), stały (--fixed-step) albo zmierzony
+    float deltaTime() const {
+        return step;
+    }
+
+    // Suma kroków od startu - czas animacji zamiast zegara ściennego
+    double elapsed() const {
+        return time;
+    }
+
+    bool isKeyPressed(sf::Keyboard::Key key) const {
+        for (int i = 0; i < keyCount; ++i) {
+            if (keyCodes[i] == (int32_t)key)
+                return (keyMask >> i) & 1;
+        }
+        return false;
+    }
+
+    sf::Vector2i mousePosition() const {
+        return mouse;
+    }
+
+    // Czy w tej klatce przyszło zdarzenie MouseMoved (grafika_3/4 obracają kamerę tylko wtedy)
+    bool mouseMoved() const {
+        return (flags & INPUT_MOUSE_MOVED) != 0;
+    }
+
+    bool replaying() const {
+        return mode == InputMode::Replay;
+    }
+
+private:
+    enum : uint8_t {
+        INPUT_MOUSE_MOVED = 1 << 0,
+        INPUT_MOUSE_POSITION = 1 << 1,
+    };
+
+    void openRecording(const std::string& recordPath) {
+        path = recordPath;
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Input: cannot write " << path << ", recording disabled" << std::endl;
+            mode = InputMode::Live;
+            return;
+        }
+        uint32_t header[3] = { 0, VERSION, (uint32_t)keyCount };
+        std::memcpy(&header[0], "INPT", 4);
+        std::fwrite(header, sizeof(header), 1, file);
+        std::fwrite(keyCodes, sizeof(int32_t), keyCount, file);
+    }
+
+    // Nagranie z innym zestawem klawiszy dałoby inną ścieżkę, więc jest odrzucane
+    void openReplay(const std::string& replayPath) {
+        path = replayPath;
+        file = std::fopen(path.c_str(), "rb");
+        uint32_t header[3] = {};
+        int32_t recordedKeys[MAX_KEYS] = {};
+        bool valid = file && std::fread(header, sizeof(header), 1, file) == 1 &&
+            std::memcmp(&header[0], "INPT", 4) == 0 && header[1] == VERSION && header[2] == (uint32_t)keyCount &&
+            std::fread(recordedKeys, sizeof(int32_t), keyCount, file) == (size_t)keyCount &&
+            std::memcmp(recordedKeys, keyCodes, keyCount * sizeof(int32_t)) == 0;
+        if (!valid) {
+            std::cerr << "Input: " << path << " is not a recording for this program" << std::endl;
+            if (file)
+                std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    void writeFrame() {
+        unsigned char mask[MAX_KEYS / 8];
+        for (int i = 0; i < keyBytes; ++i)
+            mask[i] = (unsigned char)(keyMask >> (8 * i));
+        std::fwrite(&step, sizeof(step), 1, file);
+        std::fwrite(&flags, sizeof(flags), 1, file);
+        std::fwrite(mask, 1, keyBytes, file);
+        if (flags & INPUT_MOUSE_POSITION) {
+            int32_t position[2] = { mouse.x, mouse.y };
+            std::fwrite(position, sizeof(position), 1, file);
+        }
+    }
+
+    bool readFrame() {
+        unsigned char mask[MAX_KEYS / 8];
+        if (!file || std::fread(&step, sizeof(step), 1, file) != 1 || std::fread(&flags, sizeof(flags), 1, file) != 1 ||
+            std::fread(mask, 1, keyBytes, file) != (size_t)keyBytes)
+            return false;
+        keyMask = 0;
+        for (int i = 0; i < keyBytes; ++i)
+            keyMask |= (uint64_t)mask[i] << (8 * i);
+        if (flags & INPUT_MOUSE_POSITION) {
+            int32_t position[2];
+            if (std::fread(position, sizeof(position), 1, file) != 1)
+                return false;
+            mouse = sf::Vector2i(position[0], position[1]);
+        }
+        return true;
+    }
+
+    InputMode mode;
+    float fixedStep;
+    std::string path;
+    FILE* file = nullptr;
+
+    int32_t keyCodes[MAX_KEYS] = {};
+    int keyCount = 0;
+    int keyBytes = 0;
+
+    uint64_t keyMask = 0;
+    uint8_t flags = 0;
+    sf::Vector2i mouse;
+    float step = 0.0f;
+    double time = 0.0;
+    unsigned long long frames = 0;
+    bool pendingMouseMoved = false;
+};
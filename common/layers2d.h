@@ -0,0 +1,253 @@
+﻿#pragma once
+// Warstwy 2D z częściowym odświeżaniem. Kolejne warstwy statyczne rysowane są raz do wspólnej bitmapy
+// (cache) i odtwarzane dopiero po invalidate(); warstwy dynamiczne rysowane są na nowo, ale tylko w obszarach
+// oznaczonych jako zmienione. Gotowy obraz przechowywany jest w bitmapie composite - po al_flip_display
+// zawartość bufora tylnego jest nieokreślona, więc co klatkę na ekran trafia cała composite jednym
+// al_draw_bitmap, a składane od nowa są tylko brudne prostokąty (obcinanie al_set_clipping_rectangle).
+// Warstwa dynamiczna nie może rysować poza prostokątem podanym w markChanged - zostałyby ślady.
+#include <allegro5/allegro.h>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include "batch2d.h"
+
+enum class LayerKind {
+    Static,
+    Dynamic,
+};
+
+class LayerStack {
+public:
+    typedef std::function<void(Batch2D&)> DrawFunction;
+
+    // Więcej brudnych prostokątów niż MAX_RECTS jest łączonych w jeden obejmujący
+    static constexpr size_t MAX_RECTS = 8;
+
+    LayerStack(int width, int height, ALLEGRO_COLOR background)
+        : width(width), height(height), background(background) {
+    }
+
+    ~LayerStack() {
+        destroyCaches();
+        if (composite)
+            al_destroy_bitmap(composite);
+    }
+
+    LayerStack(const LayerStack&) = delete;
+    LayerStack& operator=(const LayerStack&) = delete;
+
+    // Warstwy rysowane są w kolejności dodania; zwraca numer warstwy
+    int addLayer(LayerKind kind, DrawFunction draw) {
+        Layer layer;
+        layer.kind = kind;
+        layer.draw = draw;
+        layers.push_back(layer);
+        segmentsValid = false;
+        return (int)layers.size() - 1;
+    }
+
+    void setKind(int layer, LayerKind kind) {
+        if (layers[layer].kind == kind)
+            return;
+        layers[layer].kind = kind;
+        segmentsValid = false;
+    }
+
+    // Zawartość warstwy statycznej się zmieniła - cache jej segmentu zostanie narysowany od nowa
+    void invalidate(int layer) {
+        if (!segmentsValid)
+            return;
+        for (Segment& segment : segments) {
+            if (layer >= segment.first && layer < segment.last)
+                segment.dirty = true;
+        }
+    }
+
+    // Warstwa dynamiczna zmieniła się w tej klatce i teraz zajmuje podany prostokąt; odświeżany jest
+    // ten prostokąt i poprzedni obszar warstwy (żeby zniknęło to, co było tam wcześniej)
+    void markChanged(int layer, float x1, float y1, float x2, float y2) {
+        Layer& target = layers[layer];
+        Rect current = toRect(x1, y1, x2, y2);
+        if (target.hasBounds)
+            addDirty(target.bounds);
+        addDirty(current);
+        target.bounds = current;
+        target.hasBounds = true;
+    }
+
+    // Bez prostokąta - warstwa mogła zmienić się w dowolnym miejscu
+    void markChanged(int layer) {
+        layers[layer].hasBounds = false;
+        markDirty();
+    }
+
+    void markDirty(float x1, float y1, float x2, float y2) {
+        addDirty(toRect(x1, y1, x2, y2));
+    }
+
+    void markDirty() {
+        addDirty(Rect{ 0, 0, width, height });
+    }
+
+    // Odświeża brudne obszary i rysuje całość na bieżący cel (zwykle bufor tylny)
+    void render(Batch2D& batch) {
+        ALLEGRO_BITMAP* target = al_get_target_bitmap();
+        if (!composite) {
+            composite = al_create_bitmap(width, height);
+            markDirty();
+        }
+        if (!segmentsValid)
+            buildSegments();
+
+        for (Segment& segment : segments) {
+            if (segment.isStatic && segment.dirty) {
+                redrawCache(segment, batch);
+                markDirty();
+            }
+        }
+
+        redrawnPixels = 0;
+        al_set_target_bitmap(composite);
+        for (const Rect& rect : dirty) {
+            al_set_clipping_rectangle(rect.x1, rect.y1, rect.x2 - rect.x1, rect.y2 - rect.y1);
+            al_clear_to_color(background);
+            for (const Segment& segment : segments) {
+                if (segment.isStatic) {
+                    al_draw_bitmap_region(segment.cache, (float)rect.x1, (float)rect.y1, (float)(rect.x2 - rect.x1),
+                        (float)(rect.y2 - rect.y1), (float)rect.x1, (float)rect.y1, 0);
+                    continue;
+                }
+                for (int i = segment.first; i < segment.last; ++i)
+                    layers[i].draw(batch);
+                batch.flush();
+            }
+            redrawnPixels += (long long)(rect.x2 - rect.x1) * (rect.y2 - rect.y1);
+        }
+        al_reset_clipping_rectangle();
+        dirty.clear();
+
+        al_set_target_bitmap(target);
+        al_draw_bitmap(composite, 0, 0, 0);
+    }
+
+    // Część ekranu złożona od nowa w ostatnim render() (0 - nic, 1 - cały ekran; nakładające się
+    // prostokąty liczone wielokrotnie)
+    double redrawnFraction() const {
+        return (double)redrawnPixels / ((double)width * height);
+    }
+
+private:
+    struct Rect {
+        int x1, y1;
+        int x2, y2;
+    };
+
+    struct Layer {
+        LayerKind kind = LayerKind::Static;
+        DrawFunction draw;
+        Rect bounds = {};
+        bool hasBounds = false;
+    };
+
+    // Ciąg sąsiednich warstw tego samego rodzaju; statyczne dzielą jedną bitmapę
+    struct Segment {
+        bool isStatic = false;
+        int first = 0;
+        int last = 0;
+        ALLEGRO_BITMAP* cache = nullptr;
+        bool dirty = true;
+    };
+
+    // Piksel zapasu na wygładzanie krawędzi, przycięte do ekranu
+    Rect toRect(float x1, float y1, float x2, float y2) const {
+        Rect rect;
+        rect.x1 = std::max(0, (int)std::floor(std::min(x1, x2)) - 1);
+        rect.y1 = std::max(0, (int)std::floor(std::min(y1, y2)) - 1);
+        rect.x2 = std::min(width, (int)std::ceil(std::max(x1, x2)) + 1);
+        rect.y2 = std::min(height, (int)std::ceil(std::max(y1, y2)) + 1);
+        return rect;
+    }
+
+    static bool overlaps(const Rect& a, const Rect& b) {
+        return a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2;
+    }
+
+    static Rect merge(const Rect& a, const Rect& b) {
+        return Rect{ std::min(a.x1, b.x1), std::min(a.y1, b.y1), std::max(a.x2, b.x2), std::max(a.y2, b.y2) };
+    }
+
+    // Nakładające się lub stykające prostokąty są łączone, żeby żadnego piksela nie składać dwa razy
+    void addDirty(Rect rect) {
+        if (rect.x1 >= rect.x2 || rect.y1 >= rect.y2)
+            return;
+        for (size_t i = 0; i < dirty.size();) {
+            if (overlaps(dirty[i], rect)) {
+                rect = merge(dirty[i], rect);
+                dirty[i] = dirty.back();
+                dirty.pop_back();
+                i = 0;
+            }
+            else {
+                ++i;
+            }
+        }
+        dirty.push_back(rect);
+        if (dirty.size() > MAX_RECTS) {
+            Rect all = dirty[0];
+            for (const Rect& other : dirty)
+                all = merge(all, other);
+            dirty.clear();
+            dirty.push_back(all);
+        }
+    }
+
+    void buildSegments() {
+        destroyCaches();
+        segments.clear();
+        for (int i = 0; i < (int)layers.size(); ++i) {
+            bool isStatic = layers[i].kind == LayerKind::Static;
+            if (segments.empty() || segments.back().isStatic != isStatic) {
+                Segment segment;
+                segment.isStatic = isStatic;
+                segment.first = i;
+                segments.push_back(segment);
+            }
+            segments.back().last = i + 1;
+        }
+        for (Segment& segment : segments) {
+            if (segment.isStatic)
+                segment.cache = al_create_bitmap(width, height);
+        }
+        segmentsValid = true;
+        markDirty();
+    }
+
+    // Przezroczyste tło - cache nakładany jest na warstwy poniżej zwykłym mieszaniem alfa
+    void redrawCache(Segment& segment, Batch2D& batch) {
+        al_set_target_bitmap(segment.cache);
+        al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+        for (int i = segment.first; i < segment.last; ++i)
+            layers[i].draw(batch);
+        batch.flush();
+        segment.dirty = false;
+    }
+
+    void destroyCaches() {
+        for (Segment& segment : segments) {
+            if (segment.cache)
+                al_destroy_bitmap(segment.cache);
+            segment.cache = nullptr;
+        }
+    }
+
+    int width;
+    int height;
+    ALLEGRO_COLOR background;
+    std::vector<Layer> layers;
+    std::vector<Segment> segments;
+    std::vector<Rect> dirty;
+    ALLEGRO_BITMAP* composite = nullptr;
+    bool segmentsValid = false;
+    long long redrawnPixels = 0;
+};
@@ -0,0 +1,342 @@
+﻿#pragma once
+// Normalne wierzchołków i tangensy dla modeli OBJ bez vn. Zamiast rozpraszania (każda ściana dodaje swoją
+// normalną do wierzchołków, co przy wielu wątkach wymaga atomików) obliczenia zbierają dane: najpierw
+// równolegle po ścianach liczone są normalne ścian i wagi rogów, potem równolegle po pozycjach każda pozycja
+// sumuje tylko swoje rogi (tablica pozycja -> rogi w układzie CSR). Każdy zapis ma jednego właściciela.
+//
+// Normalna rogu: suma normalnych ścian ważonych polem i kątem w rogu, z tych ścian przy pozycji, które
+// łączą się z nią przez krawędzie łagodniejsze niż kąt załamania (grupy wygładzania w obrębie pozycji).
+// Tangensy jak w MikkTSpace: kierunek z pochodnych UV trójkąta rzutowany na płaszczyznę normalnej, ważony
+// kątem, łączony tylko dla rogów o tej samej pozycji, normalnej, UV i orientacji mapowania; znak w = -1
+// dla odbitych UV. Wynik nie jest bitowo równy bibliotece mikktspace.c, ale ma tę samą konwencję
+// (bitangent = w * cross(N, T)), więc mapy normalnych wypalone w tej przestrzeni wyglądają poprawnie.
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "obj_model.h"
+#include "thread_pool.h"
+
+// Rogi (wierzchołki ścian) numerowane kolejno po ścianach i pogrupowane według pozycji
+struct ObjCornerTable {
+    std::vector<uint32_t> faceStart;
+    std::vector<uint32_t> cornerFace;
+    std::vector<uint32_t> positionStart;
+    std::vector<uint32_t> positionCorners;
+};
+
+// Sortowanie przez zliczanie - jedno przejście po rogach, w obrębie pozycji rogi rosnąco. Rogi z pozycją
+// spoza listy nie trafiają do żadnej pozycji (generateObjNormals/Tangents usuwają takie ściany wcześniej).
+inline ObjCornerTable buildObjCornerTable(const ObjModel& model) {
+    ObjCornerTable table;
+    table.faceStart.resize(model.faces.size() + 1);
+    uint32_t corners = 0;
+    for (size_t f = 0; f < model.faces.size(); ++f) {
+        table.faceStart[f] = corners;
+        corners += (uint32_t)model.faces[f].vertexIndices.size();
+    }
+    table.faceStart[model.faces.size()] = corners;
+
+    table.cornerFace.resize(corners);
+    table.positionStart.assign(model.vertices.size() + 1, 0);
+    for (size_t f = 0; f < model.faces.size(); ++f) {
+        const Face& face = model.faces[f];
+        for (size_t k = 0; k < face.vertexIndices.size(); ++k) {
+            table.cornerFace[table.faceStart[f] + k] = (uint32_t)f;
+            int position = face.vertexIndices[k];
+            if (position >= 0 && (size_t)position < model.vertices.size())
+                ++table.positionStart[position + 1];
+        }
+    }
+    for (size_t v = 0; v < model.vertices.size(); ++v)
+        table.positionStart[v + 1] += table.positionStart[v];
+
+    table.positionCorners.resize(table.positionStart[model.vertices.size()]);
+    std::vector<uint32_t> fill(table.positionStart.begin(), table.positionStart.end() - 1);
+    for (uint32_t c = 0; c < corners; ++c) {
+        const Face& face = model.faces[table.cornerFace[c]];
+        int position = face.vertexIndices[c - table.faceStart[table.cornerFace[c]]];
+        if (position >= 0 && (size_t)position < model.vertices.size())
+            table.positionCorners[fill[position]++] = c;
+    }
+    return table;
+}
+
+namespace mesh_detail {
+
+inline glm::vec3 position(const ObjModel& model, int index) {
+    const Vertex& vertex = model.vertices[index];
+    return glm::vec3(vertex.x, vertex.y, vertex.z);
+}
+
+// acos z przybliżenia wielomianem (Abramowitz i Stegun 4.4.45, błąd < 7e-5 rad) - kąt służy tylko jako
+// waga, a std::acos dla każdego rogu był największym kosztem przy milionach trójkątów
+inline float fastAcos(float x) {
+    float a = std::fabs(std::min(std::max(x, -1.0f), 1.0f));
+    float result = std::sqrt(1.0f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f - 0.0187293f * a)));
+    return x < 0.0f ? 3.14159265f - result : result;
+}
+
+// Kąt wewnętrzny wielokąta przy wierzchołku k (0 dla krawędzi zerowej długości)
+inline float cornerAngle(const ObjModel& model, const Face& face, size_t k) {
+    size_t n = face.vertexIndices.size();
+    glm::vec3 p = position(model, face.vertexIndices[k]);
+    glm::vec3 toNext = position(model, face.vertexIndices[(k + 1) % n]) - p;
+    glm::vec3 toPrevious = position(model, face.vertexIndices[(k + n - 1) % n]) - p;
+    float lengths = glm::length(toNext) * glm::length(toPrevious);
+    if (lengths <= 0.0f)
+        return 0.0f;
+    return fastAcos(glm::dot(toNext, toPrevious) / lengths);
+}
+
+// Numeruje grupy count rogów jednej pozycji (w kolejności pierwszego wystąpienia); same(i, j) - rogi i, j
+// (numery w obrębie pozycji) łączą się bezpośrednio, grupa to domknięcie przechodnie. Zwraca liczbę grup.
+template <typename Same>
+uint32_t groupCorners(size_t count, std::vector<uint32_t>& parent, uint32_t* groups, Same&& same) {
+    parent.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        parent[i] = (uint32_t)i;
+    auto root = [&](uint32_t i) {
+        while (parent[i] != i)
+            i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = i + 1; j < count; ++j) {
+            if (same(i, j)) {
+                uint32_t a = root((uint32_t)i), b = root((uint32_t)j);
+                if (a != b)
+                    parent[std::max(a, b)] = std::min(a, b);
+            }
+        }
+    }
+    uint32_t groupCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t r = root((uint32_t)i);
+        groups[i] = r == i ? groupCount++ : groups[r];
+    }
+    return groupCount;
+}
+
+}
+
+// Zastępuje normalne modelu wygładzonymi; ściany łączą się przy kącie między nimi nie większym niż
+// creaseAngleDegrees (180 - wszystko gładkie, 0 - płaskie cieniowanie)
+inline void generateObjNormals(ObjModel& model, ThreadPool& pool, float creaseAngleDegrees = 60.0f) {
+    using namespace mesh_detail;
+    const size_t GRAIN = 4096;
+    removeInvalidObjFaces(model);
+    ObjCornerTable table = buildObjCornerTable(model);
+    size_t faceCount = model.faces.size();
+    size_t cornerCount = table.cornerFace.size();
+    size_t positionCount = model.vertices.size();
+
+    // Normalne ścian (wzór Newella, działa też dla wielokątów) i ważony wkład każdego rogu
+    std::vector<glm::vec3> faceNormals(faceCount);
+    std::vector<glm::vec3> cornerWeighted(cornerCount);
+    pool.parallelFor(faceCount, GRAIN, [&](size_t begin, size_t end, unsigned) {
+        for (size_t f = begin; f < end; ++f) {
+            Face& face = model.faces[f];
+            size_t n = face.vertexIndices.size();
+            glm::vec3 normal(0.0f);
+            for (size_t k = 0; k < n; ++k) {
+                glm::vec3 a = position(model, face.vertexIndices[k]);
+                glm::vec3 b = position(model, face.vertexIndices[(k + 1) % n]);
+                normal += glm::vec3((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+            }
+            // Długość normalnej Newella to podwojone pole ściany
+            float length = glm::length(normal);
+            faceNormals[f] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            for (size_t k = 0; k < n; ++k)
+                cornerWeighted[table.faceStart[f] + k] = normal * (0.5f * cornerAngle(model, face, k));
+            face.normalIndices.assign(n, -1);
+        }
+    });
+
+    // Grupy wygładzania każdej pozycji; róg ściany zdegenerowanej dołącza tylko do grupy pierwszego
+    // zwykłego rogu pozycji, więc nie łączy grup rozdzielonych kątem załamania
+    float cosCrease = std::cos(glm::radians(std::min(std::max(creaseAngleDegrees, 0.0f), 180.0f)));
+    std::vector<uint32_t> cornerGroup(cornerCount);
+    std::vector<uint32_t> normalStart(positionCount + 1, 0);
+    pool.parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end, unsigned) {
+        std::vector<uint32_t> parent;
+        std::vector<glm::vec3> normals;
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t first = table.positionStart[v];
+            uint32_t count = table.positionStart[v + 1] - first;
+            // Normalne ścian rogów skopiowane obok siebie - porównania parami nie skaczą po pamięci
+            normals.resize(count);
+            size_t solid = count;
+            for (uint32_t i = 0; i < count; ++i) {
+                normals[i] = faceNormals[table.cornerFace[table.positionCorners[first + i]]];
+                if (solid == count && glm::dot(normals[i], normals[i]) > 0.0f)
+                    solid = i;
+            }
+            uint32_t groups = groupCorners(count, parent, cornerGroup.data() + first, [&](size_t i, size_t j) {
+                bool degenerateI = glm::dot(normals[i], normals[i]) == 0.0f;
+                bool degenerateJ = glm::dot(normals[j], normals[j]) == 0.0f;
+                if (degenerateI || degenerateJ)
+                    return (degenerateI && degenerateJ) || i == solid || j == solid;
+                return glm::dot(normals[i], normals[j]) >= cosCrease;
+            });
+            normalStart[v + 1] = groups;
+        }
+    });
+    for (size_t v = 0; v < positionCount; ++v)
+        normalStart[v + 1] += normalStart[v];
+
+    model.normals.assign(normalStart[positionCount], Normal{ 0.0f, 0.0f, 0.0f });
+    pool.parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end, unsigned) {
+        std::vector<glm::vec3> sums;
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t first = table.positionStart[v];
+            uint32_t count = table.positionStart[v + 1] - first;
+            sums.assign(normalStart[v + 1] - normalStart[v], glm::vec3(0.0f));
+            for (uint32_t i = 0; i < count; ++i)
+                sums[cornerGroup[first + i]] += cornerWeighted[table.positionCorners[first + i]];
+            for (size_t g = 0; g < sums.size(); ++g) {
+                float length = glm::length(sums[g]);
+                glm::vec3 normal = length > 0.0f ? sums[g] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+                model.normals[normalStart[v] + g] = Normal{ normal.x, normal.y, normal.z };
+            }
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t corner = table.positionCorners[first + i];
+                uint32_t face = table.cornerFace[corner];
+                model.faces[face].normalIndices[corner - table.faceStart[face]] = (int)(normalStart[v] + cornerGroup[first + i]);
+            }
+        }
+    });
+}
+
+// Tangensy dla modelu z normalnymi i UV; false, gdy czegoś brakuje
+inline bool generateObjTangents(ObjModel& model, ThreadPool& pool) {
+    using namespace mesh_detail;
+    if (model.normals.empty() || model.texCoords.empty())
+        return false;
+    const size_t GRAIN = 4096;
+    removeInvalidObjFaces(model);
+    ObjCornerTable table = buildObjCornerTable(model);
+    size_t faceCount = model.faces.size();
+    size_t cornerCount = table.cornerFace.size();
+    size_t positionCount = model.vertices.size();
+
+    auto normalAt = [&](const Face& face, size_t k) {
+        int index = face.normalIndices[k];
+        if (index < 0)
+            return glm::vec3(0.0f, 0.0f, 1.0f);
+        const Normal& normal = model.normals[index];
+        return glm::vec3(normal.nx, normal.ny, normal.nz);
+    };
+    auto texCoordAt = [&](const Face& face, size_t k) {
+        int index = face.texCoordIndices[k];
+        if (index < 0)
+            return glm::vec2(0.0f);
+        return glm::vec2(model.texCoords[index].u, model.texCoords[index].v);
+    };
+
+    // Kierunek tangensa ściany (suma trójkątów wachlarza) i orientacja mapowania UV; wkład rogu to ten
+    // kierunek rzutowany na płaszczyznę normalnej rogu, ważony kątem w rogu
+    std::vector<uint8_t> faceOrientation(faceCount);
+    std::vector<glm::vec3> cornerWeighted(cornerCount);
+    pool.parallelFor(faceCount, GRAIN, [&](size_t begin, size_t end, unsigned) {
+        for (size_t f = begin; f < end; ++f) {
+            Face& face = model.faces[f];
+            size_t n = face.vertexIndices.size();
+            glm::vec3 tangent(0.0f);
+            float signedArea = 0.0f;
+            glm::vec3 p0 = position(model, face.vertexIndices[0]);
+            glm::vec2 uv0 = texCoordAt(face, 0);
+            for (size_t k = 1; k + 1 < n; ++k) {
+                glm::vec3 d1 = position(model, face.vertexIndices[k]) - p0;
+                glm::vec3 d2 = position(model, face.vertexIndices[k + 1]) - p0;
+                glm::vec2 t1 = texCoordAt(face, k) - uv0;
+                glm::vec2 t2 = texCoordAt(face, k + 1) - uv0;
+                float area = t1.x * t2.y - t1.y * t2.x;
+                // Jak w MikkTSpace: kierunek z pochodnych bez dzielenia przez pole UV, znak osobno
+                glm::vec3 s = d1 * t2.y - d2 * t1.y;
+                tangent += area < 0.0f ? -s : s;
+                signedArea += area;
+            }
+            faceOrientation[f] = signedArea >= 0.0f ? 1 : 0;
+            face.tangentIndices.assign(n, -1);
+            for (size_t k = 0; k < n; ++k) {
+                glm::vec3 normal = normalAt(face, k);
+                glm::vec3 projected = tangent - normal * glm::dot(normal, tangent);
+                float length = glm::length(projected);
+                cornerWeighted[table.faceStart[f] + k] = length > 0.0f ? projected * (cornerAngle(model, face, k) / length) : glm::vec3(0.0f);
+            }
+        }
+    });
+
+    // Rogi pozycji łączone przy tej samej normalnej, UV i orientacji - spawanie wierzchołków z MikkTSpace
+    std::vector<uint32_t> cornerGroup(cornerCount);
+    std::vector<uint32_t> tangentStart(positionCount + 1, 0);
+    auto faceCorner = [&](uint32_t corner, uint32_t& face) {
+        face = table.cornerFace[corner];
+        return corner - table.faceStart[face];
+    };
+    struct WeldKey {
+        int normal;
+        int texCoord;
+        uint8_t orientation;
+    };
+    pool.parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end, unsigned) {
+        std::vector<uint32_t> parent;
+        std::vector<WeldKey> keys;
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t first = table.positionStart[v];
+            uint32_t count = table.positionStart[v + 1] - first;
+            keys.resize(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t face;
+                uint32_t k = faceCorner(table.positionCorners[first + i], face);
+                keys[i] = WeldKey{ model.faces[face].normalIndices[k], model.faces[face].texCoordIndices[k], faceOrientation[face] };
+            }
+            uint32_t groups = groupCorners(count, parent, cornerGroup.data() + first, [&](size_t i, size_t j) {
+                return keys[i].normal == keys[j].normal && keys[i].texCoord == keys[j].texCoord && keys[i].orientation == keys[j].orientation;
+            });
+            tangentStart[v + 1] = groups;
+        }
+    });
+    for (size_t v = 0; v < positionCount; ++v)
+        tangentStart[v + 1] += tangentStart[v];
+
+    model.tangents.assign(tangentStart[positionCount], Tangent{ 1.0f, 0.0f, 0.0f, 1.0f });
+    pool.parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end, unsigned) {
+        std::vector<glm::vec3> sums;
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t first = table.positionStart[v];
+            uint32_t count = table.positionStart[v + 1] - first;
+            sums.assign(tangentStart[v + 1] - tangentStart[v], glm::vec3(0.0f));
+            for (uint32_t i = 0; i < count; ++i)
+                sums[cornerGroup[first + i]] += cornerWeighted[table.positionCorners[first + i]];
+            uint32_t nextGroup = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t face;
+                uint32_t corner = table.positionCorners[first + i];
+                uint32_t k = faceCorner(corner, face);
+                uint32_t index = tangentStart[v] + cornerGroup[first + i];
+                model.faces[face].tangentIndices[k] = (int)index;
+                // Grupy numerowane w kolejności pierwszego rogu - ten róg zapisuje tangens grupy
+                if (cornerGroup[first + i] != nextGroup)
+                    continue;
+                ++nextGroup;
+                glm::vec3 tangent = sums[cornerGroup[first + i]];
+                float length = glm::length(tangent);
+                if (length > 0.0f) {
+                    tangent /= length;
+                }
+                else {
+                    // Zdegenerowane UV - dowolny kierunek prostopadły do normalnej
+                    glm::vec3 normal = normalAt(model.faces[face], k);
+                    glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    tangent = glm::normalize(glm::cross(normal, axis));
+                }
+                model.tangents[index] = Tangent{ tangent.x, tangent.y, tangent.z, faceOrientation[face] ? 1.0f : -1.0f };
+            }
+        }
+    });
+    return true;
+}
@@ -0,0 +1,179 @@
+﻿#pragma once
+// Wczytywanie modeli OBJ (v, vt, vn, f z indeksami v, v/vt, v//vn lub v/vt/vn) wspólne dla grafika_7
+// i benchmarku. Brakujące normalne i tangensy uzupełnia common/mesh_normals.h.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+
+struct Vertex { float x, y, z; };
+
+struct TextureCoord { float u, v; };
+
+struct Normal { float nx, ny, nz; };
+
+// Tangens z kierunkiem bitangensa w w (bitangent = w * cross(normal, tangent), jak w MikkTSpace)
+struct Tangent { float tx, ty, tz, w; };
+
+// Indeks -1 - atrybutu brak w tym wierzchołku ściany
+struct Face {
+    std::vector<int> vertexIndices;
+    std::vector<int> texCoordIndices;
+    std::vector<int> normalIndices;
+    std::vector<int> tangentIndices;
+};
+
+struct ObjModel {
+    std::vector<Vertex> vertices;
+    std::vector<TextureCoord> texCoords;
+    std::vector<Normal> normals;
+    std::vector<Tangent> tangents;
+    std::vector<Face> faces;
+};
+
+// Indeks OBJ liczony od 1, ujemny względem końca listy; pusty tekst - brak (-1)
+inline int parseObjIndex(const std::string& text, size_t count) {
+    if (text.empty())
+        return -1;
+    int index = std::stoi(text);
+    return index < 0 ? (int)count + index : index - 1;
+}
+
+// Usuwa ściany z mniej niż 3 rogami lub z pozycją spoza listy; indeksy UV i normalnych spoza list
+// zamienia na -1. Indeksy dodatnie mogą wskazywać dalsze wiersze pliku, więc sprawdzane są po wczytaniu.
+// Zwraca liczbę usuniętych ścian.
+inline size_t removeInvalidObjFaces(ObjModel& model) {
+    auto inRange = [](int index, size_t count) {
+        return index >= 0 && (size_t)index < count;
+    };
+    size_t kept = 0;
+    for (Face& face : model.faces) {
+        bool valid = face.vertexIndices.size() >= 3;
+        for (int index : face.vertexIndices)
+            valid = valid && inRange(index, model.vertices.size());
+        if (!valid)
+            continue;
+        face.texCoordIndices.resize(face.vertexIndices.size(), -1);
+        face.normalIndices.resize(face.vertexIndices.size(), -1);
+        for (int& index : face.texCoordIndices) {
+            if (!inRange(index, model.texCoords.size()))
+                index = -1;
+        }
+        for (int& index : face.normalIndices) {
+            if (!inRange(index, model.normals.size()))
+                index = -1;
+        }
+        if (&face != &model.faces[kept])
+            model.faces[kept] = std::move(face);
+        ++kept;
+    }
+    size_t removed = model.faces.size() - kept;
+    model.faces.resize(kept);
+    return removed;
+}
+
+inline ObjModel loadObjModel(const std::string& filePath) {
+    ObjModel model;
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        std::cerr << "Nie można otworzyć pliku: " << filePath << std::endl;
+        return model;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream lineStream(line);
+        std::string type;
+        lineStream >> type;
+
+        if (type == "v") {
+            Vertex vertex;
+            lineStream >> vertex.x >> vertex.y >> vertex.z;
+            model.vertices.push_back(vertex);
+        }
+        else if (type == "vt") { 
+            TextureCoord texCoord;
+            lineStream >> texCoord.u >> texCoord.v;
+            model.texCoords.push_back(texCoord);
+        }
+        else if (type == "vn") {
+            Normal normal;
+            lineStream >> normal.nx >> normal.ny >> normal.nz;
+            model.normals.push_back(normal);
+        }
+        else if (type == "f") {
+            Face face;
+            std::string vertexData;
+            while (lineStream >> vertexData) {
+                std::istringstream vertexStream(vertexData);
+                std::string vertexIndex, texCoordIndex, normalIndex;
+                if (std::getline(vertexStream, vertexIndex, '/') && !vertexIndex.empty()) {
+                    std::getline(vertexStream, texCoordIndex, '/');
+                    std::getline(vertexStream, normalIndex);
+                    face.vertexIndices.push_back(parseObjIndex(vertexIndex, model.vertices.size()));
+                    face.texCoordIndices.push_back(parseObjIndex(texCoordIndex, model.texCoords.size()));
+                    face.normalIndices.push_back(parseObjIndex(normalIndex, model.normals.size()));
+                }
+            }
+            model.faces.push_back(face);
+        }
+    }
+
+    file.close();
+    if (size_t removed = removeInvalidObjFaces(model))
+        std::cerr << "Pominięto " << removed << " ścian z błędnymi indeksami w: " << filePath << std::endl;
+    return model;
+}
+
+// Liczba floatów na wierzchołek w strumieniu z buildObjVertexStream: pozycja, opcjonalnie normalna, UV
+// i tangens (4 floaty)
+inline size_t objVertexStride(const ObjModel& model) {
+    return 3 + (model.normals.empty() ? 0 : 3) + (model.texCoords.empty() ? 0 : 2) + (model.tangents.empty() ? 0 : 4);
+}
+
+// Przeplatany strumień do glDrawArrays(GL_TRIANGLES): wielokąty rozbite na wachlarze trójkątów (0, k, k+1),
+// tak samo jak w obj_stream.h; brakujący atrybut wierzchołka ściany zapisywany jako zera, żeby układ
+// strumienia się nie przesuwał
+inline std::vector<float> buildObjVertexStream(const ObjModel& model) {
+    std::vector<float> vertices;
+    const Normal noNormal = { 0.0f, 0.0f, 0.0f };
+    const TextureCoord noTexCoord = { 0.0f, 0.0f };
+    const Tangent noTangent = { 0.0f, 0.0f, 0.0f, 1.0f };
+    for (const auto& face : model.faces) {
+        size_t n = face.vertexIndices.size();
+        for (size_t corner = 0; n >= 3 && corner < 3 * (n - 2); ++corner) {
+            size_t i = corner % 3 == 0 ? 0 : corner / 3 + corner % 3;
+            const Vertex& vertex = model.vertices[face.vertexIndices[i]];
+            vertices.push_back(vertex.x);
+            vertices.push_back(vertex.y);
+            vertices.push_back(vertex.z);
+
+            if (!model.normals.empty()) {
+                int index = i < face.normalIndices.size() ? face.normalIndices[i] : -1;
+                const Normal& normal = index >= 0 ? model.normals[index] : noNormal;
+                vertices.push_back(normal.nx);
+                vertices.push_back(normal.ny);
+                vertices.push_back(normal.nz);
+            }
+
+            if (!model.texCoords.empty()) {
+                int index = i < face.texCoordIndices.size() ? face.texCoordIndices[i] : -1;
+                const TextureCoord& texCoord = index >= 0 ? model.texCoords[index] : noTexCoord;
+                vertices.push_back(texCoord.u);
+                vertices.push_back(texCoord.v);
+            }
+
+            if (!model.tangents.empty()) {
+                int index = i < face.tangentIndices.size() ? face.tangentIndices[i] : -1;
+                const Tangent& tangent = index >= 0 ? model.tangents[index] : noTangent;
+                vertices.push_back(tangent.tx);
+                vertices.push_back(tangent.ty);
+                vertices.push_back(tangent.tz);
+                vertices.push_back(tangent.w);
+            }
+        }
+    }
+    return vertices;
+}
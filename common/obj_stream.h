@@ -0,0 +1,656 @@
+﻿#pragma once
+// Strumieniowa konwersja plików OBJ większych niż pamięć do pliku kawałków (ObjChunkFile). Pamięć jest
+// ograniczona przez ObjStreamOptions::memoryCap niezależnie od rozmiaru pliku:
+//  1. plik czytany oknami stałej wielkości; v, vt, vn i trójkąty ścian (wachlarz) idą do plików
+//     tymczasowych obok wyniku, przy okazji liczone są granice sceny,
+//  2. trójkąty przypisywane są do komórek siatki według środka; atrybuty czytane z plików tymczasowych przez
+//     pamięć podręczną stron (mapowanie bezpośrednie - skany mają silną lokalność indeksów), bufory komórek
+//     po zapełnieniu zrzucane są jako serie do jeszcze jednego pliku tymczasowego,
+//  3. serie każdej komórki składane są w kawałki po najwyżej chunkTriangles trójkątów i zapisywane kolejno;
+//     katalog kawałków (komórka, granice, przesunięcie) trafia na koniec pliku.
+// Wierzchołek kawałka ma zawsze 8 floatów jak w grafika_7: pozycja, normalna, UV. Plik bez vn dostaje
+// normalne wygładzone w obrębie kawałka (common/mesh_normals.h) - na granicach kawałków widać szwy.
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <glm/glm.hpp>
+#include "obj_model.h"
+#include "mesh_normals.h"
+#include "thread_pool.h"
+
+struct ObjStreamOptions {
+    // Bufory konwersji razem: okno pliku, pamięć podręczna atrybutów, bufory komórek, składany kawałek
+    size_t memoryCap = (size_t)256 << 20;
+    // Docelowa liczba trójkątów w kawałku; przepełnione komórki dzielone są na kilka kawałków
+    uint32_t chunkTriangles = 65536;
+    float creaseAngle = 60.0f;
+};
+
+struct ObjStreamStats {
+    uint64_t fileBytes = 0;
+    uint64_t positions = 0;
+    uint64_t texCoords = 0;
+    uint64_t normals = 0;
+    uint64_t triangles = 0;
+    uint64_t chunks = 0;
+    uint32_t grid[3] = {};
+    // Największa suma buforów konwersji (bez stosu i buforów stdio)
+    size_t peakBytes = 0;
+    uint64_t cacheReads = 0;
+    uint64_t cacheMisses = 0;
+    double seconds = 0.0;
+};
+
+struct ObjChunkHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint32_t floatsPerVertex;
+    float boundsMin[3];
+    float boundsMax[3];
+    float cellSize;
+    uint32_t grid[3];
+    uint64_t directoryOffset;
+};
+
+struct ObjChunkInfo {
+    uint32_t cell[3];
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t vertexCount;
+    uint64_t offset;
+};
+
+static_assert(sizeof(ObjChunkHeader) == 64, "ObjChunkHeader layout is part of the file format");
+static_assert(sizeof(ObjChunkInfo) == 48, "ObjChunkInfo layout is part of the file format");
+
+namespace obj_stream_detail {
+
+const uint32_t VERSION = 1;
+const uint32_t FLOATS_PER_VERTEX = 8;
+const int64_t MISSING = -1;
+
+inline bool seek(FILE* file, uint64_t offset) {
+#if defined(_MSC_VER)
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+inline uint64_t tell(FILE* file) {
+#if defined(_MSC_VER)
+    return (uint64_t)_ftelli64(file);
+#else
+    return (uint64_t)ftello(file);
+#endif
+}
+
+// Kolejne linie pliku z okna stałej wielkości; linia dłuższa niż okno jest ucinana
+class LineReader {
+public:
+    LineReader(FILE* file, size_t windowBytes)
+        : file(file), buffer(windowBytes + 1) {
+    }
+
+    bool next(const char*& begin, const char*& end) {
+        for (;;) {
+            char* newline = (char*)std::memchr(buffer.data() + position, '\n', filled - position);
+            if (newline) {
+                begin = buffer.data() + position;
+                end = newline;
+                position = newline - buffer.data() + 1;
+                return true;
+            }
+            if (eof) {
+                if (position == filled)
+                    return false;
+                begin = buffer.data() + position;
+                end = buffer.data() + filled;
+                position = filled;
+                return true;
+            }
+            size_t rest = filled - position;
+            if (rest == buffer.size() - 1) {
+                begin = buffer.data();
+                end = buffer.data() + rest;
+                position = filled;
+                return true;
+            }
+            std::memmove(buffer.data(), buffer.data() + position, rest);
+            size_t read = std::fread(buffer.data() + rest, 1, buffer.size() - 1 - rest, file);
+            filled = rest + read;
+            position = 0;
+            // Wartownik dla strtof/strtoll na końcu ostatniej linii
+            buffer[filled] = '\0';
+            eof = read == 0;
+        }
+    }
+
+    size_t bytes() const {
+        return buffer.size();
+    }
+
+private:
+    FILE* file;
+    std::vector<char> buffer;
+    size_t filled = 0;
+    size_t position = 0;
+    bool eof = false;
+};
+
+// Tablica rekordów w pliku tymczasowym czytana stronami przez pamięć podręczną mapowaną bezpośrednio
+class SpillCache {
+public:
+    static constexpr size_t PAGE_RECORDS = 4096;
+
+    SpillCache(FILE* file, size_t recordFloats, size_t capacityBytes)
+        : file(file), recordFloats(recordFloats) {
+        size_t pageBytes = PAGE_RECORDS * recordFloats * sizeof(float);
+        slots = std::max<size_t>(1, capacityBytes / pageBytes);
+        data.resize(slots * PAGE_RECORDS * recordFloats);
+        tags.assign(slots, UINT64_MAX);
+    }
+
+    const float* get(uint64_t index) {
+        uint64_t page = index / PAGE_RECORDS;
+        size_t slot = (size_t)(page % slots);
+        float* pageData = data.data() + slot * PAGE_RECORDS * recordFloats;
+        ++reads;
+        if (tags[slot] != page) {
+            ++misses;
+            size_t pageBytes = PAGE_RECORDS * recordFloats * sizeof(float);
+            seek(file, page * pageBytes);
+            size_t read = std::fread(pageData, 1, pageBytes, file);
+            std::memset((char*)pageData + read, 0, pageBytes - read);
+            tags[slot] = page;
+        }
+        return pageData + (index % PAGE_RECORDS) * recordFloats;
+    }
+
+    size_t bytes() const {
+        return data.size() * sizeof(float);
+    }
+
+    uint64_t reads = 0;
+    uint64_t misses = 0;
+
+private:
+    FILE* file;
+    size_t recordFloats;
+    size_t slots;
+    std::vector<float> data;
+    std::vector<uint64_t> tags;
+};
+
+inline const char* skipSpaces(const char* p) {
+    while (*p == ' ' || *p == '\t')
+        ++p;
+    return p;
+}
+
+// Indeks OBJ (od 1, ujemny względem bieżącej liczby) na indeks od 0; brak - MISSING
+inline int64_t resolveIndex(int64_t index, uint64_t count) {
+    if (index == 0)
+        return MISSING;
+    return index < 0 ? (int64_t)count + index : index - 1;
+}
+
+struct CellRun {
+    uint64_t offset;
+    uint64_t floats;
+};
+
+struct CellBuffer {
+    std::vector<float> data;
+    std::vector<CellRun> runs;
+};
+
+}
+
+// Czytanie pliku kawałków; readChunk nie jest bezpieczne wielowątkowo (jeden FILE)
+class ObjChunkFile {
+public:
+    ObjChunkFile() {
+    }
+
+    ~ObjChunkFile() {
+        if (file)
+            std::fclose(file);
+    }
+
+    ObjChunkFile(const ObjChunkFile&) = delete;
+    ObjChunkFile& operator=(const ObjChunkFile&) = delete;
+
+    bool open(const std::string& path, std::string& error) {
+        using namespace obj_stream_detail;
+        file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        if (std::fread(&fileHeader, sizeof(fileHeader), 1, file) != 1 || std::memcmp(fileHeader.magic, "OBJC", 4) != 0 ||
+            fileHeader.version != VERSION || fileHeader.floatsPerVertex != FLOATS_PER_VERTEX) {
+            error = path + " is not a chunk file of this version";
+            return false;
+        }
+        directory.resize(fileHeader.chunkCount);
+        if (!seek(file, fileHeader.directoryOffset) ||
+            std::fread(directory.data(), sizeof(ObjChunkInfo), directory.size(), file) != directory.size()) {
+            error = path + ": truncated chunk directory";
+            return false;
+        }
+        return true;
+    }
+
+    const ObjChunkHeader& header() const {
+        return fileHeader;
+    }
+
+    const std::vector<ObjChunkInfo>& chunks() const {
+        return directory;
+    }
+
+    bool readChunk(size_t index, std::vector<float>& vertices) {
+        const ObjChunkInfo& chunk = directory[index];
+        vertices.resize((size_t)chunk.vertexCount * obj_stream_detail::FLOATS_PER_VERTEX);
+        return obj_stream_detail::seek(file, chunk.offset) &&
+            std::fread(vertices.data(), sizeof(float), vertices.size(), file) == vertices.size();
+    }
+
+private:
+    FILE* file = nullptr;
+    ObjChunkHeader fileHeader = {};
+    std::vector<ObjChunkInfo> directory;
+};
+
+inline bool convertObjToChunks(const std::string& objPath, const std::string& chunkPath, const ObjStreamOptions& options,
+    ThreadPool& pool, ObjStreamStats& stats, std::string& error) {
+    using namespace obj_stream_detail;
+    auto start = std::chrono::steady_clock::now();
+    stats = ObjStreamStats();
+
+    // Podział limitu: okno 1/16 (do 16 MB), trzy pamięci podręczne po 1/8, bufory komórek 1/4,
+    // składany kawałek z wygładzaniem normalnych najwyżej 1/8
+    size_t cap = std::max<size_t>(options.memoryCap, (size_t)8 << 20);
+    size_t windowBytes = std::min<size_t>(std::max<size_t>(cap / 16, 64 << 10), 16 << 20);
+    size_t cacheBytes = cap / 8;
+    size_t cellBudget = cap / 4;
+    size_t runBytes = std::min<size_t>(1 << 20, std::max<size_t>(cellBudget / 256, 64 << 10));
+    // Bajty na trójkąt przy składaniu: 3 wierzchołki po 8 floatów i szacunkowo ~400 B modelu do wygładzania
+    const size_t ASSEMBLY_TRIANGLE_BYTES = 3 * FLOATS_PER_VERTEX * sizeof(float) + 400;
+    uint32_t chunkTriangles = (uint32_t)std::max<size_t>(256, std::min<size_t>(options.chunkTriangles, cap / 8 / ASSEMBLY_TRIANGLE_BYTES));
+
+    FILE* input = std::fopen(objPath.c_str(), "rb");
+    if (!input) {
+        error = "cannot open " + objPath;
+        return false;
+    }
+    const std::string tempPaths[5] = { chunkPath + ".v.tmp", chunkPath + ".vt.tmp", chunkPath + ".vn.tmp",
+        chunkPath + ".f.tmp", chunkPath + ".runs.tmp" };
+    FILE* temp[5] = {};
+    for (int i = 0; i < 5; ++i)
+        temp[i] = std::fopen(tempPaths[i].c_str(), "w+b");
+    // Wynik powstaje obok i dostaje docelową nazwę dopiero w całości - przerwana konwersja nie zostawia
+    // pliku, który przy następnym starcie otworzyłby się jako gotowy
+    const std::string outputPath = chunkPath + ".tmp";
+    FILE* output = std::fopen(outputPath.c_str(), "wb");
+    auto cleanup = [&]() {
+        std::fclose(input);
+        for (int i = 0; i < 5; ++i) {
+            if (temp[i])
+                std::fclose(temp[i]);
+            std::remove(tempPaths[i].c_str());
+        }
+        if (output)
+            std::fclose(output);
+        std::remove(outputPath.c_str());
+    };
+    for (int i = 0; i < 5; ++i) {
+        if (!temp[i]) {
+            error = "cannot create " + tempPaths[i];
+            cleanup();
+            return false;
+        }
+    }
+    if (!output) {
+        error = "cannot create " + outputPath;
+        cleanup();
+        return false;
+    }
+    FILE* positionFile = temp[0];
+    FILE* texCoordFile = temp[1];
+    FILE* normalFile = temp[2];
+    FILE* faceFile = temp[3];
+    FILE* runFile = temp[4];
+
+    // 1. Okna pliku -> pliki tymczasowe atrybutów i trójkątów (9 indeksów int64: v, vt, vn dla 3 rogów)
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    {
+        LineReader reader(input, windowBytes);
+        stats.peakBytes = reader.bytes();
+        std::vector<int64_t> corners;
+        const char* line;
+        const char* end;
+        while (reader.next(line, end)) {
+            stats.fileBytes += end - line + 1;
+            const char* p = skipSpaces(line);
+            if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+                float v[3];
+                char* next = (char*)p + 1;
+                for (int i = 0; i < 3; ++i)
+                    v[i] = std::strtof(next, &next);
+                std::fwrite(v, sizeof(float), 3, positionFile);
+                boundsMin = glm::min(boundsMin, glm::vec3(v[0], v[1], v[2]));
+                boundsMax = glm::max(boundsMax, glm::vec3(v[0], v[1], v[2]));
+                ++stats.positions;
+            }
+            else if (p[0] == 'v' && p[1] == 't') {
+                float v[2];
+                char* next = (char*)p + 2;
+                v[0] = std::strtof(next, &next);
+                v[1] = std::strtof(next, &next);
+                std::fwrite(v, sizeof(float), 2, texCoordFile);
+                ++stats.texCoords;
+            }
+            else if (p[0] == 'v' && p[1] == 'n') {
+                float v[3];
+                char* next = (char*)p + 2;
+                for (int i = 0; i < 3; ++i)
+                    v[i] = std::strtof(next, &next);
+                std::fwrite(v, sizeof(float), 3, normalFile);
+                ++stats.normals;
+            }
+            else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+                corners.clear();
+                p = skipSpaces(p + 1);
+                while (p < end && *p != '\r' && *p != '#') {
+                    char* next;
+                    int64_t v = std::strtoll(p, &next, 10);
+                    if (next == p)
+                        break;
+                    int64_t vt = 0, vn = 0;
+                    p = next;
+                    if (*p == '/') {
+                        ++p;
+                        if (*p != '/') {
+                            vt = std::strtoll(p, &next, 10);
+                            p = next;
+                        }
+                        if (*p == '/') {
+                            vn = std::strtoll(p + 1, &next, 10);
+                            p = next;
+                        }
+                    }
+                    corners.push_back(resolveIndex(v, stats.positions));
+                    corners.push_back(resolveIndex(vt, stats.texCoords));
+                    corners.push_back(resolveIndex(vn, stats.normals));
+                    p = skipSpaces(p);
+                }
+                for (size_t k = 1; k + 1 < corners.size() / 3; ++k) {
+                    std::fwrite(&corners[0], sizeof(int64_t), 3, faceFile);
+                    std::fwrite(&corners[k * 3], sizeof(int64_t), 6, faceFile);
+                    ++stats.triangles;
+                }
+            }
+        }
+    }
+    if (stats.triangles == 0 || stats.positions == 0) {
+        error = "no faces in " + objPath;
+        cleanup();
+        return false;
+    }
+
+    // Siatka: największa komórka sześcienna, przy której komórek jest nie więcej niż trójkątów / chunkTriangles
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    uint64_t targetCells = std::max<uint64_t>(1, stats.triangles / chunkTriangles);
+    auto cellCount = [&](float size) {
+        uint64_t count = 1;
+        for (int i = 0; i < 3; ++i)
+            count *= (uint64_t)std::min(1024.0f, std::max(1.0f, std::ceil(extent[i] / size)));
+        return count;
+    };
+    float low = std::max(extent.x, std::max(extent.y, extent.z)) / 1024.0f;
+    float high = std::max(extent.x, std::max(extent.y, extent.z));
+    for (int i = 0; i < 40; ++i) {
+        float middle = 0.5f * (low + high);
+        if (cellCount(middle) > targetCells)
+            low = middle;
+        else
+            high = middle;
+    }
+    float cellSize = high;
+    for (int i = 0; i < 3; ++i)
+        stats.grid[i] = (uint32_t)std::min(1024.0f, std::max(1.0f, std::ceil(extent[i] / cellSize)));
+
+    // 2. Trójkąty -> bufory komórek, pełne bufory -> serie w pliku tymczasowym
+    std::fflush(positionFile);
+    std::fflush(texCoordFile);
+    std::fflush(normalFile);
+    std::fflush(faceFile);
+    // Pełny dysk: fwrite zapisuje mniej i ustawia błąd strumienia, więc wystarczy sprawdzić go po fflush
+    for (int i = 0; i < 4; ++i) {
+        if (std::ferror(temp[i])) {
+            error = "cannot write " + tempPaths[i];
+            cleanup();
+            return false;
+        }
+    }
+    SpillCache positions(positionFile, 3, cacheBytes);
+    SpillCache texCoords(texCoordFile, 2, stats.texCoords ? cacheBytes : 0);
+    SpillCache normals(normalFile, 3, stats.normals ? cacheBytes : 0);
+    std::unordered_map<uint64_t, CellBuffer> cells;
+    size_t bufferedBytes = 0;
+    size_t fixedBytes = windowBytes + positions.bytes() + texCoords.bytes() + normals.bytes();
+    auto flushCell = [&](CellBuffer& cell) {
+        if (cell.data.empty())
+            return;
+        cell.runs.push_back(CellRun{ tell(runFile), cell.data.size() });
+        std::fwrite(cell.data.data(), sizeof(float), cell.data.size(), runFile);
+        bufferedBytes -= cell.data.capacity() * sizeof(float);
+        std::vector<float>().swap(cell.data);
+    };
+    {
+        seek(faceFile, 0);
+        std::vector<int64_t> window(std::max<size_t>(9, windowBytes / sizeof(int64_t) / 9 * 9));
+        size_t read;
+        while ((read = std::fread(window.data(), sizeof(int64_t), window.size(), faceFile)) >= 9) {
+            for (size_t t = 0; t + 9 <= read; t += 9) {
+                float triangle[3 * FLOATS_PER_VERTEX];
+                glm::vec3 centroid(0.0f);
+                for (int k = 0; k < 3; ++k) {
+                    const int64_t* corner = &window[t + k * 3];
+                    float* out = triangle + k * FLOATS_PER_VERTEX;
+                    const float* position = positions.get((uint64_t)std::max<int64_t>(0, std::min<int64_t>(corner[0], stats.positions - 1)));
+                    const float* normal = corner[2] >= 0 && (uint64_t)corner[2] < stats.normals ? normals.get(corner[2]) : nullptr;
+                    const float* texCoord = corner[1] >= 0 && (uint64_t)corner[1] < stats.texCoords ? texCoords.get(corner[1]) : nullptr;
+                    for (int i = 0; i < 3; ++i) {
+                        out[i] = position[i];
+                        out[3 + i] = normal ? normal[i] : 0.0f;
+                    }
+                    out[6] = texCoord ? texCoord[0] : 0.0f;
+                    out[7] = texCoord ? texCoord[1] : 0.0f;
+                    centroid += glm::vec3(position[0], position[1], position[2]);
+                }
+                centroid /= 3.0f;
+                uint64_t key = 0;
+                for (int i = 2; i >= 0; --i) {
+                    uint32_t coordinate = (uint32_t)std::min<float>((float)stats.grid[i] - 1.0f,
+                        std::max(0.0f, std::floor((centroid[i] - boundsMin[i]) / cellSize)));
+                    key = key * stats.grid[i] + coordinate;
+                }
+                CellBuffer& cell = cells[key];
+                size_t capacity = cell.data.capacity();
+                cell.data.insert(cell.data.end(), triangle, triangle + 3 * FLOATS_PER_VERTEX);
+                bufferedBytes += (cell.data.capacity() - capacity) * sizeof(float);
+                if (cell.data.size() * sizeof(float) >= runBytes)
+                    flushCell(cell);
+                if (bufferedBytes > cellBudget) {
+                    for (auto& entry : cells)
+                        flushCell(entry.second);
+                }
+                stats.peakBytes = std::max(stats.peakBytes, fixedBytes + bufferedBytes);
+            }
+            if (read < window.size())
+                break;
+        }
+        stats.peakBytes = std::max(stats.peakBytes, fixedBytes + window.size() * sizeof(int64_t) + bufferedBytes);
+    }
+    stats.cacheReads = positions.reads + texCoords.reads + normals.reads;
+    stats.cacheMisses = positions.misses + texCoords.misses + normals.misses;
+
+    // 3. Komórki w kolejności klucza -> kawałki; bez vn normalne liczone w obrębie kawałka
+    std::fflush(runFile);
+    if (std::ferror(runFile)) {
+        error = "cannot write " + tempPaths[4];
+        cleanup();
+        return false;
+    }
+    ObjChunkHeader header = {};
+    std::memcpy(header.magic, "OBJC", 4);
+    header.version = VERSION;
+    header.floatsPerVertex = FLOATS_PER_VERTEX;
+    for (int i = 0; i < 3; ++i) {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+        header.grid[i] = stats.grid[i];
+    }
+    header.cellSize = cellSize;
+    std::fwrite(&header, sizeof(header), 1, output);
+
+    std::vector<uint64_t> keys;
+    keys.reserve(cells.size());
+    for (const auto& entry : cells)
+        keys.push_back(entry.first);
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<ObjChunkInfo> directory;
+    std::vector<float> assembly;
+    assembly.reserve((size_t)chunkTriangles * 3 * FLOATS_PER_VERTEX);
+    const size_t chunkFloats = (size_t)chunkTriangles * 3 * FLOATS_PER_VERTEX;
+    auto emitChunk = [&](uint64_t key) {
+        if (assembly.empty())
+            return;
+        size_t vertexCount = assembly.size() / FLOATS_PER_VERTEX;
+        if (stats.normals == 0) {
+            // Wierzchołki o tych samych bitach pozycji łączone, żeby wygładzanie widziało sąsiednie ściany
+            ObjModel model;
+            std::unordered_map<uint64_t, std::vector<int>> welded;
+            std::vector<int> remap(vertexCount);
+            for (size_t v = 0; v < vertexCount; ++v) {
+                const float* p = &assembly[v * FLOATS_PER_VERTEX];
+                // -0.0f == 0.0f, ale bity się różnią - bez tego takie wierzchołki trafiłyby do innych koszyków
+                float key[3];
+                for (int i = 0; i < 3; ++i)
+                    key[i] = p[i] == 0.0f ? 0.0f : p[i];
+                uint32_t bits[3];
+                std::memcpy(bits, key, sizeof(bits));
+                uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+                int found = -1;
+                for (int candidate : welded[hash]) {
+                    const Vertex& existing = model.vertices[candidate];
+                    if (existing.x == p[0] && existing.y == p[1] && existing.z == p[2]) {
+                        found = candidate;
+                        break;
+                    }
+                }
+                if (found < 0) {
+                    found = (int)model.vertices.size();
+                    model.vertices.push_back(Vertex{ p[0], p[1], p[2] });
+                    welded[hash].push_back(found);
+                }
+                remap[v] = found;
+            }
+            model.faces.resize(vertexCount / 3);
+            for (size_t f = 0; f < model.faces.size(); ++f)
+                model.faces[f].vertexIndices = { remap[f * 3], remap[f * 3 + 1], remap[f * 3 + 2] };
+            stats.peakBytes = std::max(stats.peakBytes, fixedBytes + bufferedBytes + assembly.capacity() * sizeof(float)
+                + model.faces.size() * (sizeof(Face) + 6 * sizeof(int)) + model.vertices.size() * (sizeof(Vertex) + 48));
+            generateObjNormals(model, pool, options.creaseAngle);
+            for (size_t v = 0; v < vertexCount; ++v) {
+                const Normal& normal = model.normals[model.faces[v / 3].normalIndices[v % 3]];
+                assembly[v * FLOATS_PER_VERTEX + 3] = normal.nx;
+                assembly[v * FLOATS_PER_VERTEX + 4] = normal.ny;
+                assembly[v * FLOATS_PER_VERTEX + 5] = normal.nz;
+            }
+        }
+
+        ObjChunkInfo chunk = {};
+        uint64_t rest = key;
+        for (int i = 0; i < 3; ++i) {
+            chunk.cell[i] = (uint32_t)(rest % stats.grid[i]);
+            rest /= stats.grid[i];
+            chunk.boundsMin[i] = std::numeric_limits<float>::max();
+            chunk.boundsMax[i] = -std::numeric_limits<float>::max();
+        }
+        for (size_t v = 0; v < vertexCount; ++v) {
+            for (int i = 0; i < 3; ++i) {
+                chunk.boundsMin[i] = std::min(chunk.boundsMin[i], assembly[v * FLOATS_PER_VERTEX + i]);
+                chunk.boundsMax[i] = std::max(chunk.boundsMax[i], assembly[v * FLOATS_PER_VERTEX + i]);
+            }
+        }
+        chunk.vertexCount = (uint32_t)vertexCount;
+        chunk.offset = tell(output);
+        std::fwrite(assembly.data(), sizeof(float), assembly.size(), output);
+        directory.push_back(chunk);
+        assembly.clear();
+    };
+    auto append = [&](const float* data, size_t floats, uint64_t key) {
+        while (floats > 0) {
+            size_t take = std::min(floats, chunkFloats - assembly.size());
+            assembly.insert(assembly.end(), data, data + take);
+            data += take;
+            floats -= take;
+            if (assembly.size() == chunkFloats)
+                emitChunk(key);
+        }
+    };
+    std::vector<float> runData;
+    for (uint64_t key : keys) {
+        CellBuffer& cell = cells[key];
+        for (const CellRun& run : cell.runs) {
+            runData.resize((size_t)run.floats);
+            seek(runFile, run.offset);
+            if (std::fread(runData.data(), sizeof(float), runData.size(), runFile) != runData.size()) {
+                error = "cannot read back " + tempPaths[4];
+                cleanup();
+                return false;
+            }
+            append(runData.data(), runData.size(), key);
+        }
+        append(cell.data.data(), cell.data.size(), key);
+        emitChunk(key);
+        bufferedBytes -= cell.data.capacity() * sizeof(float);
+        std::vector<float>().swap(cell.data);
+    }
+
+    header.chunkCount = (uint32_t)directory.size();
+    header.directoryOffset = tell(output);
+    std::fwrite(directory.data(), sizeof(ObjChunkInfo), directory.size(), output);
+    seek(output, 0);
+    std::fwrite(&header, sizeof(header), 1, output);
+    bool ok = std::ferror(output) == 0;
+    ok = std::fclose(output) == 0 && ok;
+    output = nullptr;
+    stats.chunks = directory.size();
+    if (ok) {
+        std::remove(chunkPath.c_str());
+        ok = std::rename(outputPath.c_str(), chunkPath.c_str()) == 0;
+    }
+    cleanup();
+    if (!ok) {
+        error = "cannot write " + chunkPath;
+        return false;
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
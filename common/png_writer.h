@@ -0,0 +1,102 @@
+﻿#pragma once
+// Minimalny zapis PNG (RGBA8) bez zależności: dane w blokach deflate bez kompresji, więc pliki są duże,
+// ale każdy dekoder je czyta. Wystarcza do zrzutów z rasteryzera programowego i glReadPixels.
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace png_detail {
+
+struct CrcTable {
+    uint32_t values[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            values[i] = value;
+        }
+    }
+};
+
+inline uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+inline void writeChunk(FILE* file, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    putBigEndian(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    std::fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+}
+
+// bottomUp: wiersz 0 to dół obrazu (kolejność z glReadPixels i SoftFramebuffer)
+inline bool writePng(const std::string& path, int width, int height, const unsigned char* rgba, bool bottomUp) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    // Każdy wiersz poprzedzony bajtem filtra 0 (bez filtrowania)
+    size_t rowBytes = (size_t)width * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int row = 0; row < height; ++row) {
+        int source = bottomUp ? height - 1 - row : row;
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + source * rowBytes, rgba + (source + 1) * rowBytes);
+    }
+
+    // Strumień zlib: nagłówek, bloki "stored" po najwyżej 65535 bajtów, Adler-32
+    std::vector<unsigned char> zlib = { 0x78, 0x01 };
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + length == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)length);
+        zlib.push_back((unsigned char)(length >> 8));
+        zlib.push_back((unsigned char)~length);
+        zlib.push_back((unsigned char)(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    png_detail::putBigEndian(zlib, (b << 16) | a);
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::fwrite(signature, 1, sizeof(signature), file);
+    std::vector<unsigned char> header;
+    png_detail::putBigEndian(header, (uint32_t)width);
+    png_detail::putBigEndian(header, (uint32_t)height);
+    // 8 bitów na kanał, typ 6 (RGBA), deflate, filtrowanie standardowe, bez przeplotu
+    const unsigned char format[5] = { 8, 6, 0, 0, 0 };
+    header.insert(header.end(), format, format + 5);
+    png_detail::writeChunk(file, "IHDR", header);
+    png_detail::writeChunk(file, "IDAT", zlib);
+    png_detail::writeChunk(file, "IEND", std::vector<unsigned char>());
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
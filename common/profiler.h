@@ -0,0 +1,309 @@
+﻿#pragma once
+// Profiler klatki. Strefy CPU mierzą obiekty RAII, strefy GPU - zapytania GL_TIME_ELAPSED w pierścieniu
+// (wynik czytany kilka klatek później, żeby nie czekać na GPU). Dla każdej strefy liczone są kroczące
+// min/avg/p99, a wybrane klatki można zapisać w formacie Chrome trace (chrome://tracing, ui.perfetto.dev).
+#include <GL/glew.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+class Profiler {
+public:
+    // Okno statystyk kroczących w klatkach
+    static constexpr int HISTORY = 256;
+    // Po tylu klatkach wynik zapytania GPU jest praktycznie zawsze gotowy
+    static constexpr int GPU_LATENCY = 4;
+
+    struct ZoneStats {
+        float min = 0.0f;
+        float avg = 0.0f;
+        float p99 = 0.0f;
+        int samples = 0;
+    };
+
+    explicit Profiler(float reportInterval = 2.0f) : reportInterval(reportInterval) {
+        start = Clock::now();
+        lastReport = start;
+        gpuAvailable = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+        if (!gpuAvailable)
+            std::cerr << "Profiler: no GL timer queries, GPU zones disabled" << std::endl;
+        zones.reserve(32);
+        frameZone = zone("frame");
+    }
+
+    ~Profiler() {
+        for (Zone& z : zones) {
+            if (z.gpu)
+                glDeleteQueries(GPU_LATENCY, z.queries);
+        }
+    }
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Rejestracja strefy przed pętlą renderowania. Strefy GPU nie mogą się zagnieżdżać ani nakładać
+    // (ograniczenie GL_TIME_ELAPSED) i mierzą jeden przedział na klatkę.
+    int zone(const char* name, bool gpu = false) {
+        Zone z;
+        z.name = name;
+        z.gpu = gpu && gpuAvailable;
+        if (z.gpu)
+            glGenQueries(GPU_LATENCY, z.queries);
+        zones.push_back(z);
+        return (int)zones.size() - 1;
+    }
+
+    void beginFrame() {
+        collectGpu();
+        beginCpu(frameZone);
+    }
+
+    void endFrame() {
+        endCpu(frameZone);
+        for (Zone& z : zones) {
+            if (!z.gpu) {
+                push(z, z.frameTime);
+                z.frameTime = 0.0f;
+            }
+        }
+        ++frame;
+        if (capturing && frame >= captureEnd + GPU_LATENCY)
+            finishCapture();
+    }
+
+    void beginCpu(int id) {
+        zones[id].cpuStart = now();
+    }
+
+    void endCpu(int id) {
+        Zone& z = zones[id];
+        double end = now();
+        z.frameTime += (float)((end - z.cpuStart) / 1000.0);
+        record(id, 0, z.cpuStart, end - z.cpuStart, frame);
+    }
+
+    // Czas zmierzony poza profilerem (np. na innym wątku) doliczany do strefy w bieżącej klatce
+    void addCpu(int id, float milliseconds) {
+        zones[id].frameTime += milliseconds;
+    }
+
+    void beginGpu(int id) {
+        Zone& z = zones[id];
+        if (!z.gpu)
+            return;
+        int slot = (int)(frame % GPU_LATENCY);
+        glBeginQuery(GL_TIME_ELAPSED, z.queries[slot]);
+        z.issueTime[slot] = now();
+        z.issueFrame[slot] = frame;
+    }
+
+    void endGpu(int id) {
+        Zone& z = zones[id];
+        if (!z.gpu)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        z.pending[frame % GPU_LATENCY] = true;
+    }
+
+    ZoneStats stats(int id) const {
+        const Zone& z = zones[id];
+        ZoneStats result;
+        result.samples = z.count;
+        if (z.count == 0)
+            return result;
+        float sum = 0.0f;
+        result.min = z.history[0];
+        for (int i = 0; i < z.count; ++i) {
+            scratch[i] = z.history[i];
+            sum += z.history[i];
+            result.min = std::min(result.min, z.history[i]);
+        }
+        result.avg = sum / z.count;
+        int p99Index = std::max(0, (int)std::ceil(z.count * 0.99f) - 1);
+        std::nth_element(scratch, scratch + p99Index, scratch + z.count);
+        result.p99 = scratch[p99Index];
+        return result;
+    }
+
+    // true raz na reportInterval sekund - pętla decyduje, czy wtedy wypisać raport
+    bool reportDue() {
+        Clock::time_point current = Clock::now();
+        if (std::chrono::duration<float>(current - lastReport).count() < reportInterval)
+            return false;
+        lastReport = current;
+        return true;
+    }
+
+    void report(std::ostream& out) const {
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < zones.size(); ++i) {
+            ZoneStats s = stats((int)i);
+            if (s.samples == 0)
+                continue;
+            out << (zones[i].gpu ? "[gpu] " : "[cpu] ") << std::left << std::setw(10) << zones[i].name << std::right
+                << " min " << s.min << " avg " << s.avg << " p99 " << s.p99 << " ms" << std::endl;
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    // Zapisuje kolejne `frames` klatek do pliku JSON. Zdarzenia GPU trafiają na osobny wątek "GPU";
+    // ich początek to moment zlecenia na CPU, bo GL_TIME_ELAPSED podaje tylko czas trwania.
+    void captureTrace(const std::string& path, int frames) {
+        if (capturing)
+            return;
+        capturing = true;
+        capturePath = path;
+        captureBegin = frame;
+        captureEnd = frame + frames;
+        events.clear();
+        events.reserve((size_t)frames * zones.size() * 2);
+        std::cout << "Profiler: capturing " << frames << " frames to " << path << std::endl;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Zone {
+        const char* name = "";
+        bool gpu = false;
+        float history[HISTORY] = {};
+        int next = 0;
+        int count = 0;
+        float frameTime = 0.0f;
+        double cpuStart = 0.0;
+        GLuint queries[GPU_LATENCY] = {};
+        bool pending[GPU_LATENCY] = {};
+        double issueTime[GPU_LATENCY] = {};
+        unsigned long long issueFrame[GPU_LATENCY] = {};
+    };
+
+    struct TraceEvent {
+        int zone;
+        int thread;
+        double start;
+        double duration;
+    };
+
+    // Mikrosekundy od utworzenia profilera - jednostka formatu Chrome trace
+    double now() const {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    static void push(Zone& z, float milliseconds) {
+        z.history[z.next] = milliseconds;
+        z.next = (z.next + 1) % HISTORY;
+        if (z.count < HISTORY)
+            ++z.count;
+    }
+
+    void record(int id, int thread, double begin, double duration, unsigned long long eventFrame) {
+        if (capturing && eventFrame >= captureBegin && eventFrame < captureEnd) {
+            TraceEvent event = { id, thread, begin, duration };
+            events.push_back(event);
+        }
+    }
+
+    // Odczyt zapytań, które za chwilę zostaną użyte ponownie - zlecone GPU_LATENCY klatek temu
+    void collectGpu() {
+        int slot = (int)(frame % GPU_LATENCY);
+        for (size_t i = 0; i < zones.size(); ++i) {
+            Zone& z = zones[i];
+            if (!z.gpu || !z.pending[slot])
+                continue;
+            GLuint64 elapsedNs = 0;
+            glGetQueryObjectui64v(z.queries[slot], GL_QUERY_RESULT, &elapsedNs);
+            z.pending[slot] = false;
+            push(z, (float)(elapsedNs / 1.0e6));
+            record((int)i, 1, z.issueTime[slot], elapsedNs / 1000.0, z.issueFrame[slot]);
+        }
+    }
+
+    static void writeJsonString(std::ostream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; *c; ++c) {
+            if (*c == '"' || *c == '\\')
+                out << '\\';
+            out << *c;
+        }
+        out << '"';
+    }
+
+    void finishCapture() {
+        capturing = false;
+        std::ofstream file(capturePath);
+        if (!file.is_open()) {
+            std::cerr << "Profiler: cannot write " << capturePath << std::endl;
+            return;
+        }
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+        for (const TraceEvent& event : events) {
+            file << ",\n{\"name\":";
+            writeJsonString(file, zones[event.zone].name);
+            file << ",\"cat\":\"" << (event.thread ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+                << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+        }
+        file << "\n]}\n";
+        std::cout << "Profiler: trace written to " << capturePath << " (" << events.size() << " events)" << std::endl;
+        events.clear();
+    }
+
+    std::vector<Zone> zones;
+    mutable float scratch[HISTORY];
+    int frameZone = 0;
+    bool gpuAvailable = false;
+    unsigned long long frame = 0;
+    Clock::time_point start;
+    Clock::time_point lastReport;
+    float reportInterval;
+
+    bool capturing = false;
+    std::string capturePath;
+    unsigned long long captureBegin = 0;
+    unsigned long long captureEnd = 0;
+    std::vector<TraceEvent> events;
+};
+
+// Strefa CPU na czas życia obiektu
+class CpuProfileScope {
+public:
+    CpuProfileScope(Profiler& profiler, int zone) : profiler(profiler), zone(zone) {
+        profiler.beginCpu(zone);
+    }
+    ~CpuProfileScope() {
+        profiler.endCpu(zone);
+    }
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+private:
+    Profiler& profiler;
+    int zone;
+};
+
+// Strefa GPU na czas życia obiektu - obejmuje komendy GL zlecone w tym czasie
+class GpuProfileScope {
+public:
+    GpuProfileScope(Profiler& profiler, int zone) : profiler(profiler), zone(zone) {
+        profiler.beginGpu(zone);
+    }
+    ~GpuProfileScope() {
+        profiler.endGpu(zone);
+    }
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    Profiler& profiler;
+    int zone;
+};
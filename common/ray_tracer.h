@@ -0,0 +1,284 @@
+﻿#pragma once
+// Śledzenie promieni na CPU: promienie pierwotne i cieni przez Bvh, oświetlenie jak w grafika_5/cube.frag
+// (ambient + rozproszone bez odbłysków, razy kolor tekstury), tylko że zamiast braku cieni promień do
+// światła decyduje, czy składowa rozproszona jest widoczna. Promienie w pakietach 2x2 piksele.
+//
+// Obraz dzielony na kafelki TILE x TILE. Każdy wątek dostaje ciągły zakres kafelków we własnej kolejce
+// i bierze je od przodu; gdy skończy, podkrada od końca kolejek innych wątków (kafelki z drogim
+// modelem nie zostają wtedy na jednym wątku). Wynik nie zależy od tego, kto policzył kafelek.
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "thread_pool.h"
+#include "bvh.h"
+#include "soft_raster.h"
+
+// Parametry światła z uniformów grafika_5
+struct RayTraceLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 ambientColor = glm::vec3(1.0f);
+    glm::vec3 diffuseColor = glm::vec3(1.0f);
+    float ambientStrength = 0.1f;
+    float lightStrength = 1.0f;
+};
+
+class RayTracer {
+public:
+    static constexpr int TILE = 16;
+
+    explicit RayTracer(ThreadPool& pool)
+        : pool(pool), queues(pool.size()), counters(pool.size()) {
+    }
+
+    RayTracer(const RayTracer&) = delete;
+    RayTracer& operator=(const RayTracer&) = delete;
+
+    // Strumień jak dla glDrawArrays(GL_TRIANGLES), musi istnieć do końca renderowania (nie jest kopiowany).
+    // Pozycja to pierwsze 3 floaty wierzchołka; offset < 0 - brak atrybutu (normalna z trójkąta, uv = 0).
+    void setMesh(const float* vertices, size_t vertexCount, size_t vertexStride, int normals, int texCoords) {
+        stream = vertices;
+        stride = vertexStride;
+        normalOffset = normals;
+        texCoordOffset = texCoords;
+        auto start = std::chrono::steady_clock::now();
+        bvh.build(vertices, vertexCount / 3, vertexStride, pool);
+        buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // Przesunięcie początku promienia cienia względem rozmiaru sceny, żeby nie trafiał we własny trójkąt
+        Aabb box = bvh.sceneBounds();
+        epsilon = bvh.nodeCount() > 0 ? glm::length(box.max - box.min) * 1e-4f : 0.0f;
+    }
+
+    double buildMilliseconds() const {
+        return buildSeconds * 1000.0;
+    }
+
+    size_t nodeCount() const {
+        return bvh.nodeCount();
+    }
+
+    // Wiersz 0 na dole, jak w SoftFramebuffer; texture == nullptr - kolor biały
+    void render(SoftFramebuffer& target, const glm::mat4& view, const glm::mat4& proj, const RayTraceLight& light,
+        const SoftTexture* texture, const glm::vec3& background) {
+        Frame frame = { &target, glm::inverse(proj * view), &light, texture, background };
+        int tilesX = (target.width + TILE - 1) / TILE;
+        int tilesY = (target.height + TILE - 1) / TILE;
+        int tileCount = tilesX * tilesY;
+
+        unsigned slots = (unsigned)queues.size();
+        for (unsigned i = 0; i < slots; ++i) {
+            TileQueue& queue = queues[i];
+            queue.tiles.clear();
+            queue.head = 0;
+            for (int tile = (int)((size_t)tileCount * i / slots); tile < (int)((size_t)tileCount * (i + 1) / slots); ++tile)
+                queue.tiles.push_back(tile);
+            counters[i] = Counters();
+        }
+
+        // Jedno zadanie na kolejkę; wątek, który skończy swoją, podkrada z pozostałych
+        pool.parallelFor(slots, 1, [&](size_t begin, size_t end, unsigned) {
+            for (size_t slot = begin; slot < end; ++slot) {
+                int tile;
+                while (takeTile((unsigned)slot, tile))
+                    renderTile(frame, tile % tilesX, tile / tilesX, counters[slot]);
+            }
+        });
+
+        rays = 0;
+        stolen = 0;
+        for (const Counters& counter : counters) {
+            rays += counter.rays;
+            stolen += counter.stolen;
+        }
+    }
+
+    // Promienie pierwotne i cieni z ostatniego render()
+    unsigned long long raysTraced() const {
+        return rays;
+    }
+
+    // Kafelki policzone przez inny wątek niż właściciel kolejki w ostatnim render()
+    unsigned long long stolenTiles() const {
+        return stolen;
+    }
+
+private:
+    struct TileQueue {
+        std::mutex mutex;
+        std::vector<int> tiles;
+        size_t head = 0;
+    };
+
+    // Osobna linia pamięci podręcznej na wątek, żeby liczniki nie przeskakiwały między rdzeniami
+    struct alignas(64) Counters {
+        unsigned long long rays = 0;
+        unsigned long long stolen = 0;
+    };
+
+    struct Frame {
+        SoftFramebuffer* target;
+        glm::mat4 inverseViewProj;
+        const RayTraceLight* light;
+        const SoftTexture* texture;
+        glm::vec3 background;
+    };
+
+    bool takeTile(unsigned slot, int& tile) {
+        {
+            TileQueue& own = queues[slot];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.head < own.tiles.size()) {
+                tile = own.tiles[own.head++];
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            TileQueue& victim = queues[(slot + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.head < victim.tiles.size()) {
+                tile = victim.tiles.back();
+                victim.tiles.pop_back();
+                ++counters[slot].stolen;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void renderTile(const Frame& frame, int tileX, int tileY, Counters& counter) const {
+        SoftFramebuffer& target = *frame.target;
+        int x0 = tileX * TILE;
+        int y0 = tileY * TILE;
+        int x1 = std::min(x0 + TILE, target.width);
+        int y1 = std::min(y0 + TILE, target.height);
+        for (int y = y0; y < y1; y += 2) {
+            for (int x = x0; x < x1; x += 2) {
+                // Pakiet 2x2: lane 0 (x, y), 1 (x + 1, y), 2 (x, y + 1), 3 (x + 1, y + 1)
+                RayPacket primary;
+                primary.active = 0;
+                int pixelX[4], pixelY[4];
+                for (int lane = 0; lane < 4; ++lane) {
+                    pixelX[lane] = x + (lane & 1);
+                    pixelY[lane] = y + (lane >> 1);
+                    bool inside = pixelX[lane] < x1 && pixelY[lane] < y1;
+                    // Punkty na płaszczyźnie bliskiej i dalekiej z odwróconej macierzy widoku i rzutowania
+                    float ndcX = (pixelX[lane] + 0.5f) / target.width * 2.0f - 1.0f;
+                    float ndcY = (pixelY[lane] + 0.5f) / target.height * 2.0f - 1.0f;
+                    glm::vec4 nearPoint = frame.inverseViewProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                    glm::vec4 farPoint = frame.inverseViewProj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+                    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+                    glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+                    setRay(primary, lane, origin, direction, std::numeric_limits<float>::max());
+                    if (inside)
+                        primary.active |= 1 << lane;
+                }
+                HitPacket hits;
+                bvh.intersect(primary, hits);
+
+                // Nieaktywne pasma dostają promień pierwotny, żeby pakiet nie niósł niezainicjowanych floatów
+                RayPacket shadow = primary;
+                shadow.active = 0;
+                glm::vec3 lit[4], ambient[4];
+                for (int lane = 0; lane < 4; ++lane) {
+                    lit[lane] = ambient[lane] = frame.background;
+                    if (!(primary.active & (1 << lane)) || hits.triangle[lane] < 0)
+                        continue;
+                    glm::vec3 direction(primary.dx[lane], primary.dy[lane], primary.dz[lane]);
+                    glm::vec3 origin(primary.ox[lane], primary.oy[lane], primary.oz[lane]);
+                    glm::vec3 point = origin + direction * hits.t[lane];
+                    glm::vec3 geometric;
+                    float diffuse = shade(frame, hits, lane, point, geometric, lit[lane], ambient[lane]);
+                    if (diffuse <= 0.0f)
+                        continue;
+                    // Promień cienia od strony widza, do samego światła
+                    if (glm::dot(geometric, direction) > 0.0f)
+                        geometric = -geometric;
+                    glm::vec3 toLight = frame.light->position - point;
+                    float distance = glm::length(toLight);
+                    setRay(shadow, lane, point + geometric * epsilon, toLight / distance, distance);
+                    shadow.active |= 1 << lane;
+                }
+                int occluded = shadow.active ? bvh.occluded(shadow) : 0;
+
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (!(primary.active & (1 << lane)))
+                        continue;
+                    glm::vec3 color = (occluded & (1 << lane)) ? ambient[lane] : lit[lane];
+                    unsigned char* pixel = &target.color[((size_t)pixelY[lane] * target.width + pixelX[lane]) * 4];
+                    pixel[0] = SoftFramebuffer::toUnorm(color.r);
+                    pixel[1] = SoftFramebuffer::toUnorm(color.g);
+                    pixel[2] = SoftFramebuffer::toUnorm(color.b);
+                    pixel[3] = 255;
+                    ++counter.rays;
+                }
+                for (int lane = 0; lane < 4; ++lane)
+                    counter.rays += (shadow.active >> lane) & 1;
+            }
+        }
+    }
+
+    static void setRay(RayPacket& packet, int lane, const glm::vec3& origin, const glm::vec3& direction, float tmax) {
+        packet.ox[lane] = origin.x;
+        packet.oy[lane] = origin.y;
+        packet.oz[lane] = origin.z;
+        packet.dx[lane] = direction.x;
+        packet.dy[lane] = direction.y;
+        packet.dz[lane] = direction.z;
+        packet.tmax[lane] = tmax;
+    }
+
+    // Kolor oświetlony i sam ambient (gdy punkt jest w cieniu); zwraca składową rozproszoną max(N.L, 0)
+    float shade(const Frame& frame, const HitPacket& hits, int lane, const glm::vec3& point, glm::vec3& geometric,
+        glm::vec3& lit, glm::vec3& ambient) const {
+        const float* v0 = stream + (size_t)bvh.sourceTriangle(hits.triangle[lane]) * 3 * stride;
+        const float* v1 = v0 + stride;
+        const float* v2 = v1 + stride;
+        float u = hits.u[lane];
+        float v = hits.v[lane];
+        float w = 1.0f - u - v;
+        auto interpolate3 = [&](int offset) {
+            return glm::vec3(v0[offset], v0[offset + 1], v0[offset + 2]) * w
+                + glm::vec3(v1[offset], v1[offset + 1], v1[offset + 2]) * u
+                + glm::vec3(v2[offset], v2[offset + 1], v2[offset + 2]) * v;
+        };
+
+        glm::vec3 p0(v0[0], v0[1], v0[2]);
+        geometric = glm::normalize(glm::cross(glm::vec3(v1[0], v1[1], v1[2]) - p0, glm::vec3(v2[0], v2[1], v2[2]) - p0));
+        glm::vec3 normal = normalOffset >= 0 ? glm::normalize(interpolate3(normalOffset)) : geometric;
+        glm::vec3 texColor(1.0f);
+        if (frame.texture && texCoordOffset >= 0) {
+            glm::vec2 uv = glm::vec2(v0[texCoordOffset], v0[texCoordOffset + 1]) * w
+                + glm::vec2(v1[texCoordOffset], v1[texCoordOffset + 1]) * u
+                + glm::vec2(v2[texCoordOffset], v2[texCoordOffset + 1]) * v;
+            texColor = frame.texture->sample(uv);
+        }
+        else if (frame.texture) {
+            texColor = frame.texture->sample(glm::vec2(0.0f));
+        }
+
+        const RayTraceLight& light = *frame.light;
+        glm::vec3 lightDirection = glm::normalize(light.position - point);
+        float diffuse = std::max(glm::dot(normal, lightDirection), 0.0f);
+        ambient = light.ambientStrength * light.ambientColor * texColor;
+        lit = (light.ambientStrength * light.ambientColor + diffuse * light.diffuseColor * light.lightStrength) * texColor;
+        return diffuse;
+    }
+
+    ThreadPool& pool;
+    Bvh bvh;
+    std::vector<TileQueue> queues;
+    std::vector<Counters> counters;
+    const float* stream = nullptr;
+    size_t stride = 0;
+    int normalOffset = -1;
+    int texCoordOffset = -1;
+    float epsilon = 0.0f;
+    double buildSeconds = 0.0;
+    unsigned long long rays = 0;
+    unsigned long long stolen = 0;
+};
@@ -0,0 +1,208 @@
+﻿#pragma once
+// Kolejka rysowania klatki: każdy pakiet to DrawCommand z 64-bitowym kluczem (warstwa, program, materiał,
+// głębokość). Klucz nieprzezroczystych sortuje po stanie, a w obrębie stanu od przodu do tyłu (wcześniejszy
+// test głębokości odrzuca zasłonięte fragmenty); klucz przezroczystych zaczyna się od odwróconej głębokości,
+// więc idą od tyłu do przodu. Wypełniać można równolegle: push() z indeksem wątku z ThreadPool::parallelFor
+// pisze do koszyka tego wątku, bez blokad. sort() to LSD radix sort po bajtach klucza, stabilny i bez
+// porównań; przebiegi, w których bajt jest wszędzie taki sam, są pomijane. Pamięć zostaje między klatkami.
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+#include "gl_state_cache.h"
+
+enum class RenderLayer {
+    Opaque = 0,
+    Transparent = 1
+};
+
+struct RenderQueueStats {
+    size_t packets = 0;
+    size_t opaque = 0;
+    size_t transparent = 0;
+    double sortMilliseconds = 0.0;
+};
+
+struct RenderQueueConfig {
+    // Siatka instances x instances obiektów
+    int instances = 1;
+    // Co który obiekt jest przezroczysty; 0 wyłącza
+    int transparentEvery = 0;
+};
+
+inline RenderQueueConfig parseRenderQueueArgs(int argc, char** argv) {
+    RenderQueueConfig config;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--instances") == 0)
+            config.instances = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--transparent") == 0)
+            config.transparentEvery = std::max(0, std::atoi(argv[++i]));
+    }
+    return config;
+}
+
+class RenderQueue {
+public:
+    static constexpr int DEPTH_BITS = 24;
+    static constexpr uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+
+    RenderQueue(unsigned threadCount, float nearPlane, float farPlane)
+        : buckets(std::max(threadCount, 1u)), nearPlane(nearPlane), farPlane(farPlane) {
+        entries.reserve(256);
+        scratch.reserve(256);
+    }
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    unsigned threadCount() const {
+        return (unsigned)buckets.size();
+    }
+
+    // Na początku klatki, przed wypełnianiem
+    void begin() {
+        for (Bucket& bucket : buckets)
+            bucket.packets.clear();
+        entries.clear();
+    }
+
+    // viewDepth to odległość wzdłuż kierunku patrzenia; wartości spoza [near, far] są przycinane
+    void push(unsigned thread, RenderLayer layer, float viewDepth, const DrawCommand& command) {
+        buckets[thread].packets.push_back(Packet{ makeKey(layer, viewDepth, command), command });
+    }
+
+    void sort() {
+        auto start = std::chrono::steady_clock::now();
+        entries.clear();
+        for (uint32_t thread = 0; thread < buckets.size(); ++thread) {
+            const std::vector<Packet>& packets = buckets[thread].packets;
+            for (uint32_t i = 0; i < packets.size(); ++i)
+                entries.push_back(SortEntry{ packets[i].key, thread << 24 | i });
+        }
+        radixSort();
+        stats.sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Po sort(): warstwy po kolei, stan blend/depthMask przełączany raz na granicy warstw
+    void submit(GlStateCache& state) {
+        stats.packets = entries.size();
+        stats.opaque = 0;
+        stats.transparent = 0;
+        int layer = -1;
+        for (const SortEntry& entry : entries) {
+            int entryLayer = (int)(entry.key >> 62);
+            if (entryLayer != layer) {
+                layer = entryLayer;
+                applyLayer(state, (RenderLayer)layer);
+            }
+            if (layer == (int)RenderLayer::Opaque)
+                ++stats.opaque;
+            else
+                ++stats.transparent;
+            submitDraw(state, buckets[entry.ref >> 24].packets[entry.ref & 0xFFFFFF].command);
+        }
+        if (layer != (int)RenderLayer::Opaque)
+            applyLayer(state, RenderLayer::Opaque);
+    }
+
+    size_t size() const {
+        size_t count = 0;
+        for (const Bucket& bucket : buckets)
+            count += bucket.packets.size();
+        return count;
+    }
+
+    const RenderQueueStats& statistics() const {
+        return stats;
+    }
+
+    void report(std::ostream& out) const {
+        out << "Queue: " << stats.packets << " packets (" << stats.opaque << " opaque, " << stats.transparent
+            << " transparent), sort " << stats.sortMilliseconds << " ms\n";
+    }
+
+private:
+    struct Packet {
+        uint64_t key;
+        DrawCommand command;
+    };
+
+    // ref: 8 bitów wątku, 24 bity indeksu w jego koszyku
+    struct SortEntry {
+        uint64_t key;
+        uint32_t ref;
+    };
+
+    // Koszyk na osobnej linii cache, żeby wątki nie unieważniały sobie nawzajem nagłówków wektorów
+    struct alignas(64) Bucket {
+        std::vector<Packet> packets;
+    };
+
+    uint32_t quantizeDepth(float viewDepth) const {
+        float t = (viewDepth - nearPlane) / (farPlane - nearPlane);
+        t = std::min(std::max(t, 0.0f), 1.0f);
+        return (uint32_t)(t * DEPTH_MAX);
+    }
+
+    // Nieprzezroczyste: warstwa(2) | program(14) | materiał(16) | głębokość(24) | 8 wolnych bitów.
+    // Przezroczyste: warstwa(2) | odwrócona głębokość(24) | program(14) | materiał(16) | 8 wolnych bitów.
+    // Materiałem jest tekstura, a gdy jej nie ma - VAO.
+    uint64_t makeKey(RenderLayer layer, float viewDepth, const DrawCommand& command) const {
+        uint64_t program = command.program & 0x3FFF;
+        uint64_t material = (command.texture != 0 ? command.texture : command.vertexArray) & 0xFFFF;
+        uint64_t depth = quantizeDepth(viewDepth);
+        if (layer == RenderLayer::Opaque)
+            return program << 48 | material << 32 | depth << 8;
+        return (uint64_t)1 << 62 | (DEPTH_MAX - depth) << 38 | program << 24 | material << 8;
+    }
+
+    void radixSort() {
+        size_t count = entries.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+        SortEntry* source = entries.data();
+        SortEntry* target = scratch.data();
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t offsets[256] = {};
+            for (size_t i = 0; i < count; ++i)
+                ++offsets[(source[i].key >> shift) & 0xFF];
+            // Wszystkie klucze mają ten bajt równy - przebieg niczego by nie zmienił
+            if (offsets[(source[0].key >> shift) & 0xFF] == count)
+                continue;
+            size_t sum = 0;
+            for (size_t& offset : offsets) {
+                size_t bucketCount = offset;
+                offset = sum;
+                sum += bucketCount;
+            }
+            for (size_t i = 0; i < count; ++i)
+                target[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+            std::swap(source, target);
+        }
+        if (source != entries.data())
+            std::copy(source, source + count, entries.data());
+    }
+
+    static void applyLayer(GlStateCache& state, RenderLayer layer) {
+        if (layer == RenderLayer::Transparent) {
+            state.enable(GL_BLEND);
+            state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            state.depthMask(false);
+        }
+        else {
+            state.disable(GL_BLEND);
+            state.depthMask(true);
+        }
+    }
+
+    std::vector<Bucket> buckets;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    float nearPlane;
+    float farPlane;
+    RenderQueueStats stats;
+};
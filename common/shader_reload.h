@@ -0,0 +1,345 @@
+﻿#pragma once
+// Przeładowywanie shaderów z plików bez zatrzymywania pętli renderowania.
+// Zmiany w katalogu z shaderami wykrywa inotify (Linux) albo odpytywanie czasów modyfikacji,
+// a kompilacja idzie równolegle w sterowniku (GL_KHR_parallel_shader_compile) lub na osobnym
+// wątku ze współdzielonym kontekstem. Nowe programy podmieniane są dopiero, gdy cała paczka się zlinkuje.
+#include <GL/glew.h>
+#include <SFML/Window.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+inline bool readShaderFile(const std::string& path, std::string& source) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open shader file: " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    source = buffer.str();
+    return true;
+}
+
+// Opis jednego programu: pełne źródła (z #version) i nazwy atrybutów wiązane z kolejnymi lokalizacjami
+struct ProgramDesc {
+    std::string vertexSource;
+    std::string fragmentSource;
+    std::vector<std::string> attribs;
+    std::string fragOutput;
+};
+
+class ShaderFileWatcher {
+public:
+    explicit ShaderFileWatcher(const std::string& directory) : directory(directory) {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            std::cerr << "inotify_add_watch failed for " << directory << ", falling back to polling" << std::endl;
+            close(fd);
+            fd = -1;
+        }
+#endif
+        lastWrite = newestWriteTime();
+    }
+
+    ~ShaderFileWatcher() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    ShaderFileWatcher(const ShaderFileWatcher&) = delete;
+    ShaderFileWatcher& operator=(const ShaderFileWatcher&) = delete;
+
+    // Nieblokujące - zwraca true, jeśli od ostatniego wywołania zmienił się którykolwiek plik
+    bool changed() {
+#ifdef __linux__
+        if (fd >= 0) {
+            bool any = false;
+            alignas(inotify_event) char events[4096];
+            for (;;) {
+                ssize_t length = read(fd, events, sizeof(events));
+                if (length <= 0)
+                    break;
+                any = true;
+            }
+            return any;
+        }
+#endif
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPoll < std::chrono::milliseconds(500))
+            return false;
+        lastPoll = now;
+        std::filesystem::file_time_type newest = newestWriteTime();
+        if (newest == lastWrite)
+            return false;
+        lastWrite = newest;
+        return true;
+    }
+
+private:
+    std::filesystem::file_time_type newestWriteTime() const {
+        std::filesystem::file_time_type newest{};
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            std::filesystem::file_time_type time = entry.last_write_time(error);
+            if (!error && time > newest)
+                newest = time;
+        }
+        return newest;
+    }
+
+    std::string directory;
+    int fd = -1;
+    std::filesystem::file_time_type lastWrite{};
+    std::chrono::steady_clock::time_point lastPoll{};
+};
+
+class AsyncShaderCompiler {
+public:
+    AsyncShaderCompiler() {
+        parallelCompile = GLEW_KHR_parallel_shader_compile;
+        if (parallelCompile) {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+            std::cout << "Shader compiler: GL_KHR_parallel_shader_compile" << std::endl;
+        }
+        else {
+            std::cout << "Shader compiler: shared-context worker thread" << std::endl;
+            worker = std::thread(&AsyncShaderCompiler::workerLoop, this);
+        }
+    }
+
+    ~AsyncShaderCompiler() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                quit = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+        deletePrograms(pendingPrograms);
+        deletePrograms(finishedPrograms);
+    }
+
+    AsyncShaderCompiler(const AsyncShaderCompiler&) = delete;
+    AsyncShaderCompiler& operator=(const AsyncShaderCompiler&) = delete;
+
+    // Zlecenie przebudowy paczki programów; jeśli poprzednia jeszcze trwa, nowa czeka i zastępuje starsze zlecenia
+    void submit(const std::vector<ProgramDesc>& batch) {
+        if (busy()) {
+            queued = batch;
+            hasQueued = true;
+            return;
+        }
+        start(batch);
+    }
+
+    bool busy() const {
+        return inFlight;
+    }
+
+    // Wywoływane raz na klatkę. Zwraca true, gdy cała paczka jest zlinkowana - wtedy `programs`
+    // zawiera nowe programy w kolejności z submit, a własność przechodzi na wywołującego.
+    bool poll(std::vector<GLuint>& programs) {
+        if (!inFlight)
+            return false;
+
+        bool ready = false;
+        bool ok = false;
+        if (parallelCompile) {
+            ready = true;
+            for (GLuint program : pendingPrograms) {
+                GLint complete = GL_FALSE;
+                glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+                if (complete != GL_TRUE) {
+                    ready = false;
+                    break;
+                }
+            }
+            if (ready) {
+                ok = checkPrograms(pendingPrograms);
+                finishedPrograms.swap(pendingPrograms);
+                pendingPrograms.clear();
+            }
+        }
+        else {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (hasResult) {
+                ready = true;
+                ok = resultOk;
+                hasResult = false;
+            }
+        }
+
+        if (!ready)
+            return false;
+
+        inFlight = false;
+        if (ok) {
+            programs = std::move(finishedPrograms);
+            finishedPrograms.clear();
+        }
+        else
+            std::cerr << "Shader reload failed, keeping previous programs" << std::endl;
+        deletePrograms(finishedPrograms);
+
+        if (hasQueued) {
+            hasQueued = false;
+            start(queued);
+        }
+        return ok;
+    }
+
+    // Blokująca wersja dla pierwszej kompilacji przy starcie
+    bool finish(std::vector<GLuint>& programs) {
+        while (inFlight) {
+            if (poll(programs))
+                return true;
+            if (inFlight)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return !programs.empty();
+    }
+
+private:
+    void start(const std::vector<ProgramDesc>& batch) {
+        inFlight = true;
+        if (parallelCompile) {
+            // Przy KHR_parallel_shader_compile kompilacja i linkowanie wracają od razu,
+            // a sterownik wykonuje je w tle aż do pierwszego zapytania o status
+            pendingPrograms = issuePrograms(batch);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = batch;
+            hasJob = true;
+        }
+        wake.notify_one();
+    }
+
+    static GLuint issueShader(GLenum type, const std::string& source) {
+        GLuint shader = glCreateShader(type);
+        const GLchar* text = source.c_str();
+        glShaderSource(shader, 1, &text, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    static std::vector<GLuint> issuePrograms(const std::vector<ProgramDesc>& batch) {
+        std::vector<GLuint> programs;
+        for (const ProgramDesc& desc : batch) {
+            GLuint vertexShader = issueShader(GL_VERTEX_SHADER, desc.vertexSource);
+            GLuint fragmentShader = issueShader(GL_FRAGMENT_SHADER, desc.fragmentSource);
+            GLuint program = glCreateProgram();
+            glAttachShader(program, vertexShader);
+            glAttachShader(program, fragmentShader);
+            for (size_t i = 0; i < desc.attribs.size(); ++i)
+                glBindAttribLocation(program, (GLuint)i, desc.attribs[i].c_str());
+            if (!desc.fragOutput.empty())
+                glBindFragDataLocation(program, 0, desc.fragOutput.c_str());
+            glLinkProgram(program);
+            // Shadery zostają przypięte do programu do czasu jego usunięcia, więc log kompilacji jest nadal dostępny
+            glDeleteShader(vertexShader);
+            glDeleteShader(fragmentShader);
+            programs.push_back(program);
+        }
+        return programs;
+    }
+
+    static bool checkPrograms(const std::vector<GLuint>& programs) {
+        bool ok = true;
+        for (GLuint program : programs) {
+            GLint status;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (status == GL_TRUE)
+                continue;
+            ok = false;
+
+            GLuint shaders[2];
+            GLsizei shaderCount = 0;
+            glGetAttachedShaders(program, 2, &shaderCount, shaders);
+            for (GLsizei i = 0; i < shaderCount; ++i) {
+                GLint compiled;
+                glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+                if (compiled == GL_TRUE)
+                    continue;
+                GLint logLength;
+                glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &logLength);
+                std::vector<char> log(logLength + 1);
+                glGetShaderInfoLog(shaders[i], logLength, NULL, log.data());
+                std::cerr << "Compilation error: " << log.data() << std::endl;
+            }
+
+            GLint logLength;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+            std::vector<char> log(logLength + 1);
+            glGetProgramInfoLog(program, logLength, NULL, log.data());
+            std::cerr << "Link error: " << log.data() << std::endl;
+        }
+        return ok;
+    }
+
+    static void deletePrograms(std::vector<GLuint>& programs) {
+        for (GLuint program : programs)
+            glDeleteProgram(program);
+        programs.clear();
+    }
+
+    void workerLoop() {
+        // sf::Context tworzony na tym wątku współdzieli obiekty z kontekstem okna
+        sf::Context context;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return quit || hasJob; });
+            if (quit)
+                break;
+            std::vector<ProgramDesc> batch;
+            batch.swap(job);
+            hasJob = false;
+            lock.unlock();
+
+            std::vector<GLuint> programs = issuePrograms(batch);
+            bool ok = checkPrograms(programs);
+            // Główny wątek może użyć programów dopiero, gdy komendy z tego kontekstu dotrą do GPU
+            glFinish();
+
+            lock.lock();
+            finishedPrograms.swap(programs);
+            resultOk = ok;
+            hasResult = true;
+        }
+    }
+
+    bool parallelCompile = false;
+    bool inFlight = false;
+    std::vector<GLuint> pendingPrograms;
+    std::vector<ProgramDesc> queued;
+    bool hasQueued = false;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<ProgramDesc> job;
+    bool hasJob = false;
+    bool quit = false;
+    std::vector<GLuint> finishedPrograms;
+    bool hasResult = false;
+    bool resultOk = false;
+};
@@ -0,0 +1,419 @@
+﻿#pragma once
+// Rasteryzer programowy do renderowania bez GPU i jako wzorzec do testów poprawności ścieżki GL.
+// Przyjmuje te same przeplatane strumienie wierzchołków co glDrawArrays(GL_TRIANGLES) w demach;
+// "shader" to struktura z vertex() (pozycja w przestrzeni obcinania + zmienne do interpolacji) i fragment().
+//
+// Etapy: (1) wierzchołki i obcinanie płaszczyzną bliską równolegle w paczkach trójkątów; każda paczka
+// przypisuje trójkąty do kafelków TILE x TILE, (2) kafelki rasteryzowane równolegle - każdy przechodzi
+// paczki po kolei, więc kolejność trójkątów w kafelku jest taka jak w strumieniu i wynik nie zależy od
+// liczby wątków. Listy trójkątów kafelków leżą w arenach wątków (common/frame_arena.h) zerowanych przy
+// każdym drawTriangles, więc po rozgrzaniu binning nie alokuje. Funkcje krawędzi liczone są dla 4 pikseli naraz (SSE2), z regułą top-left jak w GL.
+// Bufor głębokości float, test LESS, interpolacja z korekcją perspektywy.
+//
+// Układ współrzędnych jak w oknie GL: wiersz 0 na dole, piksele RGBA8 - to samo co zwraca glReadPixels.
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "thread_pool.h"
+#include "frame_arena.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFT_RASTER_SSE2 1
+#endif
+
+// Tekstura RGB8 próbkowana jak GL_LINEAR + GL_REPEAT (bez mipmap - przy pomniejszeniu wynik
+// różni się od GL_LINEAR_MIPMAP_LINEAR, co pokrywa tolerancja porównania)
+struct SoftTexture {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> rgb;
+
+    glm::vec3 texel(int x, int y) const {
+        x = ((x % width) + width) % width;
+        y = ((y % height) + height) % height;
+        const unsigned char* pixel = &rgb[(y * width + x) * 3];
+        return glm::vec3(pixel[0], pixel[1], pixel[2]) * (1.0f / 255.0f);
+    }
+
+    glm::vec3 sample(const glm::vec2& uv) const {
+        float x = uv.x * width - 0.5f;
+        float y = uv.y * height - 0.5f;
+        float x0 = std::floor(x);
+        float y0 = std::floor(y);
+        float fx = x - x0;
+        float fy = y - y0;
+        int ix = (int)x0;
+        int iy = (int)y0;
+        glm::vec3 bottom = glm::mix(texel(ix, iy), texel(ix + 1, iy), fx);
+        glm::vec3 top = glm::mix(texel(ix, iy + 1), texel(ix + 1, iy + 1), fx);
+        return glm::mix(bottom, top, fy);
+    }
+};
+
+class SoftFramebuffer {
+public:
+    SoftFramebuffer(int width, int height)
+        : width(width), height(height), color((size_t)width * height * 4), depth((size_t)width * height) {
+    }
+
+    void clear(const glm::vec3& clearColor) {
+        unsigned char rgba[4] = { toUnorm(clearColor.r), toUnorm(clearColor.g), toUnorm(clearColor.b), 255 };
+        for (size_t i = 0; i < depth.size(); ++i) {
+            std::copy(rgba, rgba + 4, &color[i * 4]);
+            depth[i] = 1.0f;
+        }
+    }
+
+    // Zaokrąglenie jak przy zapisie float do GL_RGBA8
+    static unsigned char toUnorm(float value) {
+        return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    int width;
+    int height;
+    std::vector<unsigned char> color;
+    std::vector<float> depth;
+};
+
+class SoftRasterizer {
+public:
+    static constexpr int TILE = 64;
+    static constexpr int MAX_VARYINGS = 8;
+    // Trójkąty na jedno zadanie etapu wierzchołków
+    static constexpr size_t BATCH = 1024;
+
+    static constexpr size_t ARENA_BLOCK_BYTES = 256 << 10;
+
+    explicit SoftRasterizer(ThreadPool& pool) : pool(pool), arenas(pool.size(), ARENA_BLOCK_BYTES) {
+    }
+
+    SoftRasterizer(const SoftRasterizer&) = delete;
+    SoftRasterizer& operator=(const SoftRasterizer&) = delete;
+
+    static const char* simdPath() {
+#if defined(SOFT_RASTER_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Shader: static constexpr int VARYINGS; glm::vec4 vertex(const float* in, float* varyings) const;
+    // glm::vec3 fragment(const float* varyings) const. Bez odrzucania tylnych ścian, jak w demach.
+    template <typename Shader>
+    void drawTriangles(SoftFramebuffer& target, const float* stream, size_t vertexCount, size_t stride, const Shader& shader) {
+        static_assert(Shader::VARYINGS <= MAX_VARYINGS, "too many varyings");
+        size_t triangleCount = vertexCount / 3;
+        size_t batchCount = (triangleCount + BATCH - 1) / BATCH;
+        tilesX = (target.width + TILE - 1) / TILE;
+        tilesY = (target.height + TILE - 1) / TILE;
+        size_t tileCount = (size_t)tilesX * tilesY;
+        if (batches.size() < batchCount)
+            batches.resize(batchCount);
+        arenas.reset();
+        for (size_t b = 0; b < batchCount; ++b) {
+            batches[b].triangles.clear();
+            batches[b].bins.assign(tileCount, Bin{ nullptr, nullptr });
+        }
+
+        pool.parallelFor(batchCount, 1, [&](size_t begin, size_t end, unsigned thread) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t first = b * BATCH;
+                size_t last = std::min(triangleCount, first + BATCH);
+                for (size_t t = first; t < last; ++t)
+                    processTriangle(batches[b], arenas[thread], target, stream + t * 3 * stride, stride, shader);
+            }
+        });
+
+        pool.parallelFor(tileCount, 1, [&](size_t begin, size_t end, unsigned) {
+            for (size_t tile = begin; tile < end; ++tile) {
+                int x0 = (int)(tile % tilesX) * TILE;
+                int y0 = (int)(tile / tilesX) * TILE;
+                int x1 = std::min(x0 + TILE, target.width) - 1;
+                int y1 = std::min(y0 + TILE, target.height) - 1;
+                for (size_t b = 0; b < batchCount; ++b) {
+                    const Batch& batch = batches[b];
+                    for (const BinBlock* block = batch.bins[tile].head; block; block = block->next) {
+                        for (uint32_t i = 0; i < block->count; ++i)
+                            rasterize<Shader>(batch.triangles[block->indices[i]], target, x0, y0, x1, y1, shader);
+                    }
+                }
+            }
+        });
+
+        for (size_t b = 0; b < batchCount; ++b)
+            drawnTriangles += batches[b].triangles.size();
+    }
+
+    // Trójkąty po obcięciu, które trafiły na ekran - od ostatniego resetStats
+    unsigned long long trianglesDrawn() const {
+        return drawnTriangles;
+    }
+
+    void resetStats() {
+        drawnTriangles = 0;
+    }
+
+private:
+    struct ClipVertex {
+        glm::vec4 position;
+        float varyings[MAX_VARYINGS];
+    };
+
+    // Trójkąt w pikselach okna, przeciwnie do ruchu wskazówek zegara; zmienne pomnożone przez 1/w
+    struct ScreenTriangle {
+        float x[3], y[3];
+        float z[3];
+        float invW[3];
+        float varyings[3][MAX_VARYINGS];
+        float invArea;
+        int minX, minY, maxX, maxY;
+    };
+
+    // Indeksy trójkątów kafelka w blokach z areny wątku, w kolejności dopisywania
+    struct BinBlock {
+        static constexpr uint32_t CAPACITY = 29;
+        BinBlock* next;
+        uint32_t count;
+        uint32_t indices[CAPACITY];
+    };
+
+    struct Bin {
+        BinBlock* head;
+        BinBlock* tail;
+    };
+
+    struct Batch {
+        std::vector<ScreenTriangle> triangles;
+        std::vector<Bin> bins;
+    };
+
+    template <typename Shader>
+    void processTriangle(Batch& batch, FrameArena& arena, const SoftFramebuffer& target, const float* vertices, size_t stride, const Shader& shader) {
+        ClipVertex input[3];
+        for (int i = 0; i < 3; ++i)
+            input[i].position = shader.vertex(vertices + i * stride, input[i].varyings);
+
+        // Cały trójkąt poza jedną z płaszczyzn bryły widzenia
+        for (int axis = 0; axis < 3; ++axis) {
+            bool allBelow = true;
+            bool allAbove = true;
+            for (int i = 0; i < 3; ++i) {
+                allBelow = allBelow && input[i].position[axis] < -input[i].position.w;
+                allAbove = allAbove && input[i].position[axis] > input[i].position.w;
+            }
+            if (allBelow || allAbove)
+                return;
+        }
+
+        // Obcinanie płaszczyzną bliską (z >= -w): wielokąt o co najwyżej 4 wierzchołkach, czyli 1-2 trójkąty.
+        // Dalej w > 0. Boczne płaszczyzny nie są obcinane: setupTriangle przycina prostokąt otaczający
+        // do ekranu jeszcze na floatach, więc wierzchołki daleko poza ekranem nie przepełniają int.
+        // Płaszczyzna daleka zostaje testowi głębokości.
+        ClipVertex polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i) {
+            const ClipVertex& a = input[i];
+            const ClipVertex& b = input[(i + 1) % 3];
+            float da = a.position.z + a.position.w;
+            float db = b.position.z + b.position.w;
+            if (da >= 0.0f)
+                polygon[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                float t = da / (da - db);
+                ClipVertex& v = polygon[count++];
+                v.position = glm::mix(a.position, b.position, t);
+                for (int k = 0; k < Shader::VARYINGS; ++k)
+                    v.varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+            }
+        }
+        for (int i = 1; i + 1 < count; ++i)
+            setupTriangle<Shader>(batch, arena, target, polygon[0], polygon[i], polygon[i + 1]);
+    }
+
+    template <typename Shader>
+    void setupTriangle(Batch& batch, FrameArena& arena, const SoftFramebuffer& target, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c) {
+        ScreenTriangle tri;
+        const ClipVertex* source[3] = { &a, &b, &c };
+        for (int i = 0; i < 3; ++i) {
+            const glm::vec4& p = source[i]->position;
+            float invW = 1.0f / p.w;
+            tri.x[i] = (p.x * invW * 0.5f + 0.5f) * target.width;
+            tri.y[i] = (p.y * invW * 0.5f + 0.5f) * target.height;
+            tri.z[i] = p.z * invW * 0.5f + 0.5f;
+            tri.invW[i] = invW;
+            for (int k = 0; k < Shader::VARYINGS; ++k)
+                tri.varyings[i][k] = source[i]->varyings[k] * invW;
+        }
+
+        float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+        if (area == 0.0f || !std::isfinite(area))
+            return;
+        if (area < 0.0f) {
+            swapVertices<Shader>(tri, 1, 2);
+            area = -area;
+        }
+        tri.invArea = 1.0f / area;
+
+        // Piksele, których środek (i + 0.5) może leżeć w trójkącie
+        float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+        float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+        float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+        float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+        // Przycięcie do [0, width] x [0, height] przed rzutowaniem na int - po podzieleniu przez w
+        // współrzędne mogą być dowolnie duże
+        minX = std::min(std::max(minX, 0.0f), (float)target.width);
+        maxX = std::min(std::max(maxX, 0.0f), (float)target.width);
+        minY = std::min(std::max(minY, 0.0f), (float)target.height);
+        maxY = std::min(std::max(maxY, 0.0f), (float)target.height);
+        tri.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+        tri.maxX = std::min(target.width - 1, (int)std::floor(maxX - 0.5f));
+        tri.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+        tri.maxY = std::min(target.height - 1, (int)std::floor(maxY - 0.5f));
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        uint32_t index = (uint32_t)batch.triangles.size();
+        batch.triangles.push_back(tri);
+        for (int ty = tri.minY / TILE; ty <= tri.maxY / TILE; ++ty) {
+            for (int tx = tri.minX / TILE; tx <= tri.maxX / TILE; ++tx) {
+                Bin& bin = batch.bins[(size_t)ty * tilesX + tx];
+                if (!bin.tail || bin.tail->count == BinBlock::CAPACITY) {
+                    BinBlock* block = (BinBlock*)arena.allocate(sizeof(BinBlock), alignof(BinBlock));
+                    block->next = nullptr;
+                    block->count = 0;
+                    (bin.tail ? bin.tail->next : bin.head) = block;
+                    bin.tail = block;
+                }
+                bin.tail->indices[bin.tail->count++] = index;
+            }
+        }
+    }
+
+    template <typename Shader>
+    static void swapVertices(ScreenTriangle& tri, int i, int j) {
+        std::swap(tri.x[i], tri.x[j]);
+        std::swap(tri.y[i], tri.y[j]);
+        std::swap(tri.z[i], tri.z[j]);
+        std::swap(tri.invW[i], tri.invW[j]);
+        for (int k = 0; k < Shader::VARYINGS; ++k)
+            std::swap(tri.varyings[i][k], tri.varyings[j][k]);
+    }
+
+    // Krawędź a -> b: E(p) = A * p.x + B * p.y + C, dodatnia po lewej stronie (wnętrze trójkąta CCW)
+    struct Edge {
+        float a, b, c;
+        bool topLeft;
+    };
+
+    static Edge makeEdge(float ax, float ay, float bx, float by) {
+        Edge edge;
+        edge.a = ay - by;
+        edge.b = bx - ax;
+        edge.c = -(edge.a * ax + edge.b * ay);
+        // Oś y w górę: krawędź górna biegnie w lewo, lewa - w dół
+        edge.topLeft = (edge.a == 0.0f && edge.b < 0.0f) || edge.a > 0.0f;
+        return edge;
+    }
+
+    template <typename Shader>
+    void rasterize(const ScreenTriangle& tri, SoftFramebuffer& target, int tileX0, int tileY0, int tileX1, int tileY1, const Shader& shader) const {
+        int x0 = std::max(tri.minX, tileX0);
+        int x1 = std::min(tri.maxX, tileX1);
+        int y0 = std::max(tri.minY, tileY0);
+        int y1 = std::min(tri.maxY, tileY1);
+        if (x0 > x1 || y0 > y1)
+            return;
+
+        // w0 waży wierzchołek 0 itd.
+        Edge edges[3] = {
+            makeEdge(tri.x[1], tri.y[1], tri.x[2], tri.y[2]),
+            makeEdge(tri.x[2], tri.y[2], tri.x[0], tri.y[0]),
+            makeEdge(tri.x[0], tri.y[0], tri.x[1], tri.y[1]),
+        };
+
+        for (int y = y0; y <= y1; ++y) {
+            float py = y + 0.5f;
+            int x = x0;
+#if defined(SOFT_RASTER_SSE2)
+            const __m128 offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+            const __m128 zero = _mm_setzero_ps();
+            for (; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), offsets);
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                __m128 weights[3];
+                for (int e = 0; e < 3; ++e) {
+                    __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[e].a), px), _mm_set1_ps(edges[e].b * py + edges[e].c));
+                    __m128 covered = _mm_cmpgt_ps(value, zero);
+                    if (edges[e].topLeft)
+                        covered = _mm_or_ps(covered, _mm_cmpeq_ps(value, zero));
+                    inside = _mm_and_ps(inside, covered);
+                    weights[e] = value;
+                }
+                int mask = _mm_movemask_ps(inside);
+                if (x1 - x < 3)
+                    mask &= (1 << (x1 - x + 1)) - 1;
+                if (!mask)
+                    continue;
+                float w[3][4];
+                for (int e = 0; e < 3; ++e)
+                    _mm_storeu_ps(w[e], weights[e]);
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (mask & (1 << lane))
+                        shadePixel(tri, target, x + lane, y, w[0][lane], w[1][lane], w[2][lane], shader);
+                }
+            }
+#else
+            for (; x <= x1; ++x) {
+                float px = x + 0.5f;
+                float w[3];
+                bool inside = true;
+                for (int e = 0; e < 3; ++e) {
+                    // Ta sama kolejność działań co w wersji SSE2 - identyczny wynik
+                    w[e] = edges[e].a * px + (edges[e].b * py + edges[e].c);
+                    inside = inside && (w[e] > 0.0f || (w[e] == 0.0f && edges[e].topLeft));
+                }
+                if (inside)
+                    shadePixel(tri, target, x, y, w[0], w[1], w[2], shader);
+            }
+#endif
+        }
+    }
+
+    template <typename Shader>
+    static void shadePixel(const ScreenTriangle& tri, SoftFramebuffer& target, int x, int y, float w0, float w1, float w2, const Shader& shader) {
+        float l0 = w0 * tri.invArea;
+        float l1 = w1 * tri.invArea;
+        float l2 = w2 * tri.invArea;
+        // Głębokość w przestrzeni ekranu jest liniowa - bez korekcji perspektywy
+        float z = l0 * tri.z[0] + l1 * tri.z[1] + l2 * tri.z[2];
+        size_t index = (size_t)y * target.width + x;
+        if (z < 0.0f || z > 1.0f || !(z < target.depth[index]))
+            return;
+
+        float invW = l0 * tri.invW[0] + l1 * tri.invW[1] + l2 * tri.invW[2];
+        float scale = 1.0f / invW;
+        float varyings[MAX_VARYINGS];
+        for (int k = 0; k < Shader::VARYINGS; ++k)
+            varyings[k] = (l0 * tri.varyings[0][k] + l1 * tri.varyings[1][k] + l2 * tri.varyings[2][k]) * scale;
+
+        glm::vec3 color = shader.fragment(varyings);
+        target.depth[index] = z;
+        unsigned char* pixel = &target.color[index * 4];
+        pixel[0] = SoftFramebuffer::toUnorm(color.r);
+        pixel[1] = SoftFramebuffer::toUnorm(color.g);
+        pixel[2] = SoftFramebuffer::toUnorm(color.b);
+        pixel[3] = 255;
+    }
+
+    ThreadPool& pool;
+    FrameArenas arenas;
+    std::vector<Batch> batches;
+    int tilesX = 0;
+    int tilesY = 0;
+    unsigned long long drawnTriangles = 0;
+};
@@ -0,0 +1,245 @@
+﻿#pragma once
+// Prosty tekst na ekranie: czcionka 5x7 w teksturze R8 i bufor wierzchołków o stałej pojemności.
+// Wierzchołki przebudowywane są tylko w setText, rysowanie to jedno wywołanie glDrawArrays (plus cień).
+// draw() nie odpytuje sterownika o stan (glGet* zatrzymuje potok): ustawia swój i zostawia znany stan
+// domyślny - test głębokości włączony, blend wyłączony, jednostka 0 aktywna, program, VAO i tekstura 2D
+// odwiązane. Wywołujący wiąże swój program ponownie przed następnym rysowaniem, a przy GlStateCache wywołuje
+// invalidateBindings().
+// Obsługiwane są znaki ' '..'_' (małe litery rysowane jak wielkie) oraz '\x7f' jako pełny blok.
+#include <GL/glew.h>
+#include <iostream>
+#include <vector>
+#include <cstddef>
+
+class TextOverlay {
+public:
+    static constexpr int MAX_CHARS = 2048;
+    static constexpr int GLYPH_WIDTH = 5;
+    static constexpr int GLYPH_HEIGHT = 7;
+    // Komórka w atlasie i na ekranie: glif plus odstęp
+    static constexpr int CELL_WIDTH = 6;
+    static constexpr int CELL_HEIGHT = 9;
+    static constexpr int GLYPH_COUNT = 65;
+
+    TextOverlay(int screenWidth, int screenHeight, float scale = 2.0f) : scale(scale) {
+        vertices.resize(MAX_CHARS * 6 * 4);
+        createAtlas();
+        createProgram();
+        glUseProgram(program);
+        glUniform2f(glGetUniformLocation(program, "screenSize"), (float)screenWidth, (float)screenHeight);
+        glUniform1i(glGetUniformLocation(program, "glyphs"), 0);
+        uniColor = glGetUniformLocation(program, "textColor");
+        uniOffset = glGetUniformLocation(program, "offset");
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+
+    ~TextOverlay() {
+        glDeleteProgram(program);
+        glDeleteTextures(1, &atlas);
+        glDeleteBuffers(1, &vbo);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    TextOverlay(const TextOverlay&) = delete;
+    TextOverlay& operator=(const TextOverlay&) = delete;
+
+    // Układa tekst od lewego górnego rogu (x, y w pikselach) i wysyła go do VBO.
+    // Zwraca liczbę wysłanych bajtów, żeby można ją było doliczyć do statystyk.
+    size_t setText(const char* text, float x, float y) {
+        float* out = vertices.data();
+        int count = 0;
+        float penX = x;
+        float penY = y;
+        for (const char* c = text; *c && count < MAX_CHARS; ++c) {
+            if (*c == '\n') {
+                penX = x;
+                penY += CELL_HEIGHT * scale;
+                continue;
+            }
+            int glyph = glyphIndex(*c);
+            if (glyph > 0) {
+                float x0 = penX, y0 = penY;
+                float x1 = penX + CELL_WIDTH * scale, y1 = penY + CELL_HEIGHT * scale;
+                float u0 = (float)(glyph * CELL_WIDTH) / (GLYPH_COUNT * CELL_WIDTH);
+                float u1 = (float)((glyph + 1) * CELL_WIDTH) / (GLYPH_COUNT * CELL_WIDTH);
+                const float quad[6][4] = {
+                    { x0, y0, u0, 0.0f }, { x1, y0, u1, 0.0f }, { x1, y1, u1, 1.0f },
+                    { x0, y0, u0, 0.0f }, { x1, y1, u1, 1.0f }, { x0, y1, u0, 1.0f },
+                };
+                for (int v = 0; v < 6; ++v)
+                    for (int i = 0; i < 4; ++i)
+                        *out++ = quad[v][i];
+                ++count;
+            }
+            penX += CELL_WIDTH * scale;
+        }
+        vertexCount = count * 6;
+        size_t bytes = (size_t)vertexCount * 4 * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return bytes;
+    }
+
+    // Rysuje nad sceną i zostawia program, VAO i teksturę 2D odwiązane (nic nie przywraca); kod korzystający
+    // z GlStateCache musi potem wywołać invalidateBindings()
+    void draw() const {
+        if (vertexCount == 0)
+            return;
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        // Cień przesunięty o piksel, żeby tekst był czytelny na jasnym tle
+        glUniform4f(uniColor, 0.0f, 0.0f, 0.0f, 0.8f);
+        glUniform2f(uniOffset, scale, scale);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        glUniform4f(uniColor, 1.0f, 0.9f, 0.3f, 1.0f);
+        glUniform2f(uniOffset, 0.0f, 0.0f);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+private:
+    // Indeks 0 to spacja (nic nie rysujemy), 1..63 to '!'..'_', 64 to pełny blok
+    static int glyphIndex(char c) {
+        if (c == '\x7f')
+            return 64;
+        if (c >= 'a' && c <= 'z')
+            c = c - 'a' + 'A';
+        if (c < ' ' || c > '_')
+            c = '?';
+        return c - ' ';
+    }
+
+    // Kolumny glifów 5x7, najmłodszy bit to górny wiersz
+    void createAtlas() {
+        static const unsigned char font[GLYPH_COUNT][GLYPH_WIDTH] = {
+            { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+            { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+            { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 },
+            { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+            { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+            { 0x20, 0x10, 0x08, 0x04, 0x02 },
+            { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 },
+            { 0x21, 0x41, 0x45, 0x4B, 0x31 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },
+            { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 }, { 0x36, 0x49, 0x49, 0x49, 0x36 },
+            { 0x06, 0x49, 0x49, 0x29, 0x1E },
+            { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 },
+            { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+            { 0x32, 0x49, 0x79, 0x41, 0x3E },
+            { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+            { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x01, 0x01 },
+            { 0x3E, 0x41, 0x41, 0x51, 0x32 }, { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+            { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 }, { 0x7F, 0x40, 0x40, 0x40, 0x40 },
+            { 0x7F, 0x02, 0x04, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+            { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 },
+            { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+            { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+            { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 },
+            { 0x00, 0x7F, 0x41, 0x41, 0x00 }, { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 },
+            { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+            { 0x7F, 0x7F, 0x7F, 0x7F, 0x7F },
+        };
+
+        const int width = GLYPH_COUNT * CELL_WIDTH;
+        std::vector<unsigned char> pixels(width * CELL_HEIGHT, 0);
+        for (int glyph = 0; glyph < GLYPH_COUNT; ++glyph) {
+            for (int column = 0; column < GLYPH_WIDTH; ++column) {
+                for (int row = 0; row < GLYPH_HEIGHT; ++row) {
+                    if (font[glyph][column] & (1 << row))
+                        pixels[(row + 1) * width + glyph * CELL_WIDTH + column] = 255;
+                }
+            }
+        }
+
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void createProgram() {
+        const GLchar* vertexSource = R"glsl(
+#version 150 core
+in vec2 position;
+in vec2 texCoord;
+out vec2 TexCoord;
+uniform vec2 screenSize;
+uniform vec2 offset;
+void main() {
+    vec2 ndc = (position + offset) / screenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    TexCoord = texCoord;
+}
+)glsl";
+        const GLchar* fragmentSource = R"glsl(
+#version 150 core
+in vec2 TexCoord;
+out vec4 outColor;
+uniform sampler2D glyphs;
+uniform vec4 textColor;
+void main() {
+    outColor = vec4(textColor.rgb, textColor.a * texture(glyphs, TexCoord).r);
+}
+)glsl";
+        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexShader, 1, &vertexSource, NULL);
+        glCompileShader(vertexShader);
+        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+        glCompileShader(fragmentShader);
+
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, 0, "position");
+        glBindAttribLocation(program, 1, "texCoord");
+        glBindFragDataLocation(program, 0, "outColor");
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        GLint status;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE) {
+            char log[512];
+            glGetProgramInfoLog(program, sizeof(log), NULL, log);
+            std::cerr << "Text overlay program failed to link: " << log << std::endl;
+        }
+    }
+
+    float scale;
+    std::vector<float> vertices;
+    int vertexCount = 0;
+    GLuint program = 0;
+    GLint uniColor = -1;
+    GLint uniOffset = -1;
+    GLuint atlas = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+};
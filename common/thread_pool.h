@@ -0,0 +1,121 @@
+﻿#pragma once
+// Stała pula wątków do dzielenia pracy w obrębie klatki. Wątki czekają uśpione między wywołaniami
+// parallelFor, a wątek wywołujący pracuje razem z nimi, więc pula z jednym wątkiem działa szeregowo.
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency()) {
+        if (threadCount == 0)
+            threadCount = 1;
+        for (unsigned i = 1; i < threadCount; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Liczba wątków razem z wywołującym - tyle koszyków potrzeba na dane per wątek
+    unsigned size() const {
+        return (unsigned)workers.size() + 1;
+    }
+
+    // Wywołuje task(begin, end, threadIndex) dla kolejnych kawałków [0, count) o rozmiarze grain.
+    // Kawałki rozdawane są dynamicznie, więc nierówne koszty się wyrównują. Bez alokacji.
+    template <typename Task>
+    void parallelFor(size_t count, size_t grain, Task&& task) {
+        using TaskType = typename std::remove_reference<Task>::type;
+        run(count, grain, [](void* context, size_t begin, size_t end, unsigned thread) {
+            (*static_cast<TaskType*>(context))(begin, end, thread);
+        }, (void*)&task);
+    }
+
+private:
+    typedef void (*Invoke)(void*, size_t, size_t, unsigned);
+
+    void run(size_t count, size_t grain, Invoke invoke, void* context) {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        if (workers.empty() || count <= grain) {
+            invoke(context, 0, count, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobInvoke = invoke;
+            jobContext = context;
+            jobCount = count;
+            jobGrain = grain;
+            next.store(0, std::memory_order_relaxed);
+            busyWorkers = (unsigned)workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        work(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busyWorkers == 0; });
+    }
+
+    void work(unsigned thread) {
+        for (;;) {
+            size_t begin = next.fetch_add(jobGrain, std::memory_order_relaxed);
+            if (begin >= jobCount)
+                break;
+            jobInvoke(jobContext, begin, std::min(begin + jobGrain, jobCount), thread);
+        }
+    }
+
+    void workerLoop(unsigned thread) {
+        unsigned long long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+            }
+            work(thread);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busyWorkers == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool quit = false;
+    unsigned long long generation = 0;
+    unsigned busyWorkers = 0;
+
+    Invoke jobInvoke = nullptr;
+    void* jobContext = nullptr;
+    size_t jobCount = 0;
+    size_t jobGrain = 1;
+    std::atomic<size_t> next{ 0 };
+};
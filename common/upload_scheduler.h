@@ -0,0 +1,298 @@
+﻿#pragma once
+// Wysyłanie buforów i tekstur do GPU rozłożone na klatki. Zadanie od razu dostaje pamięć docelową
+// (glBufferData / glTexImage2D bez danych), a zawartość kopiowana jest w update() kawałkami przez pulę
+// buforów pośrednich: memcpy do zmapowanego bufora, potem glCopyBufferSubData albo glTexSubImage2D z PBO.
+// Na klatkę wysyłanych jest najwyżej frameBudget bajtów; bufor pośredni wraca do puli, gdy jego fence
+// zostanie zasygnalizowany, więc zapis do niego nigdy nie czeka na GPU. Zadania wykonywane są po kolei,
+// callback done wywoływany jest po ostatniej kopii. Mipmapy liczone są na CPU przy kolejkowaniu (filtr 2x2)
+// i wysyłane jak zwykłe dane - glGenerateMipmap potrafi w jednej klatce zająć więcej niż całe wysyłanie.
+#include <GL/glew.h>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+struct UploadStats {
+    size_t frameBytes = 0;
+    size_t maxFrameBytes = 0;
+    // Czas CPU update() - o tyle wysyłanie wydłuża klatkę
+    double frameMilliseconds = 0.0;
+    double maxFrameMilliseconds = 0.0;
+    uint64_t totalBytes = 0;
+    size_t pendingBytes = 0;
+    size_t pendingJobs = 0;
+    // Klatki, w których budżet został, ale wszystkie bufory pośrednie czekały na GPU
+    uint64_t stagingStalls = 0;
+};
+
+class UploadScheduler {
+public:
+    static constexpr size_t STAGING_BYTES = 1 << 20;
+    static constexpr int STAGING_SLOTS = 8;
+
+    explicit UploadScheduler(size_t frameBudget = 4 << 20) : frameBudget(frameBudget), slots(STAGING_SLOTS) {
+        for (Slot& slot : slots) {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_COPY_READ_BUFFER, slot.buffer);
+            glBufferData(GL_COPY_READ_BUFFER, STAGING_BYTES, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    ~UploadScheduler() {
+        for (Slot& slot : slots) {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    UploadScheduler(const UploadScheduler&) = delete;
+    UploadScheduler& operator=(const UploadScheduler&) = delete;
+
+    void queueBuffer(GLuint buffer, const void* data, size_t size, GLenum usage, std::function<void()> done = nullptr) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, usage);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        Job job;
+        job.kind = Kind::Buffer;
+        job.target = buffer;
+        job.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+        job.done = std::move(done);
+        push(std::move(job));
+    }
+
+    // Piksele w wierszach bez wyrównania (channels bajtów na piksel), jak zwraca je stb_image
+    void queueTexture(GLuint texture, int width, int height, GLenum internalFormat, GLenum format, int channels,
+        const unsigned char* pixels, bool mipmaps, std::function<void()> done = nullptr) {
+        Job job;
+        job.kind = Kind::Texture;
+        job.target = texture;
+        job.format = format;
+        job.data.assign(pixels, pixels + (size_t)width * height * channels);
+        job.levels.push_back(Level{ width, height, (size_t)width * channels, 0 });
+        while (mipmaps && (job.levels.back().width > 1 || job.levels.back().height > 1))
+            addMipLevel(job, channels);
+
+        GLint bound = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (size_t level = 0; level < job.levels.size(); ++level)
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, job.levels[level].width, job.levels[level].height, 0, format, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)job.levels.size() - 1);
+        glBindTexture(GL_TEXTURE_2D, bound);
+        job.done = std::move(done);
+        push(std::move(job));
+    }
+
+    // Porzuca niewysłaną resztę zadań bufora, np. przed glDeleteBuffers; callback nie zostanie wywołany
+    void cancelBuffer(GLuint buffer) {
+        for (auto job = jobs.begin(); job != jobs.end();) {
+            if (job->kind == Kind::Buffer && job->target == buffer) {
+                stats.pendingBytes -= job->data.size() - job->offset;
+                job = jobs.erase(job);
+            }
+            else {
+                ++job;
+            }
+        }
+        stats.pendingJobs = jobs.size();
+    }
+
+    // Raz na klatkę, przed rysowaniem
+    void update() {
+        auto start = std::chrono::steady_clock::now();
+        for (Slot& slot : slots) {
+            if (!slot.fence)
+                continue;
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+            }
+        }
+
+        size_t sent = 0;
+        GLint boundTexture = -1;
+        while (!jobs.empty() && sent < frameBudget) {
+            Slot* slot = freeSlot();
+            if (!slot) {
+                ++stats.stagingStalls;
+                break;
+            }
+            Job& job = jobs.front();
+            size_t limit = std::min(STAGING_BYTES, frameBudget - sent);
+            size_t bytes;
+            if (job.kind == Kind::Buffer) {
+                bytes = copyBuffer(job, *slot, limit);
+            }
+            else {
+                if (boundTexture < 0)
+                    glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+                bytes = copyTexture(job, *slot, limit);
+            }
+            slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            sent += bytes;
+            stats.pendingBytes -= bytes;
+
+            if (job.offset == job.data.size()) {
+                std::function<void()> done = std::move(job.done);
+                jobs.pop_front();
+                if (done)
+                    done();
+            }
+        }
+        if (boundTexture >= 0)
+            glBindTexture(GL_TEXTURE_2D, boundTexture);
+
+        stats.frameBytes = sent;
+        stats.maxFrameBytes = std::max(stats.maxFrameBytes, sent);
+        stats.totalBytes += sent;
+        stats.pendingJobs = jobs.size();
+        stats.frameMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats.maxFrameMilliseconds = std::max(stats.maxFrameMilliseconds, stats.frameMilliseconds);
+    }
+
+    bool idle() const {
+        return jobs.empty();
+    }
+
+    const UploadStats& statistics() const {
+        return stats;
+    }
+
+private:
+    enum class Kind { Buffer, Texture };
+
+    // Poziom mipmapy tekstury; poziomy leżą w Job::data kolejno
+    struct Level {
+        int width;
+        int height;
+        size_t rowBytes;
+        size_t offset;
+    };
+
+    struct Job {
+        Kind kind;
+        GLuint target;
+        std::vector<unsigned char> data;
+        size_t offset = 0;
+        GLenum format = GL_RGB;
+        std::vector<Level> levels;
+        std::function<void()> done;
+    };
+
+    // Kawałek poziomu w jednym glTexSubImage2D
+    struct TexturePiece {
+        size_t level;
+        int firstRow;
+        int rows;
+        size_t stagingOffset;
+    };
+
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+    };
+
+    // Średnia 2x2 z poprzedniego poziomu; przy nieparzystym wymiarze ostatni wiersz/kolumna brane podwójnie
+    static void addMipLevel(Job& job, int channels) {
+        const Level source = job.levels.back();
+        Level level = { std::max(1, source.width / 2), std::max(1, source.height / 2), 0, job.data.size() };
+        level.rowBytes = (size_t)level.width * channels;
+        job.data.resize(level.offset + level.rowBytes * level.height);
+        const unsigned char* in = job.data.data() + source.offset;
+        unsigned char* out = job.data.data() + level.offset;
+        for (int y = 0; y < level.height; ++y) {
+            const unsigned char* row0 = in + std::min(y * 2, source.height - 1) * source.rowBytes;
+            const unsigned char* row1 = in + std::min(y * 2 + 1, source.height - 1) * source.rowBytes;
+            for (int x = 0; x < level.width; ++x) {
+                int x0 = std::min(x * 2, source.width - 1) * channels;
+                int x1 = std::min(x * 2 + 1, source.width - 1) * channels;
+                for (int c = 0; c < channels; ++c)
+                    out[y * level.rowBytes + x * channels + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+        job.levels.push_back(level);
+    }
+
+    void push(Job&& job) {
+        stats.pendingBytes += job.data.size();
+        jobs.push_back(std::move(job));
+        stats.pendingJobs = jobs.size();
+    }
+
+    Slot* freeSlot() {
+        for (Slot& slot : slots) {
+            if (!slot.fence)
+                return &slot;
+        }
+        return nullptr;
+    }
+
+    // Bufor pośredni jest wolny (fence zasygnalizowany), więc mapowanie nie musi się synchronizować
+    static void fillStaging(Slot& slot, GLenum target, const unsigned char* source, size_t bytes) {
+        glBindBuffer(target, slot.buffer);
+        void* mapped = glMapBufferRange(target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        std::memcpy(mapped, source, bytes);
+        glUnmapBuffer(target);
+    }
+
+    size_t copyBuffer(Job& job, Slot& slot, size_t limit) {
+        size_t bytes = std::min(limit, job.data.size() - job.offset);
+        fillStaging(slot, GL_COPY_READ_BUFFER, job.data.data() + job.offset, bytes);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, job.target);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, job.offset, bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        job.offset += bytes;
+        return bytes;
+    }
+
+    // Całe wiersze, także z kilku kolejnych poziomów naraz; co najmniej jeden wiersz, nawet ponad budżet
+    size_t copyTexture(Job& job, Slot& slot, size_t limit) {
+        pieces.clear();
+        size_t bytes = 0;
+        size_t level = 0;
+        while (job.levels[level].offset + job.levels[level].rowBytes * job.levels[level].height <= job.offset)
+            ++level;
+        for (; level < job.levels.size(); ++level) {
+            const Level& current = job.levels[level];
+            int firstRow = (int)((job.offset + bytes - current.offset) / current.rowBytes);
+            int rows = std::min(current.height - firstRow, (int)((std::min(limit, STAGING_BYTES) - bytes) / current.rowBytes));
+            if (pieces.empty())
+                rows = std::max(rows, 1);
+            if (rows <= 0)
+                break;
+            pieces.push_back(TexturePiece{ level, firstRow, rows, bytes });
+            bytes += rows * current.rowBytes;
+            if (firstRow + rows < current.height)
+                break;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, job.target);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        const unsigned char* source = nullptr;
+        if (bytes <= STAGING_BYTES)
+            fillStaging(slot, GL_PIXEL_UNPACK_BUFFER, job.data.data() + job.offset, bytes);
+        else
+            source = job.data.data() + job.offset;  // Wiersz większy niż bufor pośredni - prosto z pamięci klienta
+        for (const TexturePiece& piece : pieces) {
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)piece.level, 0, piece.firstRow, job.levels[piece.level].width, piece.rows,
+                job.format, GL_UNSIGNED_BYTE, source ? source + piece.stagingOffset : (const void*)piece.stagingOffset);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        job.offset += bytes;
+        return bytes;
+    }
+
+    size_t frameBudget;
+    std::vector<Slot> slots;
+    std::deque<Job> jobs;
+    std::vector<TexturePiece> pieces;
+    UploadStats stats;
+};
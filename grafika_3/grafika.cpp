@@ -3,9 +3,24 @@
 #include <SFML/OpenGL.hpp>
 #include <SFML/System/Time.hpp>
 #include <iostream>
+#include <thread>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "../common/profiler.h"
+#include "../common/frame_stats.h"
+#include "../common/text_overlay.h"
+#include "../common/input_state.h"
+#include "../common/game_loop.h"
+#include "../common/frame_pipeline.h"
+#include "../common/gpu_resources.h"
+// Licznik alokacji podmienia malloc - tylko w buildzie pomiarowym z -DCOUNT_ALLOCATIONS
+#ifdef COUNT_ALLOCATIONS
+#define ALLOC_COUNTER_IMPLEMENTATION
+#else
+#define ALLOC_COUNTER_DISABLED
+#endif
+#include "../common/alloc_counter.h"
 
 const GLchar* vertexSource = R"glsl(
 #version 150 core
@@ -76,20 +91,34 @@ void ustawKameraMysz(sf::Window& window, double xpos, double ypos, float& yaw, f
     cameraFront = glm::normalize(front);
 }
 
-void ustawKameraKlawisze(glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float cameraSpeed) {
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::W))
+void ustawKameraKlawisze(const InputState& input, glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float cameraSpeed) {
+    if (input.isKeyPressed(sf::Keyboard::W))
         cameraPos += cameraSpeed * cameraFront;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::S))
+    if (input.isKeyPressed(sf::Keyboard::S))
         cameraPos -= cameraSpeed * cameraFront;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::A))
+    if (input.isKeyPressed(sf::Keyboard::A))
         cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))
+    if (input.isKeyPressed(sf::Keyboard::D))
         cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 }
 
-int main() {
+// Wszystko, czego rysowanie potrzebuje z symulacji; przy --render-thread kopiowane przez kolejkę
+struct FramePacket {
+    glm::mat4 view = glm::mat4(1.0f);
+    double inputTime = 0.0;
+    float inputMs = 0.0f;
+    bool captureTrace = false;
+    bool toggleCsv = false;
+    bool quit = false;
+};
+
+// Symulacja wyprzedza rysowanie najwyżej o jedną klatkę - mniejsze opóźnienie niż głębsza kolejka
+const size_t FRAME_QUEUE_DEPTH = 1;
+
+int main(int argc, char** argv) {
     sf::Window window(sf::VideoMode(800, 600), "OpenGL FPS Camera", sf::Style::Close);
-    window.setFramerateLimit(20);
+    // Synchronizacja z odświeżaniem zamiast setFramerateLimit (usypianie); --uncapped bez limitu
+    window.setVerticalSyncEnabled(parsePresentMode(argc, argv) == PresentMode::VSync);
     window.setMouseCursorGrabbed(true);  // Przechwycenie kursora
     window.setMouseCursorVisible(false); // Ukrycie kursora
 
@@ -141,13 +170,15 @@ int main() {
         -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f
     };
 
-    GLuint vbo, vao;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+    // Obiekty GL za uchwytami rejestru - zwalniane na końcu, a pominięte wypisywane jako wycieki
+    GpuResources resources;
+    VertexArrayHandle vao = resources.createVertexArray("cube vao");
+    BufferHandle vbo = resources.createBuffer("cube vbo");
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindVertexArray(resources.get(vao));
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(vbo));
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    resources.setBytes(vbo, sizeof(vertices));
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
     glEnableVertexAttribArray(0);
@@ -169,6 +200,12 @@ int main() {
     glAttachShader(shaderProgram, fragmentShader);
     glBindFragDataLocation(shaderProgram, 0, "outColor");
     glLinkProgram(shaderProgram);
+    // Po linkowaniu shadery nie są już potrzebne
+    glDetachShader(shaderProgram, vertexShader);
+    glDetachShader(shaderProgram, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    ProgramHandle program = resources.adoptProgram(shaderProgram, "cube program");
     glUseProgram(shaderProgram);
 
     GLint uniModel = glGetUniformLocation(shaderProgram, "model");
@@ -191,8 +228,112 @@ int main() {
     sf::Clock clock;
     sf::Time time;
 
+    // Strefy profilera; F12 zapisuje 120 klatek do trace.json (chrome://tracing)
+    Profiler profiler;
+    const int inputZone = profiler.zone("input");
+    const int drawZone = profiler.zone("draw");
+    const int sceneGpuZone = profiler.zone("scene", true);
+    const int presentZone = profiler.zone("present");
+
+    // Statystyki w rogu okna odświeżane 4 razy na sekundę; F11 włącza zapis do frame_stats.csv
+    FrameStats frameStats;
+    TextOverlay statsOverlay(800, 600);
+    FILE* statsCsv = nullptr;
+
+    // --record/--replay plik: wejście nagrywane lub odtwarzane klatka po klatce, --fixed-step stały krok
+    InputState input(parseInputArgs(argc, argv), { sf::Keyboard::W, sf::Keyboard::S, sf::Keyboard::A, sf::Keyboard::D });
+
+    // Ruch kamery w stałych krokach 1/60 s niezależnie od FPS; rysowana pozycja jest interpolowana między krokami
+    FixedTimestep timestep(1.0 / 60.0);
+    glm::vec3 previousCameraPos = cameraPos;
+    glm::vec3 renderCameraPos = cameraPos;
+
+    // Rysowanie i prezentacja jednej klatki. Przy --render-thread wywoływane na wątku renderującym,
+    // który jako jedyny używa wtedy kontekstu GL, profilera, statystyk i nakładki.
+    const bool useRenderThread = parseRenderThread(argc, argv);
+    const char* threadMode = useRenderThread ? "render thread" : "single thread";
+    LatencyMeter latency;
+    // Klatka po rozgrzaniu nie powinna alokować - licznik obejmuje oba wątki
+    AllocationWatch allocations;
+    sf::Clock renderClock;
+    auto renderFrame = [&](const FramePacket& packet) {
+        float frameTime = renderClock.restart().asSeconds();
+        allocations.beginFrame();
+        profiler.beginFrame();
+        profiler.addCpu(inputZone, packet.inputMs);
+        if (packet.captureTrace)
+            profiler.captureTrace("trace.json", 120);
+        if (packet.toggleCsv) {
+            if (statsCsv) {
+                std::fclose(statsCsv);
+                statsCsv = nullptr;
+            }
+            else if ((statsCsv = std::fopen("frame_stats.csv", "w")) != nullptr) {
+                frameStats.writeCsvHeader(statsCsv);
+            }
+        }
+
+        {
+            CpuProfileScope drawScope(profiler, drawZone);
+            GpuProfileScope sceneScope(profiler, sceneGpuZone);
+            // Nakładka zostawia program odwiązany
+            glUseProgram(shaderProgram);
+            glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(packet.view));
+
+            glm::mat4 model = glm::mat4(1.0f);
+            glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glBindVertexArray(resources.get(vao));
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            frameStats.countDraw(12);
+            frameStats.countUpload(2 * sizeof(glm::mat4));
+
+            statsOverlay.draw();
+        }
+
+        {
+            CpuProfileScope presentScope(profiler, presentZone);
+            window.display();
+        }
+        latency.frameShown(packet.inputTime);
+        resources.endFrame();
+
+        profiler.endFrame();
+        allocations.endFrame();
+        if (frameStats.endFrame(frameTime)) {
+            frameStats.countUpload(statsOverlay.setText(frameStats.text(), 8.0f, 8.0f));
+            if (statsCsv)
+                frameStats.writeCsvRow(statsCsv);
+        }
+        if (profiler.reportDue()) {
+            profiler.report(std::cout);
+            latency.report(std::cout, threadMode);
+            allocations.report(std::cout);
+            resources.report(std::cout);
+        }
+    };
+
+    // Kontekst GL przechodzi na wątek renderujący; zdarzenia okna nadal obsługuje wątek główny
+    SpscRing<FramePacket, FRAME_QUEUE_DEPTH> frameQueue;
+    std::thread renderThread;
+    if (useRenderThread) {
+        window.setActive(false);
+        renderThread = std::thread([&] {
+            window.setActive(true);
+            FramePacket packet;
+            for (;;) {
+                frameQueue.pop(packet);
+                if (packet.quit)
+                    break;
+                renderFrame(packet);
+            }
+            window.setActive(false);
+        });
+    }
+
     bool running = true;
-    while (running && window.isOpen()) {
+    while (running) {
         // Pobranie czasu wykonywania pętli
         time = clock.getElapsedTime();
         float deltaTime = time.asSeconds();
@@ -200,40 +341,62 @@ int main() {
         // Restart zegara, aby mierzyć czas do następnej klatki
         clock.restart();
 
-        float cameraSpeed = 2.5f * deltaTime;
-
+        FramePacket packet;
+        double inputStart = LatencyMeter::now();
         sf::Event event;
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::Closed)
-                window.close();
+                running = false;
 
-            if (event.type == sf::Event::MouseMoved) {
-                sf::Vector2i localPosition = sf::Mouse::getPosition(window);
-                ustawKameraMysz(window, localPosition.x, localPosition.y, yaw, pitch, cameraFront, sensitivity, firstMouse, lastX, lastY);
-            }
+            input.handleEvent(event);
 
             if (event.type == sf::Event::KeyPressed) {
                 if (event.key.code == sf::Keyboard::Escape)
                     running = false;
+                if (event.key.code == sf::Keyboard::F12)
+                    packet.captureTrace = true;
+                if (event.key.code == sf::Keyboard::F11)
+                    packet.toggleCsv = true;
             }
         }
 
-        ustawKameraKlawisze(cameraPos, cameraFront, cameraUp, cameraSpeed);
-
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+        // Ruch kamery tylko ze stanu wejścia - przy odtwarzaniu pochodzi z nagrania
+        if (!input.update(window, deltaTime))
+            running = false;
+        packet.inputTime = LatencyMeter::now();
 
-        glm::mat4 model = glm::mat4(1.0f);
-        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+        if (input.mouseMoved()) {
+            sf::Vector2i localPosition = input.mousePosition();
+            ustawKameraMysz(window, localPosition.x, localPosition.y, yaw, pitch, cameraFront, sensitivity, firstMouse, lastX, lastY);
+        }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        int steps = timestep.advance(input.deltaTime());
+        for (int i = 0; i < steps; ++i) {
+            previousCameraPos = cameraPos;
+            ustawKameraKlawisze(input, cameraPos, cameraFront, cameraUp, 2.5f * timestep.step());
+        }
+        renderCameraPos = interpolate(previousCameraPos, cameraPos, timestep.alpha());
+        packet.view = glm::lookAt(renderCameraPos, renderCameraPos + cameraFront, cameraUp);
+        packet.inputMs = (float)((LatencyMeter::now() - inputStart) * 1000.0);
+
+        if (useRenderThread)
+            frameQueue.push(packet);
+        else
+            renderFrame(packet);
+    }
 
-        std::string fps = "FPS: " + std::to_string(1.0f / deltaTime) + " | Czas trwania klatki: " + std::to_string(deltaTime) + "s";
-        window.setTitle(fps);
-        window.display();
+    if (useRenderThread) {
+        FramePacket quit;
+        quit.quit = true;
+        frameQueue.push(quit);
+        renderThread.join();
+        window.setActive(true);
     }
 
+    resources.release(program);
+    resources.release(vao);
+    resources.release(vbo);
+    if (statsCsv)
+        std::fclose(statsCsv);
     return 0;
 }
@@ -6,6 +6,19 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "../common/profiler.h"
+#include "../common/frame_stats.h"
+#include "../common/text_overlay.h"
+#include "../common/input_state.h"
+#include "../common/game_loop.h"
+#include "../common/gpu_resources.h"
+// Licznik alokacji podmienia malloc - tylko w buildzie pomiarowym z -DCOUNT_ALLOCATIONS
+#ifdef COUNT_ALLOCATIONS
+#define ALLOC_COUNTER_IMPLEMENTATION
+#else
+#define ALLOC_COUNTER_DISABLED
+#endif
+#include "../common/alloc_counter.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -82,20 +95,21 @@ void ustawKameraMysz(sf::Window& window, double xpos, double ypos, float& yaw, f
     cameraFront = glm::normalize(front);
 }
 
-void ustawKameraKlawisze(glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float cameraSpeed) {
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::W))
+void ustawKameraKlawisze(const InputState& input, glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float cameraSpeed) {
+    if (input.isKeyPressed(sf::Keyboard::W))
         cameraPos += cameraSpeed * cameraFront;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::S))
+    if (input.isKeyPressed(sf::Keyboard::S))
         cameraPos -= cameraSpeed * cameraFront;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::A))
+    if (input.isKeyPressed(sf::Keyboard::A))
         cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))
+    if (input.isKeyPressed(sf::Keyboard::D))
         cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 }
 
-int main() {
+int main(int argc, char** argv) {
     sf::Window window(sf::VideoMode(800, 600), "OpenGL FPS Camera", sf::Style::Close);
-    window.setFramerateLimit(20);
+    // Synchronizacja z odświeżaniem zamiast setFramerateLimit (usypianie); --uncapped bez limitu
+    window.setVerticalSyncEnabled(parsePresentMode(argc, argv) == PresentMode::VSync);
     window.setMouseCursorGrabbed(true);
     window.setMouseCursorVisible(false);
 
@@ -152,13 +166,15 @@ int main() {
          -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 1.0f, 0.0f   
     };
 
-    GLuint vbo, vao;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+    // Obiekty GL za uchwytami rejestru - zwalniane na końcu, a pominięte wypisywane jako wycieki
+    GpuResources resources;
+    VertexArrayHandle vao = resources.createVertexArray("cube vao");
+    BufferHandle vbo = resources.createBuffer("cube vbo");
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindVertexArray(resources.get(vao));
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(vbo));
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    resources.setBytes(vbo, sizeof(vertices));
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8* sizeof(GLfloat), (GLvoid*)0);
     glEnableVertexAttribArray(0);
@@ -182,6 +198,12 @@ int main() {
     glAttachShader(shaderProgram, fragmentShader);
     glBindFragDataLocation(shaderProgram, 0, "outColor");
     glLinkProgram(shaderProgram);
+    // Po linkowaniu shadery nie są już potrzebne
+    glDetachShader(shaderProgram, vertexShader);
+    glDetachShader(shaderProgram, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    ProgramHandle program = resources.adoptProgram(shaderProgram, "cube program");
     glUseProgram(shaderProgram);
 
     GLint uniModel = glGetUniformLocation(shaderProgram, "model");
@@ -191,9 +213,8 @@ int main() {
     glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
     glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
 
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    TextureHandle texture = resources.createTexture("metal.jpg");
+    glBindTexture(GL_TEXTURE_2D, resources.get(texture));
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -206,6 +227,7 @@ int main() {
     if (data) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        resources.setBytes(texture, (size_t)width * height * 3 * 4 / 3);
     }
     else {
         std::cerr << "Nie udalo sie zaladować tekstury" << std::endl;
@@ -229,49 +251,137 @@ int main() {
     sf::Clock clock;
     sf::Time time;
 
+    // Strefy profilera; F12 zapisuje 120 klatek do trace.json (chrome://tracing)
+    Profiler profiler;
+    const int inputZone = profiler.zone("input");
+    const int drawZone = profiler.zone("draw");
+    const int sceneGpuZone = profiler.zone("scene", true);
+    const int presentZone = profiler.zone("present");
+
+    // Statystyki w rogu okna odświeżane 4 razy na sekundę; F11 włącza zapis do frame_stats.csv
+    FrameStats frameStats;
+    TextOverlay statsOverlay(800, 600);
+    FILE* statsCsv = nullptr;
+
+    // --record/--replay plik: wejście nagrywane lub odtwarzane klatka po klatce, --fixed-step stały krok
+    InputState input(parseInputArgs(argc, argv), { sf::Keyboard::W, sf::Keyboard::S, sf::Keyboard::A, sf::Keyboard::D });
+
+    // Ruch kamery w stałych krokach 1/60 s niezależnie od FPS; rysowana pozycja jest interpolowana między krokami
+    FixedTimestep timestep(1.0 / 60.0);
+    glm::vec3 previousCameraPos = cameraPos;
+    glm::vec3 renderCameraPos = cameraPos;
+
+    // Klatka po rozgrzaniu nie powinna alokować
+    AllocationWatch allocations;
+
     bool running = true;
     while (running && window.isOpen()) {
+        allocations.beginFrame();
+        profiler.beginFrame();
+
         time = clock.getElapsedTime();
         float deltaTime = time.asSeconds();
 
         clock.restart();
 
-        float cameraSpeed = 2.5f * deltaTime;
+        {
+            CpuProfileScope inputScope(profiler, inputZone);
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                if (event.type == sf::Event::Closed) {
+                    running = false;
+                    break;
+                }
+
+                input.handleEvent(event);
+
+                if (event.type == sf::Event::KeyPressed) {
+                    if (event.key.code == sf::Keyboard::Escape)
+                        running = false;
+                    if (event.key.code == sf::Keyboard::F12)
+                        profiler.captureTrace("trace.json", 120);
+                    if (event.key.code == sf::Keyboard::F11) {
+                        if (statsCsv) {
+                            std::fclose(statsCsv);
+                            statsCsv = nullptr;
+                        }
+                        else if ((statsCsv = std::fopen("frame_stats.csv", "w")) != nullptr) {
+                            frameStats.writeCsvHeader(statsCsv);
+                        }
+                    }
+                }
+            }
+            // Zamknięcie okna lub Escape - reszta klatki już niepotrzebna
+            if (!running)
+                break;
 
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed)
-                window.close();
+            // Ruch kamery tylko ze stanu wejścia - przy odtwarzaniu pochodzi z nagrania
+            if (!input.update(window, deltaTime))
+                running = false;
 
-            if (event.type == sf::Event::MouseMoved) {
-                sf::Vector2i localPosition = sf::Mouse::getPosition(window);
+            if (input.mouseMoved()) {
+                sf::Vector2i localPosition = input.mousePosition();
                 ustawKameraMysz(window, localPosition.x, localPosition.y, yaw, pitch, cameraFront, sensitivity, firstMouse, lastX, lastY);
             }
 
-            if (event.type == sf::Event::KeyPressed) {
-                if (event.key.code == sf::Keyboard::Escape)
-                    running = false;
+            int steps = timestep.advance(input.deltaTime());
+            for (int i = 0; i < steps; ++i) {
+                previousCameraPos = cameraPos;
+                ustawKameraKlawisze(input, cameraPos, cameraFront, cameraUp, 2.5f * timestep.step());
             }
+            renderCameraPos = interpolate(previousCameraPos, cameraPos, timestep.alpha());
         }
 
-        ustawKameraKlawisze(cameraPos, cameraFront, cameraUp, cameraSpeed);
-
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
-
-        glm::mat4 model = glm::mat4(1.0f);
-        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        {
+            CpuProfileScope drawScope(profiler, drawZone);
+            GpuProfileScope sceneScope(profiler, sceneGpuZone);
+            // Nakładka zostawia program odwiązany
+            glUseProgram(shaderProgram);
+            glm::mat4 view = glm::lookAt(renderCameraPos, renderCameraPos + cameraFront, cameraUp);
+            glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+
+            glm::mat4 model = glm::mat4(1.0f);
+            glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, resources.get(texture));
+            glBindVertexArray(resources.get(vao));
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            frameStats.countDraw(12);
+            frameStats.countUpload(2 * sizeof(glm::mat4));
+
+            statsOverlay.draw();
+        }
 
-        std::string fps = "FPS: " + std::to_string(1.0f / deltaTime) + " | Czas trwania klatki: " + std::to_string(deltaTime) + "s";
-        window.setTitle(fps);
-        window.display();
+        {
+            CpuProfileScope presentScope(profiler, presentZone);
+            window.display();
+        }
+        resources.endFrame();
+
+        profiler.endFrame();
+        allocations.endFrame();
+        if (frameStats.endFrame(deltaTime)) {
+            frameStats.countUpload(statsOverlay.setText(frameStats.text(), 8.0f, 8.0f));
+            if (statsCsv)
+                frameStats.writeCsvRow(statsCsv);
+        }
+        if (profiler.reportDue()) {
+            profiler.report(std::cout);
+            allocations.report(std::cout);
+            resources.report(std::cout);
+        }
     }
 
+    // Obiekty GL usuwane, póki kontekst istnieje; okno zamyka się dopiero w destruktorze, po nakładce
+    // i profilerze, które też usuwają swoje obiekty
+    resources.release(program);
+    resources.release(texture);
+    resources.release(vao);
+    resources.release(vbo);
+    resources.shutdown(std::cerr);
+    if (statsCsv)
+        std::fclose(statsCsv);
     return 0;
 }
\ No newline at end of file
@@ -3,92 +3,763 @@
 #include <SFML/OpenGL.hpp>
 #include <SFML/System/Time.hpp>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "../common/shader_reload.h"
+#include "../common/thread_pool.h"
+#include "../common/input_state.h"
+#include "../common/game_loop.h"
+#include "../common/gpu_resources.h"
+#include "../common/gl_state_cache.h"
+#include "../common/render_queue.h"
+
+// Flagi permutacji - każda włączona flaga to jeden #define w shaderze
+constexpr unsigned FEATURE_LIGHTING = 1u << 0;
+constexpr unsigned FEATURE_TEXTURE = 1u << 1;
+constexpr unsigned FEATURE_VERTEX_COLOR = 1u << 2;
+// Słońce z kaskadowymi mapami cieni i cień sześcienny dla lightPos
+constexpr unsigned FEATURE_SHADOWS = 1u << 3;
+// Oryginalny shader z `uniform bool lightingEnabled` - zostawiony tylko do pomiaru kosztu rozgałęzienia
+constexpr unsigned FEATURE_DYNAMIC_BRANCH = 1u << 4;
+constexpr unsigned FEATURE_COUNT = 5;
+constexpr unsigned VARIANT_COUNT = 1u << FEATURE_COUNT;
+constexpr unsigned DEFAULT_FEATURES = FEATURE_LIGHTING | FEATURE_TEXTURE;
+
+const GLchar* featureDefines[FEATURE_COUNT] = {
+    "#define LIGHTING\n",
+    "#define TEXTURE\n",
+    "#define VERTEX_COLOR\n",
+    "#define SHADOWS\n",
+    "#define DYNAMIC_BRANCH\n",
+};
+
+constexpr unsigned toggleFeature(unsigned features, unsigned feature) {
+    return features ^ feature;
+}
+
+static_assert(toggleFeature(DEFAULT_FEATURES, FEATURE_LIGHTING) == FEATURE_TEXTURE, "L key must only flip the lighting bit");
+
+// Kombinacja flag sprowadzona do tej, która daje ten sam shader: DYNAMIC_BRANCH ma własne rozgałęzienie
+// zamiast LIGHTING, a SHADOWS bez oświetlenia nic nie zmienia w wyniku
+constexpr unsigned canonicalFeatures(unsigned features) {
+    if (features & FEATURE_DYNAMIC_BRANCH)
+        features &= ~FEATURE_LIGHTING;
+    if (!(features & (FEATURE_LIGHTING | FEATURE_DYNAMIC_BRANCH)))
+        features &= ~FEATURE_SHADOWS;
+    return features;
+}
+
+constexpr unsigned countCompiledVariants() {
+    unsigned count = 0;
+    for (unsigned features = 0; features < VARIANT_COUNT; ++features) {
+        if (canonicalFeatures(features) == features)
+            ++count;
+    }
+    return count;
+}
 
-const GLchar* vertexSource = R"glsl(
-#version 150 core
-in vec3 position;
-in vec3 color;
-in vec2 texCoord;
-in vec3 aNormal;
-
-out vec3 Normal;
-out vec2 TexCoord;
-out vec3 Color;
-out vec3 FragPos;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
-
-void main() {
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    FragPos = vec3(model * vec4(position, 1.0));
-    Color = color;
-    TexCoord = texCoord;
-    gl_Position = proj * view * model * vec4(position, 1.0);
-}
-)glsl";
-
-const GLchar* fragmentSource = R"glsl(
-#version 150 core
-in vec3 Color;
-in vec2 TexCoord;
-in vec3 Normal;
-in vec3 FragPos;
-out vec4 outColor;
-uniform sampler2D texture1;
-uniform vec3 lightPos;          
-uniform vec3 viewPos;           
-uniform vec3 ambientLightColor; 
-uniform vec3 diffuseLightColor; 
-uniform float ambientStrength;  
-uniform float lightStrength; 
-uniform bool lightingEnabled;
-
-void main() {
-
-    vec3 ambient = ambientStrength * ambientLightColor;
-    vec3 diffuse = vec3(0.0);
-    if (lightingEnabled) {
-        vec3 norm = normalize(Normal);
-        vec3 lightDir = normalize(lightPos - FragPos);
-        float diff = max(dot(norm, lightDir), 0.0);
-        diffuse = diff * diffuseLightColor * lightStrength;
+// Kompilowane są tylko warianty kanoniczne (20 z 32)
+constexpr unsigned COMPILED_VARIANT_COUNT = countCompiledVariants();
+
+const int SCREEN_WIDTH = 800;
+const int SCREEN_HEIGHT = 600;
+
+// Programy w paczce kompilacji: najpierw warianty forward (kanoniczne, rosnąco po flagach), potem ścieżka deferred
+const unsigned PROGRAM_GBUFFER = COMPILED_VARIANT_COUNT;
+const unsigned PROGRAM_DEFERRED_AMBIENT = COMPILED_VARIANT_COUNT + 1;
+const unsigned PROGRAM_DEFERRED_LIGHT = COMPILED_VARIANT_COUNT + 2;
+const unsigned PROGRAM_CLUSTERED = COMPILED_VARIANT_COUNT + 3;
+const unsigned PROGRAM_SHADOW_DEPTH = COMPILED_VARIANT_COUNT + 4;
+const unsigned PROGRAM_SHADOW_POINT = COMPILED_VARIANT_COUNT + 5;
+const unsigned PROGRAM_COUNT = COMPILED_VARIANT_COUNT + 6;
+
+const int MAX_LIGHTS = 1024;
+
+const float FIELD_OF_VIEW = 45.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// Siatka klastrów (froxeli): kafelki ekranu x plasterki głębokości rozmieszczone logarytmicznie
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTERS_PER_SLICE = CLUSTER_X * CLUSTER_Y;
+const int CLUSTER_COUNT = CLUSTERS_PER_SLICE * CLUSTER_Z;
+
+// Cienie: kaskady pokrywają pierwsze SHADOW_DISTANCE jednostek bryły widzenia kamery
+const int CASCADE_COUNT = 3;
+const int CASCADE_RESOLUTION = 1024;
+const float SHADOW_DISTANCE = 20.0f;
+// Kaskada obejmuje kulę większą od wycinka frustum, więc kamera może się trochę przesunąć bez przerysowania
+const float CASCADE_PADDING = 1.25f;
+// Obiekty między słońcem a kulą kaskady też rzucają w nią cień
+const float CASCADE_CASTER_DISTANCE = 20.0f;
+const int POINT_SHADOW_RESOLUTION = 512;
+const float POINT_SHADOW_NEAR = 0.05f;
+const float POINT_SHADOW_FAR = 25.0f;
+
+enum class Renderer { Forward, Deferred, Clustered };
+
+const char* rendererName(Renderer renderer) {
+    switch (renderer) {
+    case Renderer::Deferred: return "deferred";
+    case Renderer::Clustered: return "clustered";
+    default: return "forward";
     }
+}
 
-   vec3 lighting = (ambient + diffuse);
-   vec4 texColor = texture(texture1, TexCoord);
-   outColor = vec4(lighting, 1.0) * texColor;
-}
-)glsl";
-
-void checkShaderCompilation(GLuint shader, const std::string& shaderType) {
-    GLint status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE) {
-        GLint logLength;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-        char* log = new char[logLength];
-        glGetShaderInfoLog(shader, logLength, NULL, log);
-        std::cerr << "Compilation error in " << shaderType << " shader: " << log << std::endl;
-        delete[] log;
+struct ShaderVariant {
+    GLuint program = 0;
+    GLint uniModel = -1;
+    GLint uniView = -1;
+    GLint uniProj = -1;
+    GLint uniLightPos = -1;
+    GLint uniViewPos = -1;
+    GLint uniAmbientLightColor = -1;
+    GLint uniDiffuseLightColor = -1;
+    GLint uniAmbientStrength = -1;
+    GLint uniLightStrength = -1;
+    GLint uniLightingEnabled = -1;
+    GLint uniCascadeViewProj = -1;
+    GLint uniCascadeSplits = -1;
+    GLint uniSunDirection = -1;
+    GLint uniSunColor = -1;
+};
+
+// Nagłówek wariantu: #version musi być pierwszą linią, za nim #define włączonych flag
+std::string variantHeader(unsigned features) {
+    std::string header = "#version 150 core\n";
+    for (unsigned i = 0; i < FEATURE_COUNT; ++i) {
+        if (features & (1u << i))
+            header += featureDefines[i];
     }
-    else {
-        std::cout << shaderType << " shader compilation OK" << std::endl;
+    return header;
+}
+
+ProgramDesc describeShaderVariant(unsigned features, const std::string& vertexBody, const std::string& fragmentBody) {
+    ProgramDesc desc;
+    std::string header = variantHeader(features);
+    desc.vertexSource = header + vertexBody;
+    desc.fragmentSource = header + fragmentBody;
+    // Stałe lokalizacje atrybutów - jeden VAO działa ze wszystkimi wariantami
+    desc.attribs = { "position", "color", "texCoord", "aNormal" };
+    desc.fragOutput = "outColor";
+    return desc;
+}
+
+bool loadProgramDesc(const std::string& name, ProgramDesc& desc) {
+    return readShaderFile("shaders/" + name + ".vert", desc.vertexSource) &&
+        readShaderFile("shaders/" + name + ".frag", desc.fragmentSource);
+}
+
+bool loadShaderPrograms(std::vector<ProgramDesc>& batch) {
+    std::string vertexBody, fragmentBody;
+    if (!readShaderFile("shaders/cube.vert", vertexBody) || !readShaderFile("shaders/cube.frag", fragmentBody))
+        return false;
+    batch.clear();
+    for (unsigned features = 0; features < VARIANT_COUNT; ++features) {
+        if (canonicalFeatures(features) == features)
+            batch.push_back(describeShaderVariant(features, vertexBody, fragmentBody));
+    }
+
+    batch.resize(PROGRAM_COUNT);
+    return loadProgramDesc("gbuffer", batch[PROGRAM_GBUFFER]) &&
+        loadProgramDesc("deferred_ambient", batch[PROGRAM_DEFERRED_AMBIENT]) &&
+        loadProgramDesc("deferred_light", batch[PROGRAM_DEFERRED_LIGHT]) &&
+        loadProgramDesc("clustered", batch[PROGRAM_CLUSTERED]) &&
+        loadProgramDesc("shadow_depth", batch[PROGRAM_SHADOW_DEPTH]) &&
+        loadProgramDesc("shadow_point", batch[PROGRAM_SHADOW_POINT]);
+}
+
+ShaderVariant makeShaderVariant(GLuint program) {
+    ShaderVariant variant;
+    variant.program = program;
+    variant.uniModel = glGetUniformLocation(program, "model");
+    variant.uniView = glGetUniformLocation(program, "view");
+    variant.uniProj = glGetUniformLocation(program, "proj");
+    variant.uniLightPos = glGetUniformLocation(program, "lightPos");
+    variant.uniViewPos = glGetUniformLocation(program, "viewPos");
+    variant.uniAmbientLightColor = glGetUniformLocation(program, "ambientLightColor");
+    variant.uniDiffuseLightColor = glGetUniformLocation(program, "diffuseLightColor");
+    variant.uniAmbientStrength = glGetUniformLocation(program, "ambientStrength");
+    variant.uniLightStrength = glGetUniformLocation(program, "lightStrength");
+    variant.uniLightingEnabled = glGetUniformLocation(program, "lightingEnabled");
+    variant.uniCascadeViewProj = glGetUniformLocation(program, "cascadeViewProj");
+    variant.uniCascadeSplits = glGetUniformLocation(program, "cascadeSplits");
+    variant.uniSunDirection = glGetUniformLocation(program, "sunDirection");
+    variant.uniSunColor = glGetUniformLocation(program, "sunColor");
+
+    // Mapy cieni siedzą na stałe na jednostkach 7 i 8; w wariantach bez SHADOWS lokalizacje są -1
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "cascadeShadowMap"), 7);
+    glUniform1i(glGetUniformLocation(program, "pointShadowMap"), 8);
+    glUniform1f(glGetUniformLocation(program, "pointShadowFar"), POINT_SHADOW_FAR);
+    return variant;
+}
+
+// Wariant dla każdej kombinacji flag; kombinacje niekanoniczne dzielą program swojego wariantu kanonicznego
+void makeShaderVariants(const std::vector<GLuint>& programs, ShaderVariant (&variants)[VARIANT_COUNT]) {
+    unsigned slot = 0;
+    for (unsigned features = 0; features < VARIANT_COUNT; ++features) {
+        if (canonicalFeatures(features) == features)
+            variants[features] = makeShaderVariant(programs[slot++]);
+    }
+    for (unsigned features = 0; features < VARIANT_COUNT; ++features)
+        variants[features] = variants[canonicalFeatures(features)];
+}
+
+struct DeferredPrograms {
+    GLuint gbuffer = 0;
+    GLint gbufferModel = -1;
+    GLint gbufferView = -1;
+    GLint gbufferProj = -1;
+
+    GLuint ambient = 0;
+    GLint ambientInvViewProj = -1;
+    GLint ambientLightPos = -1;
+    GLint ambientAmbientLightColor = -1;
+    GLint ambientDiffuseLightColor = -1;
+    GLint ambientAmbientStrength = -1;
+    GLint ambientLightStrength = -1;
+    GLint ambientLightingEnabled = -1;
+
+    GLuint light = 0;
+    GLint lightView = -1;
+    GLint lightProj = -1;
+    GLint lightInvViewProj = -1;
+    GLint lightLightStrength = -1;
+};
+
+// Próbniki G-bufora są stałe (jednostki 1-3), więc ustawiane są raz po zlinkowaniu
+void bindGBufferSamplers(GLuint program) {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "gAlbedo"), 1);
+    glUniform1i(glGetUniformLocation(program, "gNormal"), 2);
+    glUniform1i(glGetUniformLocation(program, "gDepth"), 3);
+    glUniform2f(glGetUniformLocation(program, "screenSize"), (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT);
+}
+
+DeferredPrograms makeDeferredPrograms(const std::vector<GLuint>& programs) {
+    DeferredPrograms deferred;
+    deferred.gbuffer = programs[PROGRAM_GBUFFER];
+    deferred.gbufferModel = glGetUniformLocation(deferred.gbuffer, "model");
+    deferred.gbufferView = glGetUniformLocation(deferred.gbuffer, "view");
+    deferred.gbufferProj = glGetUniformLocation(deferred.gbuffer, "proj");
+
+    deferred.ambient = programs[PROGRAM_DEFERRED_AMBIENT];
+    deferred.ambientInvViewProj = glGetUniformLocation(deferred.ambient, "invViewProj");
+    deferred.ambientLightPos = glGetUniformLocation(deferred.ambient, "lightPos");
+    deferred.ambientAmbientLightColor = glGetUniformLocation(deferred.ambient, "ambientLightColor");
+    deferred.ambientDiffuseLightColor = glGetUniformLocation(deferred.ambient, "diffuseLightColor");
+    deferred.ambientAmbientStrength = glGetUniformLocation(deferred.ambient, "ambientStrength");
+    deferred.ambientLightStrength = glGetUniformLocation(deferred.ambient, "lightStrength");
+    deferred.ambientLightingEnabled = glGetUniformLocation(deferred.ambient, "lightingEnabled");
+    bindGBufferSamplers(deferred.ambient);
+
+    deferred.light = programs[PROGRAM_DEFERRED_LIGHT];
+    deferred.lightView = glGetUniformLocation(deferred.light, "view");
+    deferred.lightProj = glGetUniformLocation(deferred.light, "proj");
+    deferred.lightInvViewProj = glGetUniformLocation(deferred.light, "invViewProj");
+    deferred.lightLightStrength = glGetUniformLocation(deferred.light, "lightStrength");
+    bindGBufferSamplers(deferred.light);
+    return deferred;
+}
+
+struct GBuffer {
+    FramebufferHandle fbo;
+    TextureHandle albedo;
+    TextureHandle normal;
+    TextureHandle depth;
+};
+
+// Przywraca wiązanie GL_TEXTURE_2D aktywnej jednostki - na jednostce 0 leży już tekstura sceny
+TextureHandle createGBufferTexture(GpuResources& resources, const char* label, GLint internalFormat, GLenum format,
+    GLenum type, size_t texelBytes, int width, int height) {
+    GLint previous = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    TextureHandle texture = resources.createTexture(label);
+    resources.setBytes(texture, texelBytes * width * height);
+    glBindTexture(GL_TEXTURE_2D, resources.get(texture));
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, (GLuint)previous);
+    return texture;
+}
+
+// Albedo w RGBA8, normalne w świecie w RGB16F, pozycja odtwarzana z głębi
+bool createGBuffer(GpuResources& resources, GBuffer& gbuffer, int width, int height) {
+    gbuffer.albedo = createGBufferTexture(resources, "g-buffer albedo", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, width, height);
+    gbuffer.normal = createGBufferTexture(resources, "g-buffer normal", GL_RGB16F, GL_RGB, GL_FLOAT, 6, width, height);
+    gbuffer.depth = createGBufferTexture(resources, "g-buffer depth", GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4,
+        width, height);
+
+    gbuffer.fbo = resources.createFramebuffer("g-buffer");
+    glBindFramebuffer(GL_FRAMEBUFFER, resources.get(gbuffer.fbo));
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.get(gbuffer.albedo), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, resources.get(gbuffer.normal), 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, resources.get(gbuffer.depth), 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "G-buffer is incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void releaseGBuffer(GpuResources& resources, GBuffer& gbuffer) {
+    resources.release(gbuffer.fbo);
+    resources.release(gbuffer.albedo);
+    resources.release(gbuffer.normal);
+    resources.release(gbuffer.depth);
+}
+
+struct LightInstance {
+    glm::vec4 positionRadius;
+    glm::vec3 color;
+};
+
+float fract(float value) {
+    return value - std::floor(value);
+}
+
+// Światła krążą wokół sześcianu po pierścieniach o różnych promieniach i prędkościach
+void animateLights(std::vector<LightInstance>& lights, int count, float time) {
+    lights.resize(count);
+    for (int i = 0; i < count; ++i) {
+        float ring = 0.8f + 4.0f * fract(i * 0.618034f);
+        float angle = 6.2831853f * i / count + time * (0.2f + 0.6f * fract(i * 0.381966f));
+        float height = -0.45f + 1.2f * fract(i * 0.754878f);
+        lights[i].positionRadius = glm::vec4(cos(angle) * ring, height, sin(angle) * ring, 1.0f);
+        lights[i].color = glm::vec3(fract(i * 0.31f), fract(i * 0.57f + 0.3f), fract(i * 0.83f + 0.6f)) * 0.8f + glm::vec3(0.2f);
     }
 }
 
-int main() {
+struct ClusteredProgram {
+    GLuint program = 0;
+    GLint uniModel = -1;
+    GLint uniView = -1;
+    GLint uniProj = -1;
+    GLint uniLightPos = -1;
+    GLint uniAmbientLightColor = -1;
+    GLint uniDiffuseLightColor = -1;
+    GLint uniAmbientStrength = -1;
+    GLint uniLightStrength = -1;
+    GLint uniLightingEnabled = -1;
+};
+
+ClusteredProgram makeClusteredProgram(GLuint program) {
+    ClusteredProgram clustered;
+    clustered.program = program;
+    clustered.uniModel = glGetUniformLocation(program, "model");
+    clustered.uniView = glGetUniformLocation(program, "view");
+    clustered.uniProj = glGetUniformLocation(program, "proj");
+    clustered.uniLightPos = glGetUniformLocation(program, "lightPos");
+    clustered.uniAmbientLightColor = glGetUniformLocation(program, "ambientLightColor");
+    clustered.uniDiffuseLightColor = glGetUniformLocation(program, "diffuseLightColor");
+    clustered.uniAmbientStrength = glGetUniformLocation(program, "ambientStrength");
+    clustered.uniLightStrength = glGetUniformLocation(program, "lightStrength");
+    clustered.uniLightingEnabled = glGetUniformLocation(program, "lightingEnabled");
+
+    // Stałe siatki i jednostki tekstur buforowych (4-6) nie zmieniają się między klatkami
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "lightData"), 4);
+    glUniform1i(glGetUniformLocation(program, "clusterCells"), 5);
+    glUniform1i(glGetUniformLocation(program, "lightIndices"), 6);
+    glUniform3i(glGetUniformLocation(program, "clusterDims"), CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+    glUniform2f(glGetUniformLocation(program, "tileSize"), (float)SCREEN_WIDTH / CLUSTER_X, (float)SCREEN_HEIGHT / CLUSTER_Y);
+    glUniform1f(glGetUniformLocation(program, "clusterNear"), NEAR_PLANE);
+    glUniform1f(glGetUniformLocation(program, "sliceScale"), CLUSTER_Z / std::log(FAR_PLANE / NEAR_PLANE));
+    return clustered;
+}
+
+// Zakres klastrów pokrywanych przez kulę zasięgu światła; minZ > maxZ oznacza światło poza bryłą widzenia
+struct LightBounds {
+    int minX, maxX;
+    int minY, maxY;
+    int minZ, maxZ;
+};
+
+int depthSlice(float depth) {
+    int slice = (int)std::floor(std::log(depth / NEAR_PLANE) * (CLUSTER_Z / std::log(FAR_PLANE / NEAR_PLANE)));
+    return glm::clamp(slice, 0, CLUSTER_Z - 1);
+}
+
+int clampTile(float ndc, int tiles) {
+    return glm::clamp((int)std::floor((ndc * 0.5f + 0.5f) * tiles), 0, tiles - 1);
+}
+
+LightBounds computeLightBounds(const LightInstance& light, const glm::mat4& view, const glm::mat4& proj) {
+    LightBounds bounds = { 0, CLUSTER_X - 1, 0, CLUSTER_Y - 1, 1, 0 };
+    glm::vec4 center = view * glm::vec4(glm::vec3(light.positionRadius), 1.0f);
+    float radius = light.positionRadius.w;
+    float depthMin = -center.z - radius;
+    float depthMax = -center.z + radius;
+    if (depthMax <= NEAR_PLANE || depthMin >= FAR_PLANE)
+        return bounds;
+
+    // Kula przecinająca płaszczyznę bliską może pokryć dowolną część ekranu
+    if (depthMin > NEAR_PLANE) {
+        float minNdcX = 1.0f, maxNdcX = -1.0f, minNdcY = 1.0f, maxNdcY = -1.0f;
+        const float depths[2] = { depthMin, depthMax };
+        for (float depth : depths) {
+            for (float side = -1.0f; side <= 1.0f; side += 2.0f) {
+                float x = (center.x + side * radius) * proj[0][0] / depth;
+                float y = (center.y + side * radius) * proj[1][1] / depth;
+                minNdcX = std::min(minNdcX, x);
+                maxNdcX = std::max(maxNdcX, x);
+                minNdcY = std::min(minNdcY, y);
+                maxNdcY = std::max(maxNdcY, y);
+            }
+        }
+        if (maxNdcX < -1.0f || minNdcX > 1.0f || maxNdcY < -1.0f || minNdcY > 1.0f)
+            return bounds;
+        bounds.minX = clampTile(minNdcX, CLUSTER_X);
+        bounds.maxX = clampTile(maxNdcX, CLUSTER_X);
+        bounds.minY = clampTile(minNdcY, CLUSTER_Y);
+        bounds.maxY = clampTile(maxNdcY, CLUSTER_Y);
+    }
+    bounds.minZ = depthSlice(std::max(depthMin, NEAR_PLANE));
+    bounds.maxZ = depthSlice(std::min(depthMax, FAR_PLANE));
+    return bounds;
+}
+
+// Przypisanie świateł do klastrów na CPU. Każdy plasterek głębokości wypełnia osobny wątek
+// we własnej liście, więc nie potrzeba atomików; na koniec listy są sklejane w jeden bufor.
+struct ClusterGrid {
+    std::vector<LightBounds> bounds;
+    std::vector<GLuint> cells;
+    std::vector<std::vector<GLushort>> sliceIndices;
+    std::vector<GLuint> sliceOffsets;
+    std::vector<GLushort> indices;
+    std::vector<glm::vec4> lightTexels;
+
+    ClusterGrid() : cells(CLUSTER_COUNT * 2), sliceIndices(CLUSTER_Z), sliceOffsets(CLUSTER_Z + 1) {
+        bounds.reserve(MAX_LIGHTS);
+        lightTexels.reserve(MAX_LIGHTS * 2);
+    }
+};
+
+void buildClusters(ClusterGrid& grid, const std::vector<LightInstance>& lights, const glm::mat4& view, const glm::mat4& proj, ThreadPool& pool) {
+    grid.bounds.resize(lights.size());
+    pool.parallelFor(lights.size(), 64, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i)
+            grid.bounds[i] = computeLightBounds(lights[i], view, proj);
+    });
+
+    pool.parallelFor(CLUSTER_Z, 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t z = begin; z < end; ++z) {
+            GLuint* sliceCells = &grid.cells[z * CLUSTERS_PER_SLICE * 2];
+            GLuint counts[CLUSTERS_PER_SLICE] = {};
+            for (const LightBounds& b : grid.bounds) {
+                if ((int)z < b.minZ || (int)z > b.maxZ)
+                    continue;
+                for (int y = b.minY; y <= b.maxY; ++y)
+                    for (int x = b.minX; x <= b.maxX; ++x)
+                        ++counts[y * CLUSTER_X + x];
+            }
+
+            GLuint offset = 0;
+            for (int cell = 0; cell < CLUSTERS_PER_SLICE; ++cell) {
+                sliceCells[cell * 2] = offset;
+                sliceCells[cell * 2 + 1] = 0;
+                offset += counts[cell];
+            }
+
+            std::vector<GLushort>& indices = grid.sliceIndices[z];
+            indices.resize(offset);
+            for (size_t light = 0; light < grid.bounds.size(); ++light) {
+                const LightBounds& b = grid.bounds[light];
+                if ((int)z < b.minZ || (int)z > b.maxZ)
+                    continue;
+                for (int y = b.minY; y <= b.maxY; ++y) {
+                    for (int x = b.minX; x <= b.maxX; ++x) {
+                        GLuint* cell = &sliceCells[(y * CLUSTER_X + x) * 2];
+                        indices[cell[0] + cell[1]++] = (GLushort)light;
+                    }
+                }
+            }
+        }
+    });
+
+    grid.sliceOffsets[0] = 0;
+    for (int z = 0; z < CLUSTER_Z; ++z)
+        grid.sliceOffsets[z + 1] = grid.sliceOffsets[z] + (GLuint)grid.sliceIndices[z].size();
+    grid.indices.resize(grid.sliceOffsets[CLUSTER_Z]);
+
+    pool.parallelFor(CLUSTER_Z, 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t z = begin; z < end; ++z) {
+            const std::vector<GLushort>& indices = grid.sliceIndices[z];
+            std::copy(indices.begin(), indices.end(), grid.indices.begin() + grid.sliceOffsets[z]);
+            GLuint* sliceCells = &grid.cells[z * CLUSTERS_PER_SLICE * 2];
+            for (int cell = 0; cell < CLUSTERS_PER_SLICE; ++cell)
+                sliceCells[cell * 2] += grid.sliceOffsets[z];
+        }
+    });
+
+    grid.lightTexels.resize(lights.size() * 2);
+    for (size_t i = 0; i < lights.size(); ++i) {
+        grid.lightTexels[i * 2] = lights[i].positionRadius;
+        grid.lightTexels[i * 2 + 1] = glm::vec4(lights[i].color, 0.0f);
+    }
+}
+
+struct ClusterBuffers {
+    BufferHandle buffers[3];
+    TextureHandle textures[3];
+};
+
+void createClusterBuffers(GpuResources& resources, ClusterBuffers& cluster) {
+    const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+    const char* bufferLabels[3] = { "cluster lights", "cluster cells", "cluster indices" };
+    const char* textureLabels[3] = { "cluster lights texture", "cluster cells texture", "cluster indices texture" };
+    for (int i = 0; i < 3; ++i) {
+        cluster.buffers[i] = resources.createBuffer(bufferLabels[i]);
+        cluster.textures[i] = resources.createTexture(textureLabels[i]);
+        glBindBuffer(GL_TEXTURE_BUFFER, resources.get(cluster.buffers[i]));
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, resources.get(cluster.textures[i]));
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], resources.get(cluster.buffers[i]));
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+// Bufory są osierocane co klatkę, żeby nie czekać na GPU, które może jeszcze czytać poprzednie dane
+void uploadClusterBuffers(GpuResources& resources, const ClusterBuffers& cluster, const ClusterGrid& grid) {
+    const GLsizeiptr sizes[3] = {
+        (GLsizeiptr)(grid.lightTexels.size() * sizeof(glm::vec4)),
+        (GLsizeiptr)(grid.cells.size() * sizeof(GLuint)),
+        (GLsizeiptr)(grid.indices.size() * sizeof(GLushort)),
+    };
+    const void* data[3] = { grid.lightTexels.data(), grid.cells.data(), grid.indices.data() };
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, resources.get(cluster.buffers[i]));
+        glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(sizes[i], 16), NULL, GL_STREAM_DRAW);
+        resources.setBytes(cluster.buffers[i], (size_t)std::max<GLsizeiptr>(sizes[i], 16));
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void releaseClusterBuffers(GpuResources& resources, ClusterBuffers& cluster) {
+    for (int i = 0; i < 3; ++i) {
+        resources.release(cluster.textures[i]);
+        resources.release(cluster.buffers[i]);
+    }
+}
+
+struct ShadowPrograms {
+    GLuint depth = 0;
+    GLint depthModel = -1;
+    GLint depthLightViewProj = -1;
+
+    GLuint point = 0;
+    GLint pointModel = -1;
+    GLint pointLightViewProj = -1;
+    GLint pointLightPos = -1;
+};
+
+ShadowPrograms makeShadowPrograms(const std::vector<GLuint>& programs) {
+    ShadowPrograms shadow;
+    shadow.depth = programs[PROGRAM_SHADOW_DEPTH];
+    shadow.depthModel = glGetUniformLocation(shadow.depth, "model");
+    shadow.depthLightViewProj = glGetUniformLocation(shadow.depth, "lightViewProj");
+
+    shadow.point = programs[PROGRAM_SHADOW_POINT];
+    shadow.pointModel = glGetUniformLocation(shadow.point, "model");
+    shadow.pointLightViewProj = glGetUniformLocation(shadow.point, "lightViewProj");
+    shadow.pointLightPos = glGetUniformLocation(shadow.point, "lightPos");
+    glUseProgram(shadow.point);
+    glUniform1f(glGetUniformLocation(shadow.point, "pointShadowFar"), POINT_SHADOW_FAR);
+    return shadow;
+}
+
+// Kula otaczająca wycinek bryły widzenia - jej promień nie zależy od obrotu kamery,
+// więc samo rozglądanie się nie unieważnia zapamiętanych kaskad
+struct ShadowSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+ShadowSphere frustumSliceSphere(float nearDepth, float farDepth, const glm::vec3& cameraPos, const glm::vec3& cameraFront) {
+    float tanY = std::tan(glm::radians(FIELD_OF_VIEW) * 0.5f);
+    float tanX = tanY * SCREEN_WIDTH / SCREEN_HEIGHT;
+    float middle = (nearDepth + farDepth) * 0.5f;
+    glm::vec3 nearCorner(nearDepth * tanX, nearDepth * tanY, nearDepth - middle);
+    glm::vec3 farCorner(farDepth * tanX, farDepth * tanY, farDepth - middle);
+    ShadowSphere sphere;
+    sphere.center = cameraPos + cameraFront * middle;
+    sphere.radius = std::max(glm::length(nearCorner), glm::length(farCorner));
+    return sphere;
+}
+
+// Podział mieszany: logarytmiczny blisko kamery, równomierny dalej (lambda = 0.75)
+void computeCascadeSplits(float splits[CASCADE_COUNT]) {
+    for (int i = 0; i < CASCADE_COUNT; ++i) {
+        float part = (float)(i + 1) / CASCADE_COUNT;
+        float logSplit = NEAR_PLANE * std::pow(SHADOW_DISTANCE / NEAR_PLANE, part);
+        float uniformSplit = NEAR_PLANE + (SHADOW_DISTANCE - NEAR_PLANE) * part;
+        splits[i] = glm::mix(uniformSplit, logSplit, 0.75f);
+    }
+}
+
+struct Cascade {
+    bool valid = false;
+    glm::vec3 center;
+    float radius = 0.0f;
+    glm::vec3 sunDirection;
+    unsigned sceneVersion = 0;
+    glm::mat4 viewProj;
+};
+
+// Zapamiętana kaskada wystarcza, dopóki jej kula zawiera bieżący wycinek, a słońce i geometria stoją
+bool cascadeCovers(const Cascade& cascade, const ShadowSphere& slice, const glm::vec3& sunDirection, unsigned sceneVersion) {
+    return cascade.valid && cascade.sceneVersion == sceneVersion && cascade.sunDirection == sunDirection &&
+        glm::length(slice.center - cascade.center) + slice.radius <= cascade.radius;
+}
+
+// Środek przyciągany do siatki tekseli, żeby krawędzie cieni nie migotały po przerysowaniu
+void fitCascade(Cascade& cascade, const ShadowSphere& slice, const glm::vec3& sunDirection, unsigned sceneVersion) {
+    float radius = slice.radius * CASCADE_PADDING;
+    float texel = 2.0f * radius / CASCADE_RESOLUTION;
+    glm::vec3 up = std::abs(sunDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), sunDirection, up);
+    glm::vec3 center = glm::vec3(lightView * glm::vec4(slice.center, 1.0f));
+    center.x = std::floor(center.x / texel) * texel;
+    center.y = std::floor(center.y / texel) * texel;
+    glm::mat4 lightProj = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+        -center.z - radius - CASCADE_CASTER_DISTANCE, -center.z + radius);
+
+    cascade.valid = true;
+    cascade.center = glm::vec3(glm::inverse(lightView) * glm::vec4(center, 1.0f));
+    cascade.radius = radius;
+    cascade.sunDirection = sunDirection;
+    cascade.sceneVersion = sceneVersion;
+    cascade.viewProj = lightProj * lightView;
+}
+
+struct ShadowMaps {
+    TextureHandle cascadeTexture;
+    FramebufferHandle cascadeFbo;
+    Cascade cascades[CASCADE_COUNT];
+
+    TextureHandle pointTexture;
+    FramebufferHandle pointFbo;
+    bool pointValid = false;
+    glm::vec3 pointLightPos;
+    unsigned pointSceneVersion = 0;
+};
+
+void setShadowSampling(GLenum target) {
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+bool checkShadowFramebuffer(const char* name) {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << name << " shadow framebuffer is incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Kaskady w jednej tablicy tekstur głębi, cień punktowy w mapie sześciennej; obie z porównaniem sprzętowym (PCF 2x2)
+bool createShadowMaps(GpuResources& resources, ShadowMaps& shadow) {
+    shadow.cascadeTexture = resources.createTexture("shadow cascades");
+    resources.setBytes(shadow.cascadeTexture, (size_t)4 * CASCADE_RESOLUTION * CASCADE_RESOLUTION * CASCADE_COUNT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, resources.get(shadow.cascadeTexture));
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, CASCADE_RESOLUTION, CASCADE_RESOLUTION, CASCADE_COUNT,
+        0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    setShadowSampling(GL_TEXTURE_2D_ARRAY);
+    // Poza kaskadą nie ma cienia
+    const GLfloat border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+    shadow.pointTexture = resources.createTexture("point shadow cube");
+    resources.setBytes(shadow.pointTexture, (size_t)4 * POINT_SHADOW_RESOLUTION * POINT_SHADOW_RESOLUTION * 6);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, resources.get(shadow.pointTexture));
+    for (int face = 0; face < 6; ++face)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION,
+            0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    setShadowSampling(GL_TEXTURE_CUBE_MAP);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    shadow.cascadeFbo = resources.createFramebuffer("shadow cascades");
+    glBindFramebuffer(GL_FRAMEBUFFER, resources.get(shadow.cascadeFbo));
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, resources.get(shadow.cascadeTexture), 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool ok = checkShadowFramebuffer("Cascade");
+
+    shadow.pointFbo = resources.createFramebuffer("point shadow");
+    glBindFramebuffer(GL_FRAMEBUFFER, resources.get(shadow.pointFbo));
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, resources.get(shadow.pointTexture), 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    ok = checkShadowFramebuffer("Point") && ok;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return ok;
+}
+
+void invalidateShadowMaps(ShadowMaps& shadow) {
+    for (Cascade& cascade : shadow.cascades)
+        cascade.valid = false;
+    shadow.pointValid = false;
+}
+
+void releaseShadowMaps(GpuResources& resources, ShadowMaps& shadow) {
+    resources.release(shadow.cascadeFbo);
+    resources.release(shadow.pointFbo);
+    resources.release(shadow.cascadeTexture);
+    resources.release(shadow.pointTexture);
+}
+
+// Cała paczka programów za uchwytami rejestru; przy przeładowaniu poprzednia paczka czeka na koniec klatki
+void adoptProgramBatch(GpuResources& resources, std::vector<ProgramHandle>& handles, const std::vector<GLuint>& programs) {
+    for (ProgramHandle& handle : handles)
+        resources.release(handle);
+    handles.clear();
+    for (unsigned i = 0; i < programs.size(); ++i)
+        handles.push_back(resources.adoptProgram(programs[i], i < COMPILED_VARIANT_COUNT ? "cube variant" : "scene program"));
+}
+
+// Reaguje tylko na moment wciśnięcia klawisza, nie na jego przytrzymanie
+bool keyToggled(const InputState& input, sf::Keyboard::Key key, bool& wasPressed) {
+    bool pressed = input.isKeyPressed(key);
+    bool toggled = pressed && !wasPressed;
+    wasPressed = pressed;
+    return toggled;
+}
+
+int main(int argc, char** argv) {
     sf::ContextSettings settings;
     settings.depthBits = 24;
     settings.stencilBits = 8;
     sf::Window window(sf::VideoMode(800, 600), "OpenGL Cube with Camera Controls", sf::Style::Close, settings);
-    window.setFramerateLimit(60);
+    // Synchronizacja z odświeżaniem zamiast setFramerateLimit (usypianie); --uncapped bez limitu do pomiarów
+    window.setVerticalSyncEnabled(parsePresentMode(argc, argv) == PresentMode::VSync);
     window.setMouseCursorGrabbed(true);
     window.setMouseCursorVisible(false);
 
@@ -153,58 +824,65 @@ int main() {
     };
 
 
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
-    checkShaderCompilation(vertexShader, "Vertex");
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
-    checkShaderCompilation(fragmentShader, "Fragment");
+    // Wszystkie obiekty GL sceny (geometria, tekstury, G-bufor, mapy cieni, bufory klastrów, programy) za
+    // uchwytami rejestru; programy z przeładowania usuwane są dopiero, gdy GPU skończy klatkę, która ich używała
+    GpuResources resources;
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glUseProgram(shaderProgram);
+    // Wszystkie warianty kompilowane raz przy starcie, przełączanie flag to tylko zmiana programu.
+    // Po edycji plików w shaders/ cała paczka kompiluje się w tle i jest podmieniana naraz.
+    AsyncShaderCompiler shaderCompiler;
+    ShaderFileWatcher shaderWatcher("shaders");
+    std::vector<ProgramDesc> shaderBatch;
+    std::vector<GLuint> programs;
+    if (!loadShaderPrograms(shaderBatch))
+        return -1;
+    shaderCompiler.submit(shaderBatch);
+    if (!shaderCompiler.finish(programs)) {
+        std::cerr << "Shader compilation failed" << std::endl;
+        return -1;
+    }
+    std::vector<ProgramHandle> programHandles;
+    adoptProgramBatch(resources, programHandles, programs);
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    ShaderVariant shaderVariants[VARIANT_COUNT];
+    makeShaderVariants(programs, shaderVariants);
+    DeferredPrograms deferred = makeDeferredPrograms(programs);
+    ClusteredProgram clustered = makeClusteredProgram(programs[PROGRAM_CLUSTERED]);
+    ShadowPrograms shadowPrograms = makeShadowPrograms(programs);
 
-    GLuint vao, vbo, ebo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    VertexArrayHandle vao = resources.createVertexArray("cube vao");
+    BufferHandle vbo = resources.createBuffer("cube vbo");
+    BufferHandle ebo = resources.createBuffer("cube ebo");
 
-    glBindVertexArray(vao);
+    glBindVertexArray(resources.get(vao));
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(vbo));
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    resources.setBytes(vbo, sizeof(vertices));
 
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.get(ebo));
    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    resources.setBytes(ebo, sizeof(indices));
 
-    GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
+    GLint posAttrib = 0;
     glEnableVertexAttribArray(posAttrib);
     glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)0);
 
-    GLint colAttrib = glGetAttribLocation(shaderProgram, "color");
+    GLint colAttrib = 1;
     glEnableVertexAttribArray(colAttrib);
     glVertexAttribPointer(colAttrib, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
 
-    GLint texAttrib = glGetAttribLocation(shaderProgram, "texCoord");
+    GLint texAttrib = 2;
     glEnableVertexAttribArray(texAttrib);
     glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
 
-    GLint NorAttrib = glGetAttribLocation(shaderProgram, "aNormal");
+    GLint NorAttrib = 3;
     glEnableVertexAttribArray(NorAttrib);
     glVertexAttribPointer(NorAttrib, 3,GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), (GLvoid*)(8 * sizeof(GLfloat)));
 
 
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    TextureHandle texture = resources.createTexture("metal.jpg");
+    glBindTexture(GL_TEXTURE_2D, resources.get(texture));
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -216,6 +894,7 @@ int main() {
     if (data) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        resources.setBytes(texture, (size_t)width * height * 3 * 4 / 3);
     }
     else {
         std::cerr << "Failed to load texture" << std::endl;
@@ -223,6 +902,67 @@ int main() {
     }
     stbi_image_free(data);
 
+    // Bryła światła ma osobny sześcian ze spójnym nawinięciem - ściany sześcianu sceny
+    // są nawinięte niejednolicie, a przy odrzucaniu przednich ścian liczy się kolejność
+    GLfloat volumeVertices[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+    };
+    GLuint volumeIndices[] = {
+        4, 5, 6, 4, 6, 7,
+        1, 0, 3, 1, 3, 2,
+        0, 4, 7, 0, 7, 3,
+        5, 1, 2, 5, 2, 6,
+        0, 1, 5, 0, 5, 4,
+        7, 6, 2, 7, 2, 3,
+    };
+
+    VertexArrayHandle volumeVao = resources.createVertexArray("light volume vao");
+    BufferHandle volumeVbo = resources.createBuffer("light volume vbo");
+    BufferHandle volumeEbo = resources.createBuffer("light volume ebo");
+    BufferHandle lightInstanceVbo = resources.createBuffer("light instances");
+
+    glBindVertexArray(resources.get(volumeVao));
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(volumeVbo));
+    glBufferData(GL_ARRAY_BUFFER, sizeof(volumeVertices), volumeVertices, GL_STATIC_DRAW);
+    resources.setBytes(volumeVbo, sizeof(volumeVertices));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.get(volumeEbo));
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(volumeIndices), volumeIndices, GL_STATIC_DRAW);
+    resources.setBytes(volumeEbo, sizeof(volumeIndices));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(lightInstanceVbo));
+    glBufferData(GL_ARRAY_BUFFER, MAX_LIGHTS * sizeof(LightInstance), NULL, GL_STREAM_DRAW);
+    resources.setBytes(lightInstanceVbo, MAX_LIGHTS * sizeof(LightInstance));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(LightInstance), (GLvoid*)offsetof(LightInstance, positionRadius));
+    glVertexAttribDivisor(4, 1);
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(LightInstance), (GLvoid*)offsetof(LightInstance, color));
+    glVertexAttribDivisor(5, 1);
+    glBindVertexArray(resources.get(vao));
+
+    GBuffer gbuffer;
+    if (!createGBuffer(resources, gbuffer, SCREEN_WIDTH, SCREEN_HEIGHT))
+        return -1;
+
+    ThreadPool threadPool;
+    ClusterGrid clusterGrid;
+    ClusterBuffers clusterBuffers;
+    createClusterBuffers(resources, clusterBuffers);
+
+    ShadowMaps shadowMaps;
+    if (!createShadowMaps(resources, shadowMaps))
+        return -1;
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, resources.get(shadowMaps.cascadeTexture));
+    glActiveTexture(GL_TEXTURE8);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, resources.get(shadowMaps.pointTexture));
+    glActiveTexture(GL_TEXTURE0);
+    float cascadeSplits[CASCADE_COUNT];
+    computeCascadeSplits(cascadeSplits);
+
     glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
     glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
     glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -236,64 +976,248 @@ int main() {
     float sensitivity = 0.1f;
     float speed = 2.5f;
 
-    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-    GLint uniProj = glGetUniformLocation(shaderProgram, "proj");
-    GLint uniView = glGetUniformLocation(shaderProgram, "view");
-    GLint uniModel = glGetUniformLocation(shaderProgram, "model");
+    // Ruch kamery i zmiany jasności w stałych krokach 1/60 s niezależnie od FPS.
+    // simCameraPos to stan symulacji, cameraPos - pozycja interpolowana między krokami, używana do rysowania.
+    FixedTimestep timestep(1.0 / 60.0);
+    glm::vec3 simCameraPos = cameraPos;
+    glm::vec3 previousCameraPos = cameraPos;
 
-    glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj));
+    glm::mat4 proj = glm::perspective(glm::radians(FIELD_OF_VIEW), (float)SCREEN_WIDTH / SCREEN_HEIGHT, NEAR_PLANE, FAR_PLANE);
 
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
     glm::vec3 ambientLightColor(1.0f, 1.0f, 1.0f);
     glm::vec3 diffuseLightColor(1.0f, 1.0f, 1.0f);
     float ambientStrength = 0.1f;
     float lightStrength = 1.0f;
+    const glm::vec3 sunBaseDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+    glm::vec3 sunDirection = sunBaseDirection;
+    glm::vec3 sunColor(0.5f, 0.48f, 0.45f);
+
+    unsigned features = DEFAULT_FEATURES;
+    // B: porównanie z dawnym shaderem rozgałęziającym się na uniformie lightingEnabled
+    bool dynamicBranch = false;
+    ShaderVariant* shader = nullptr;
+    // R: forward (jedno światło lightPos) -> deferred -> clustered forward+ (oba: lightPos + lightCount świateł)
+    Renderer renderer = Renderer::Forward;
+    int lightCount = 128;
+    std::vector<LightInstance> lights;
+    lights.reserve(MAX_LIGHTS);
+    // G: obracający się sześcian (geometria ruchoma), O: lightPos krąży, a słońce powoli się obraca.
+    // sceneVersion rośnie przy każdej zmianie geometrii - wtedy zapamiętane mapy cieni są nieaktualne.
+    bool rotateCube = false;
+    bool animateShadowLights = false;
+    unsigned sceneVersion = 0;
+    glm::mat4 cubeModel = glm::mat4(1.0f); // Brak obrotu
+
+    // Stan GL w pętli idzie przez cache: powtórzone wiązania i niezmienione uniformy (proj, kolory świateł
+    // ustawiane co klatkę w ścieżkach clustered i deferred) nie docierają do sterownika
+    GlStateCache state;
+    // Rysowania sceny idą przez kolejkę: od najbliższego obiektu, przebiegi bez wpisów przezroczystych
+    RenderQueue sceneQueue(1, NEAR_PLANE, FAR_PLANE);
+
+    // Każdy program ma własny stan uniformów, więc po przełączeniu wariantu trzeba go uzupełnić;
+    // przy powrocie do używanego już wariantu cache odfiltruje wartości, które się nie zmieniły
+    auto selectShaderVariant = [&]() {
+        shader = &shaderVariants[dynamicBranch ? features | FEATURE_DYNAMIC_BRANCH : features];
+        state.useProgram(shader->program);
+        state.uniformMatrix4fv(shader->uniProj, 1, glm::value_ptr(proj));
+        state.uniform3fv(shader->uniLightPos, 1, glm::value_ptr(lightPos));
+        state.uniform3fv(shader->uniAmbientLightColor, 1, glm::value_ptr(ambientLightColor));
+        state.uniform3fv(shader->uniDiffuseLightColor, 1, glm::value_ptr(diffuseLightColor));
+        state.uniform1f(shader->uniAmbientStrength, ambientStrength);
+        state.uniform1f(shader->uniLightStrength, lightStrength);
+        state.uniform3fv(shader->uniViewPos, 1, glm::value_ptr(cameraPos));
+        state.uniform1i(shader->uniLightingEnabled, (features & FEATURE_LIGHTING) ? 1 : 0);
+        state.uniform3fv(shader->uniSunColor, 1, glm::value_ptr(sunColor));
+    };
+    selectShaderVariant();
+
+    state.enable(GL_DEPTH_TEST);
+
+    // Czas rysowania na GPU (GL_TIME_ELAPSED); wynik czytany z opóźnieniem kilku klatek, żeby nie blokować potoku
+    const int TIMER_QUERY_COUNT = 4;
+    GLuint timerQueries[TIMER_QUERY_COUNT];
+    glGenQueries(TIMER_QUERY_COUNT, timerQueries);
+    // Osobny pierścień dla przebiegu cieni - zapytań GL_TIME_ELAPSED nie można zagnieżdżać
+    GLuint shadowQueries[TIMER_QUERY_COUNT];
+    glGenQueries(TIMER_QUERY_COUNT, shadowQueries);
+    GLuint64 shadowTimeSum = 0;
+    int shadowLookups = 0;
+    int shadowHits = 0;
+    int timerFrame = 0;
+    GLuint64 gpuTimeSum = 0;
+    int gpuTimeSamples = 0;
+    int skipTimeSamples = 0;
+    float cpuTimeSum = 0.0f;
+    double cullTimeSum = 0.0;
+    double uploadTimeSum = 0.0;
+    float lastTimeReport = 0.0f;
+    // P: pomiar czasu klatki dla 1, 2, 4 ... MAX_LIGHTS świateł w aktywnym trybie
+    const int SWEEP_SAMPLES = 60;
+    bool sweeping = false;
+
+    // Wyniki zapytań zlecone przed zmianą trybu dotyczą jeszcze poprzedniej konfiguracji
+    auto resetTimings = [&]() {
+        gpuTimeSum = 0;
+        gpuTimeSamples = 0;
+        cpuTimeSum = 0.0f;
+        cullTimeSum = 0.0;
+        uploadTimeSum = 0.0;
+        shadowTimeSum = 0;
+        shadowLookups = 0;
+        shadowHits = 0;
+        skipTimeSamples = TIMER_QUERY_COUNT;
+    };
+
+    // Scena wspólna dla obu ścieżek: sześcian i podłoga z tego samego VBO. eye i forward to punkt i kierunek
+    // patrzenia przebiegu (kamera, ściana mapy sześciennej, płaszczyzna bliska kaskady) - kolejka ustawia
+    // obiekty od najbliższego wzdłuż forward
+    auto drawScene = [&](GLuint program, GLint uniModel, const glm::vec3& eye, const glm::vec3& forward) {
+        DrawCommand command;
+        command.program = program;
+        command.vertexArray = resources.get(vao);
+        // Tekstura sceny wiązana jawnie na jednostce 0 - nie zależy od tego, co zostawiła konfiguracja
+        command.texture = resources.get(texture);
+        command.modelLocation = uniModel;
+        command.count = 36;
+        command.indexType = GL_UNSIGNED_INT;
+
+        sceneQueue.begin();
+        std::memcpy(command.model, glm::value_ptr(cubeModel), sizeof(command.model));
+        sceneQueue.push(0, RenderLayer::Opaque, glm::dot(glm::vec3(cubeModel[3]) - eye, forward), command);
+
+        glm::mat4 floorModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.55f, 0.0f));
+        floorModel = glm::scale(floorModel, glm::vec3(12.0f, 0.1f, 12.0f));
+        std::memcpy(command.model, glm::value_ptr(floorModel), sizeof(command.model));
+        sceneQueue.push(0, RenderLayer::Opaque, glm::dot(glm::vec3(floorModel[3]) - eye, forward), command);
+
+        sceneQueue.sort();
+        sceneQueue.submit(state);
+    };
 
-    GLint uniLightPos = glGetUniformLocation(shaderProgram, "lightPos");
-    GLint uniViewPos = glGetUniformLocation(shaderProgram, "viewPos");
-    GLint uniAmbientLightColor = glGetUniformLocation(shaderProgram, "ambientLightColor");
-    GLint uniDiffuseLightColor = glGetUniformLocation(shaderProgram, "diffuseLightColor");
-    GLint uniAmbientStrength = glGetUniformLocation(shaderProgram, "ambientStrength");
-    GLint uniLightStrength = glGetUniformLocation(shaderProgram, "lightStrength");
-    GLint uniLightingEnabled = glGetUniformLocation(shaderProgram, "lightingEnabled");
+    // Przerysowuje tylko te mapy cieni, których nie da się użyć z poprzednich klatek
+    auto renderShadowMaps = [&]() {
+        state.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+
+        state.bindFramebuffer(resources.get(shadowMaps.cascadeFbo));
+        state.viewport(0, 0, CASCADE_RESOLUTION, CASCADE_RESOLUTION);
+        state.useProgram(shadowPrograms.depth);
+        float sliceNear = NEAR_PLANE;
+        for (int i = 0; i < CASCADE_COUNT; ++i) {
+            ShadowSphere slice = frustumSliceSphere(sliceNear, cascadeSplits[i], cameraPos, cameraFront);
+            sliceNear = cascadeSplits[i];
+            Cascade& cascade = shadowMaps.cascades[i];
+            ++shadowLookups;
+            if (cascadeCovers(cascade, slice, sunDirection, sceneVersion)) {
+                ++shadowHits;
+                continue;
+            }
+            fitCascade(cascade, slice, sunDirection, sceneVersion);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, resources.get(shadowMaps.cascadeTexture), 0, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            state.uniformMatrix4fv(shadowPrograms.depthLightViewProj, 1, glm::value_ptr(cascade.viewProj));
+            // Kolejność wzdłuż słońca od płaszczyzny bliskiej kaskady, nie od kamery
+            glm::vec3 cascadeEye = cascade.center - sunDirection * (cascade.radius + CASCADE_CASTER_DISTANCE);
+            drawScene(shadowPrograms.depth, shadowPrograms.depthModel, cascadeEye, sunDirection);
+        }
 
-    glUniform3fv(uniLightPos, 1, glm::value_ptr(lightPos));
-    glUniform3fv(uniAmbientLightColor, 1, glm::value_ptr(ambientLightColor));
-    glUniform3fv(uniDiffuseLightColor, 1, glm::value_ptr(diffuseLightColor));
-    glUniform1f(uniAmbientStrength, ambientStrength);
-    glUniform1f(uniLightStrength, lightStrength);
-    glUniform3fv(uniViewPos, 1, glm::value_ptr(cameraPos));
-    glUniform1i(uniLightingEnabled, 1); 
+        ++shadowLookups;
+        if (shadowMaps.pointValid && shadowMaps.pointLightPos == lightPos && shadowMaps.pointSceneVersion == sceneVersion) {
+            ++shadowHits;
+        }
+        else {
+            const glm::vec3 faceDirections[6] = {
+                glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            };
+            const glm::vec3 faceUps[6] = {
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+                glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            };
+            glm::mat4 faceProj = glm::perspective(glm::radians(90.0f), 1.0f, POINT_SHADOW_NEAR, POINT_SHADOW_FAR);
+            state.bindFramebuffer(resources.get(shadowMaps.pointFbo));
+            state.viewport(0, 0, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION);
+            state.useProgram(shadowPrograms.point);
+            state.uniform3fv(shadowPrograms.pointLightPos, 1, glm::value_ptr(lightPos));
+            for (int face = 0; face < 6; ++face) {
+                glm::mat4 faceViewProj = faceProj * glm::lookAt(lightPos, lightPos + faceDirections[face], faceUps[face]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, resources.get(shadowMaps.pointTexture), 0);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                state.uniformMatrix4fv(shadowPrograms.pointLightViewProj, 1, glm::value_ptr(faceViewProj));
+                drawScene(shadowPrograms.point, shadowPrograms.pointModel, lightPos, faceDirections[face]);
+            }
+            shadowMaps.pointValid = true;
+            shadowMaps.pointLightPos = lightPos;
+            shadowMaps.pointSceneVersion = sceneVersion;
+        }
 
-    glEnable(GL_DEPTH_TEST);
+        state.disable(GL_POLYGON_OFFSET_FILL);
+        state.bindFramebuffer(0);
+        state.viewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+        state.useProgram(shader->program);
+    };
 
-    bool lightingEnabled = true;
+    // --record/--replay plik: wejście nagrywane lub odtwarzane klatka po klatce, --fixed-step stały krok.
+    // Animacje liczone są z sumy kroków wejścia, więc przy odtwarzaniu scena też jest identyczna.
+    InputState input(parseInputArgs(argc, argv), { sf::Keyboard::W, sf::Keyboard::S, sf::Keyboard::A, sf::Keyboard::D,
+        sf::Keyboard::Escape, sf::Keyboard::Z, sf::Keyboard::X, sf::Keyboard::C, sf::Keyboard::V,
+        sf::Keyboard::L, sf::Keyboard::T, sf::Keyboard::K, sf::Keyboard::H, sf::Keyboard::G, sf::Keyboard::O,
+        sf::Keyboard::B, sf::Keyboard::R, sf::Keyboard::Up, sf::Keyboard::Down, sf::Keyboard::P });
 
     sf::Clock clock;
     while (window.isOpen()) {
         sf::Event event;
         while (window.pollEvent(event)) {
+            input.handleEvent(event);
             if (event.type == sf::Event::Closed)
                 window.close();
         }
 
+        if (shaderWatcher.changed() && loadShaderPrograms(shaderBatch))
+            shaderCompiler.submit(shaderBatch);
+
+        std::vector<GLuint> reloadedPrograms;
+        if (shaderCompiler.poll(reloadedPrograms)) {
+            adoptProgramBatch(resources, programHandles, reloadedPrograms);
+            makeShaderVariants(reloadedPrograms, shaderVariants);
+            deferred = makeDeferredPrograms(reloadedPrograms);
+            clustered = makeClusteredProgram(reloadedPrograms[PROGRAM_CLUSTERED]);
+            shadowPrograms = makeShadowPrograms(reloadedPrograms);
+            invalidateShadowMaps(shadowMaps);
+            // make*Program wiążą programy bezpośrednio, a nazwy usuniętych programów mogą wrócić
+            state.invalidate();
+            selectShaderVariant();
+            std::cout << "Shaders reloaded" << std::endl;
+        }
+
         float currentFrame = clock.getElapsedTime().asSeconds();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::W))
-            cameraPos += speed * deltaTime * cameraFront;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::S))
-            cameraPos -= speed * deltaTime * cameraFront;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::A))
-            cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * speed * deltaTime;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))
-            cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * speed * deltaTime;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Escape)) {
+        if (!input.update(window, deltaTime)) {
+            window.close();
+            break;
+        }
+        int steps = timestep.advance(input.deltaTime());
+        for (int i = 0; i < steps; ++i) {
+            float step = timestep.step();
+            previousCameraPos = simCameraPos;
+            if (input.isKeyPressed(sf::Keyboard::W))
+                simCameraPos += speed * step * cameraFront;
+            if (input.isKeyPressed(sf::Keyboard::S))
+                simCameraPos -= speed * step * cameraFront;
+            if (input.isKeyPressed(sf::Keyboard::A))
+                simCameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * speed * step;
+            if (input.isKeyPressed(sf::Keyboard::D))
+                simCameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * speed * step;
+        }
+        cameraPos = interpolate(previousCameraPos, simCameraPos, timestep.alpha());
+        if (input.isKeyPressed(sf::Keyboard::Escape)) {
             window.close();
         }
 
-        sf::Vector2i mousePos = sf::Mouse::getPosition(window);
+        sf::Vector2i mousePos = input.mousePosition();
         if (firstMouse) {
             lastX = mousePos.x;
             lastY = mousePos.y;
@@ -323,65 +1247,284 @@ int main() {
         cameraFront = glm::normalize(front);
 
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
-        glUniform3fv(uniViewPos, 1, glm::value_ptr(cameraPos));
+        state.uniformMatrix4fv(shader->uniView, 1, glm::value_ptr(view));
+        state.uniform3fv(shader->uniViewPos, 1, glm::value_ptr(cameraPos));
 
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Z)) {
-            ambientStrength += 0.1f;
+        if (input.isKeyPressed(sf::Keyboard::Z)) {
+            ambientStrength += 0.1f * steps;
             if (ambientStrength > 1.0f) ambientStrength = 1.0f;
-            glUniform1f(uniAmbientStrength, ambientStrength);
+            state.uniform1f(shader->uniAmbientStrength, ambientStrength);
         }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::X)) {
-            ambientStrength -= 0.1f;
+        if (input.isKeyPressed(sf::Keyboard::X)) {
+            ambientStrength -= 0.1f * steps;
             if (ambientStrength < 0.0f) ambientStrength = 0.0f;
-            glUniform1f(uniAmbientStrength, ambientStrength);
+            state.uniform1f(shader->uniAmbientStrength, ambientStrength);
         }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::C)) {
-            lightStrength += 0.1f;
+        if (input.isKeyPressed(sf::Keyboard::C)) {
+            lightStrength += 0.1f * steps;
             if (lightStrength > 2.0f) lightStrength = 2.0f;
-            glUniform1f(uniLightStrength, lightStrength);
+            state.uniform1f(shader->uniLightStrength, lightStrength);
         }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::V)) {
-           lightStrength -= 0.1f;
+        if (input.isKeyPressed(sf::Keyboard::V)) {
+           lightStrength -= 0.1f * steps;
             if (lightStrength < 0.0f) lightStrength = 0.0f;
-            glUniform1f(uniLightStrength, lightStrength);
+            state.uniform1f(shader->uniLightStrength, lightStrength);
         }
 
-        static bool keyPressed = false;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::L)) { 
-            if (!keyPressed) { 
-                lightingEnabled = !lightingEnabled; 
-                glUniform1i(uniLightingEnabled, lightingEnabled ? 1 : 0); 
-                keyPressed = true;  
-            }
+        static bool lightingKeyPressed = false;
+        static bool textureKeyPressed = false;
+        static bool colorKeyPressed = false;
+        static bool branchKeyPressed = false;
+        static bool rendererKeyPressed = false;
+        static bool moreLightsKeyPressed = false;
+        static bool fewerLightsKeyPressed = false;
+        static bool sweepKeyPressed = false;
+        static bool shadowKeyPressed = false;
+        static bool rotateKeyPressed = false;
+        static bool orbitKeyPressed = false;
+        unsigned previousFeatures = features;
+        bool previousDynamicBranch = dynamicBranch;
+        if (keyToggled(input, sf::Keyboard::L, lightingKeyPressed))
+            features = toggleFeature(features, FEATURE_LIGHTING);
+        if (keyToggled(input, sf::Keyboard::T, textureKeyPressed))
+            features = toggleFeature(features, FEATURE_TEXTURE);
+        if (keyToggled(input, sf::Keyboard::K, colorKeyPressed))
+            features = toggleFeature(features, FEATURE_VERTEX_COLOR);
+        if (keyToggled(input, sf::Keyboard::H, shadowKeyPressed))
+            features = toggleFeature(features, FEATURE_SHADOWS);
+        if (keyToggled(input, sf::Keyboard::G, rotateKeyPressed))
+            rotateCube = !rotateCube;
+        if (keyToggled(input, sf::Keyboard::O, orbitKeyPressed))
+            animateShadowLights = !animateShadowLights;
+        if (keyToggled(input, sf::Keyboard::B, branchKeyPressed))
+            dynamicBranch = !dynamicBranch;
+
+        int previousLightCount = lightCount;
+        Renderer previousRenderer = renderer;
+        bool sweepStarted = false;
+        if (keyToggled(input, sf::Keyboard::R, rendererKeyPressed))
+            renderer = renderer == Renderer::Forward ? Renderer::Deferred :
+                renderer == Renderer::Deferred ? Renderer::Clustered : Renderer::Forward;
+        if (keyToggled(input, sf::Keyboard::Up, moreLightsKeyPressed) && lightCount < MAX_LIGHTS)
+            lightCount *= 2;
+        if (keyToggled(input, sf::Keyboard::Down, fewerLightsKeyPressed) && lightCount > 1)
+            lightCount /= 2;
+        if (keyToggled(input, sf::Keyboard::P, sweepKeyPressed)) {
+            sweeping = true;
+            sweepStarted = true;
+            lightCount = 1;
+            std::cout << rendererName(renderer) << " light sweep:" << std::endl;
         }
-        else {
-            keyPressed = false;     
+
+        if (features != previousFeatures || dynamicBranch != previousDynamicBranch) {
+            selectShaderVariant();
+            state.uniformMatrix4fv(shader->uniView, 1, glm::value_ptr(view));
         }
+        if (features != previousFeatures || dynamicBranch != previousDynamicBranch ||
+            lightCount != previousLightCount || renderer != previousRenderer || sweepStarted)
+            resetTimings();
 
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        float time = (float)input.elapsed();
 
-        float time = clock.getElapsedTime().asSeconds();
-        glm::mat4 model = glm::mat4(1.0f); // Brak obrotu
-      // glm::mat4 model = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
+        if (rotateCube) {
+            cubeModel = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0f, 1.0f, 0.0f));
+            ++sceneVersion;
+        }
+        if (animateShadowLights) {
+            lightPos = glm::vec3(cos(time * 0.7f) * 2.3f, 1.0f, sin(time * 0.7f) * 2.3f);
+            sunDirection = glm::vec3(glm::rotate(glm::mat4(1.0f), time * 0.1f, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(sunBaseDirection, 0.0f));
+            state.uniform3fv(shader->uniLightPos, 1, glm::value_ptr(lightPos));
+        }
+
+        GLuint timerQuery = timerQueries[timerFrame % TIMER_QUERY_COUNT];
+        GLuint shadowQuery = shadowQueries[timerFrame % TIMER_QUERY_COUNT];
+        if (timerFrame >= TIMER_QUERY_COUNT) {
+            GLuint64 elapsedNs = 0;
+            GLuint64 shadowNs = 0;
+            glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsedNs);
+            glGetQueryObjectui64v(shadowQuery, GL_QUERY_RESULT, &shadowNs);
+            if (skipTimeSamples > 0) {
+                --skipTimeSamples;
+            }
+            else {
+                gpuTimeSum += elapsedNs;
+                shadowTimeSum += shadowNs;
+                cpuTimeSum += deltaTime;
+                ++gpuTimeSamples;
+            }
+        }
+
+        // Etapy CPU ścieżki clustered liczone przed zapytaniem GPU, które obejmuje tylko rysowanie
+        if (renderer == Renderer::Clustered) {
+            animateLights(lights, lightCount, time);
+            auto cullStart = std::chrono::steady_clock::now();
+            buildClusters(clusterGrid, lights, view, proj, threadPool);
+            auto uploadStart = std::chrono::steady_clock::now();
+            uploadClusterBuffers(resources, clusterBuffers, clusterGrid);
+            auto uploadEnd = std::chrono::steady_clock::now();
+            if (skipTimeSamples == 0) {
+                cullTimeSum += std::chrono::duration<double, std::milli>(uploadStart - cullStart).count();
+                uploadTimeSum += std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count();
+            }
+        }
+
+        // Cienie tylko w ścieżce forward i tylko gdy wariant z nich korzysta; zapytanie zamykane także wtedy,
+        // gdy przebieg jest pusty
+        bool shadowsActive = renderer == Renderer::Forward && (canonicalFeatures(features) & FEATURE_SHADOWS);
+        glBeginQuery(GL_TIME_ELAPSED, shadowQuery);
+        if (shadowsActive)
+            renderShadowMaps();
+        glEndQuery(GL_TIME_ELAPSED);
+
+        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+        if (renderer == Renderer::Forward) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (shadowsActive) {
+                glm::mat4 cascadeViewProj[CASCADE_COUNT];
+                for (int i = 0; i < CASCADE_COUNT; ++i)
+                    cascadeViewProj[i] = shadowMaps.cascades[i].viewProj;
+                state.uniformMatrix4fv(shader->uniCascadeViewProj, CASCADE_COUNT, glm::value_ptr(cascadeViewProj[0]));
+                state.uniform1fv(shader->uniCascadeSplits, CASCADE_COUNT, cascadeSplits);
+                state.uniform3fv(shader->uniSunDirection, 1, glm::value_ptr(sunDirection));
+            }
+            drawScene(shader->program, shader->uniModel, cameraPos, cameraFront);
+        }
+        else if (renderer == Renderer::Clustered) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int i = 0; i < 3; ++i)
+                state.bindTexture(4 + i, GL_TEXTURE_BUFFER, resources.get(clusterBuffers.textures[i]));
+
+            state.useProgram(clustered.program);
+            state.uniformMatrix4fv(clustered.uniView, 1, glm::value_ptr(view));
+            state.uniformMatrix4fv(clustered.uniProj, 1, glm::value_ptr(proj));
+            state.uniform3fv(clustered.uniLightPos, 1, glm::value_ptr(lightPos));
+            state.uniform3fv(clustered.uniAmbientLightColor, 1, glm::value_ptr(ambientLightColor));
+            state.uniform3fv(clustered.uniDiffuseLightColor, 1, glm::value_ptr(diffuseLightColor));
+            state.uniform1f(clustered.uniAmbientStrength, ambientStrength);
+            state.uniform1f(clustered.uniLightStrength, lightStrength);
+            state.uniform1i(clustered.uniLightingEnabled, (features & FEATURE_LIGHTING) ? 1 : 0);
+            drawScene(clustered.program, clustered.uniModel, cameraPos, cameraFront);
+            state.useProgram(shader->program);
+        }
+        else {
+            animateLights(lights, lightCount, time);
+            glm::mat4 viewProj = proj * view;
+            glm::mat4 invViewProj = glm::inverse(viewProj);
+
+            // Przebieg geometrii: albedo i normalne do G-bufora
+            state.bindFramebuffer(resources.get(gbuffer.fbo));
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            state.useProgram(deferred.gbuffer);
+            state.uniformMatrix4fv(deferred.gbufferView, 1, glm::value_ptr(view));
+            state.uniformMatrix4fv(deferred.gbufferProj, 1, glm::value_ptr(proj));
+            drawScene(deferred.gbuffer, deferred.gbufferModel, cameraPos, cameraFront);
+            state.bindFramebuffer(0);
+
+            state.bindTexture(1, GL_TEXTURE_2D, resources.get(gbuffer.albedo));
+            state.bindTexture(2, GL_TEXTURE_2D, resources.get(gbuffer.normal));
+            state.bindTexture(3, GL_TEXTURE_2D, resources.get(gbuffer.depth));
+
+            // Ambient i główne światło lightPos pełnoekranowo, tak jak w ścieżce forward
+            glClear(GL_COLOR_BUFFER_BIT);
+            state.disable(GL_DEPTH_TEST);
+            state.useProgram(deferred.ambient);
+            state.uniformMatrix4fv(deferred.ambientInvViewProj, 1, glm::value_ptr(invViewProj));
+            state.uniform3fv(deferred.ambientLightPos, 1, glm::value_ptr(lightPos));
+            state.uniform3fv(deferred.ambientAmbientLightColor, 1, glm::value_ptr(ambientLightColor));
+            state.uniform3fv(deferred.ambientDiffuseLightColor, 1, glm::value_ptr(diffuseLightColor));
+            state.uniform1f(deferred.ambientAmbientStrength, ambientStrength);
+            state.uniform1f(deferred.ambientLightStrength, lightStrength);
+            state.uniform1i(deferred.ambientLightingEnabled, (features & FEATURE_LIGHTING) ? 1 : 0);
+            state.bindVertexArray(resources.get(volumeVao));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            // Bryły świateł sumowane addytywnie; tylne ściany, żeby działało też z kamerą wewnątrz bryły
+            if (features & FEATURE_LIGHTING) {
+                state.bindBuffer(GL_ARRAY_BUFFER, resources.get(lightInstanceVbo));
+                glBufferSubData(GL_ARRAY_BUFFER, 0, lights.size() * sizeof(LightInstance), lights.data());
+                state.enable(GL_BLEND);
+                state.blendFunc(GL_ONE, GL_ONE);
+                state.enable(GL_CULL_FACE);
+                state.cullFace(GL_FRONT);
+                state.useProgram(deferred.light);
+                state.uniformMatrix4fv(deferred.lightView, 1, glm::value_ptr(view));
+                state.uniformMatrix4fv(deferred.lightProj, 1, glm::value_ptr(proj));
+                state.uniformMatrix4fv(deferred.lightInvViewProj, 1, glm::value_ptr(invViewProj));
+                state.uniform1f(deferred.lightLightStrength, lightStrength);
+                glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, lightCount);
+                state.disable(GL_CULL_FACE);
+                state.disable(GL_BLEND);
+            }
 
-       
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(vao);
+            state.enable(GL_DEPTH_TEST);
+            state.useProgram(shader->program);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        ++timerFrame;
+
+        if (sweeping && gpuTimeSamples >= SWEEP_SAMPLES) {
+            std::cout << "  lights=" << lightCount;
+            if (renderer == Renderer::Clustered)
+                std::cout << " cull: " << cullTimeSum / gpuTimeSamples << " ms upload: " << uploadTimeSum / gpuTimeSamples << " ms";
+            std::cout << " gpu: " << gpuTimeSum / gpuTimeSamples / 1.0e6
+                << " ms cpu frame: " << cpuTimeSum / gpuTimeSamples * 1000.0f << " ms" << std::endl;
+            if (lightCount < MAX_LIGHTS)
+                lightCount *= 2;
+            else
+                sweeping = false;
+            resetTimings();
+        }
+        else if (!sweeping && currentFrame - lastTimeReport >= 1.0f && gpuTimeSamples > 0) {
+            if (renderer == Renderer::Deferred)
+                std::cout << "deferred lights=" << lightCount;
+            else if (renderer == Renderer::Clustered)
+                std::cout << "clustered lights=" << lightCount << " cull: " << cullTimeSum / gpuTimeSamples
+                    << " ms upload: " << uploadTimeSum / gpuTimeSamples << " ms";
+            else {
+                std::cout << "forward " << (dynamicBranch ? "uniform branch" : "permutation") << " [features=" << features << "]";
+                if (shadowsActive)
+                    std::cout << " shadow: " << shadowTimeSum / gpuTimeSamples / 1.0e6 << " ms cache hits: "
+                        << (shadowLookups > 0 ? 100 * shadowHits / shadowLookups : 0) << "%";
+            }
+            std::cout << " gpu: " << gpuTimeSum / gpuTimeSamples / 1.0e6 << " ms cpu frame: "
+                << cpuTimeSum / gpuTimeSamples * 1000.0f << " ms" << std::endl;
+            state.report(std::cout);
+            gpuTimeSum = 0;
+            gpuTimeSamples = 0;
+            cpuTimeSum = 0.0f;
+            cullTimeSum = 0.0;
+            uploadTimeSum = 0.0;
+            shadowTimeSum = 0;
+            shadowLookups = 0;
+            shadowHits = 0;
+            lastTimeReport = currentFrame;
+        }
 
         window.display();
+        resources.endFrame();
+        state.endFrame();
     }
 
-    glDeleteTextures(1, &texture);
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ebo);
+    glDeleteQueries(TIMER_QUERY_COUNT, timerQueries);
+    glDeleteQueries(TIMER_QUERY_COUNT, shadowQueries);
+    for (ProgramHandle& handle : programHandles)
+        resources.release(handle);
+    releaseShadowMaps(resources, shadowMaps);
+    releaseGBuffer(resources, gbuffer);
+    releaseClusterBuffers(resources, clusterBuffers);
+    resources.release(volumeVao);
+    resources.release(volumeVbo);
+    resources.release(volumeEbo);
+    resources.release(lightInstanceVbo);
+    resources.release(texture);
+    resources.release(vao);
+    resources.release(vbo);
+    resources.release(ebo);
 
     return 0;
 }
@@ -0,0 +1,55 @@
+#version 330 core
+in vec3 Normal;
+in vec2 TexCoord;
+in vec3 FragPos;
+in float ViewDepth;
+out vec4 outColor;
+
+uniform sampler2D texture1;
+uniform vec3 lightPos;
+uniform vec3 ambientLightColor;
+uniform vec3 diffuseLightColor;
+uniform float ambientStrength;
+uniform float lightStrength;
+uniform bool lightingEnabled;
+
+// Swiatla po 2 teksele (pozycja+promien, kolor), komorki (offset, liczba) i lista indeksow swiatel
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterCells;
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterDims;
+uniform vec2 tileSize;
+uniform float clusterNear;
+uniform float sliceScale;
+
+void main() {
+    vec3 ambient = ambientStrength * ambientLightColor;
+    vec3 diffuse = vec3(0.0);
+    if (lightingEnabled) {
+        vec3 norm = normalize(Normal);
+        vec3 lightDir = normalize(lightPos - FragPos);
+        diffuse = max(dot(norm, lightDir), 0.0) * diffuseLightColor * lightStrength;
+
+        ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / tileSize), int(log(ViewDepth / clusterNear) * sliceScale));
+        cluster = clamp(cluster, ivec3(0), clusterDims - 1);
+        int clusterIndex = (cluster.z * clusterDims.y + cluster.y) * clusterDims.x + cluster.x;
+        uvec2 cell = texelFetch(clusterCells, clusterIndex).xy;
+
+        for (uint i = 0u; i < cell.y; ++i) {
+            int light = int(texelFetch(lightIndices, int(cell.x + i)).r);
+            vec4 positionRadius = texelFetch(lightData, light * 2);
+            vec3 color = texelFetch(lightData, light * 2 + 1).rgb;
+
+            vec3 toLight = positionRadius.xyz - FragPos;
+            float dist = length(toLight);
+            if (dist >= positionRadius.w)
+                continue;
+            float attenuation = 1.0 - dist / positionRadius.w;
+            attenuation *= attenuation;
+            diffuse += max(dot(norm, toLight / dist), 0.0) * color * attenuation * lightStrength;
+        }
+    }
+
+    vec3 lighting = ambient + diffuse;
+    outColor = vec4(lighting, 1.0) * texture(texture1, TexCoord);
+}
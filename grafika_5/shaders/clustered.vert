@@ -0,0 +1,24 @@
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec3 aNormal;
+
+out vec3 Normal;
+out vec2 TexCoord;
+out vec3 FragPos;
+out float ViewDepth;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+
+void main() {
+    vec4 worldPos = model * vec4(position, 1.0);
+    vec4 viewPos = view * worldPos;
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    TexCoord = texCoord;
+    FragPos = worldPos.xyz;
+    ViewDepth = -viewPos.z;
+    gl_Position = proj * viewPos;
+}
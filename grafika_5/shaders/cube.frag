@@ -0,0 +1,77 @@
+in vec3 Color;
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragPos;
+out vec4 outColor;
+uniform sampler2D texture1;
+uniform vec3 lightPos;          
+uniform vec3 viewPos;           
+uniform vec3 ambientLightColor; 
+uniform vec3 diffuseLightColor; 
+uniform float ambientStrength;  
+uniform float lightStrength; 
+#ifdef DYNAMIC_BRANCH
+uniform bool lightingEnabled;
+#endif
+
+#ifdef SHADOWS
+// Musi sie zgadzac z CASCADE_COUNT po stronie C++
+#define CASCADE_COUNT 3
+in float ViewDepth;
+uniform sampler2DArrayShadow cascadeShadowMap;
+uniform samplerCubeShadow pointShadowMap;
+uniform mat4 cascadeViewProj[CASCADE_COUNT];
+uniform float cascadeSplits[CASCADE_COUNT];
+uniform vec3 sunDirection;
+uniform vec3 sunColor;
+uniform float pointShadowFar;
+
+float cascadeShadow(vec3 norm) {
+    int cascade = 0;
+    while (cascade < CASCADE_COUNT && ViewDepth > cascadeSplits[cascade])
+        ++cascade;
+    if (cascade == CASCADE_COUNT)
+        return 1.0;
+    vec4 lightSpace = cascadeViewProj[cascade] * vec4(FragPos + norm * 0.02, 1.0);
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    return texture(cascadeShadowMap, vec4(coords.xy, float(cascade), coords.z - 0.001));
+}
+
+// Mapa szescienna przechowuje odleglosc od swiatla podzielona przez pointShadowFar
+float pointShadow() {
+    vec3 toFrag = FragPos - lightPos;
+    return texture(pointShadowMap, vec4(toFrag, length(toFrag) / pointShadowFar - 0.005));
+}
+#endif
+
+void main() {
+
+    vec3 ambient = ambientStrength * ambientLightColor;
+    vec3 diffuse = vec3(0.0);
+#if defined(LIGHTING) || defined(DYNAMIC_BRANCH)
+#ifdef DYNAMIC_BRANCH
+    if (lightingEnabled)
+#endif
+    {
+        vec3 norm = normalize(Normal);
+        vec3 lightDir = normalize(lightPos - FragPos);
+        float diff = max(dot(norm, lightDir), 0.0);
+        diffuse = diff * diffuseLightColor * lightStrength;
+#ifdef SHADOWS
+        diffuse *= pointShadow();
+        float sunDiff = max(dot(norm, -sunDirection), 0.0);
+        diffuse += sunDiff * sunColor * lightStrength * cascadeShadow(norm);
+#endif
+    }
+#endif
+
+   vec3 lighting = (ambient + diffuse);
+   vec4 texColor = vec4(1.0);
+#ifdef TEXTURE
+   texColor = texture(texture1, TexCoord);
+#endif
+#ifdef VERTEX_COLOR
+   texColor.rgb *= Color;
+#endif
+   outColor = vec4(lighting, 1.0) * texColor;
+}
@@ -0,0 +1,29 @@
+in vec3 position;
+in vec3 color;
+in vec2 texCoord;
+in vec3 aNormal;
+
+out vec3 Normal;
+out vec2 TexCoord;
+out vec3 Color;
+out vec3 FragPos;
+#ifdef SHADOWS
+out float ViewDepth;
+#endif
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+
+void main() {
+#if defined(LIGHTING) || defined(DYNAMIC_BRANCH)
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    FragPos = vec3(model * vec4(position, 1.0));
+#endif
+#ifdef SHADOWS
+    ViewDepth = -(view * model * vec4(position, 1.0)).z;
+#endif
+    Color = color;
+    TexCoord = texCoord;
+    gl_Position = proj * view * model * vec4(position, 1.0);
+}
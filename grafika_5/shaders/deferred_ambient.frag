@@ -0,0 +1,36 @@
+#version 330 core
+out vec4 outColor;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 invViewProj;
+uniform vec2 screenSize;
+
+uniform vec3 lightPos;
+uniform vec3 ambientLightColor;
+uniform vec3 diffuseLightColor;
+uniform float ambientStrength;
+uniform float lightStrength;
+uniform bool lightingEnabled;
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(gDepth, uv).r;
+    if (depth == 1.0)
+        discard;
+
+    vec4 world = invViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+    vec3 albedo = texture(gAlbedo, uv).rgb;
+
+    // To samo co w cube.frag, zeby przy zerowej liczbie swiatel obraz byl identyczny
+    vec3 ambient = ambientStrength * ambientLightColor;
+    vec3 diffuse = vec3(0.0);
+    if (lightingEnabled) {
+        vec3 norm = normalize(texture(gNormal, uv).xyz);
+        vec3 lightDir = normalize(lightPos - fragPos);
+        diffuse = max(dot(norm, lightDir), 0.0) * diffuseLightColor * lightStrength;
+    }
+    outColor = vec4((ambient + diffuse) * albedo, 1.0);
+}
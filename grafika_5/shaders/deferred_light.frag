@@ -0,0 +1,30 @@
+#version 330 core
+flat in vec4 LightPosRadius;
+flat in vec3 LightColor;
+out vec4 outColor;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 invViewProj;
+uniform vec2 screenSize;
+uniform float lightStrength;
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(gDepth, uv).r;
+    if (depth == 1.0)
+        discard;
+
+    vec4 world = invViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 toLight = LightPosRadius.xyz - world.xyz / world.w;
+    float dist = length(toLight);
+    if (dist >= LightPosRadius.w)
+        discard;
+
+    float attenuation = 1.0 - dist / LightPosRadius.w;
+    attenuation *= attenuation;
+    vec3 norm = normalize(texture(gNormal, uv).xyz);
+    float diff = max(dot(norm, toLight / dist), 0.0);
+    outColor = vec4(texture(gAlbedo, uv).rgb * LightColor * diff * attenuation * lightStrength, 1.0);
+}
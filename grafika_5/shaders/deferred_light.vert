@@ -0,0 +1,18 @@
+#version 330 core
+// Bryla swiatla: szescian opisany na kuli zasiegu, jedna instancja na swiatlo
+layout(location = 0) in vec3 position;
+layout(location = 4) in vec4 lightPosRadius;
+layout(location = 5) in vec3 lightColor;
+
+flat out vec4 LightPosRadius;
+flat out vec3 LightColor;
+
+uniform mat4 view;
+uniform mat4 proj;
+
+void main() {
+    LightPosRadius = lightPosRadius;
+    LightColor = lightColor;
+    vec3 world = lightPosRadius.xyz + position * 2.0 * lightPosRadius.w;
+    gl_Position = proj * view * vec4(world, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+in vec3 Normal;
+in vec2 TexCoord;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec3 outNormal;
+
+uniform sampler2D texture1;
+
+void main() {
+    outAlbedo = vec4(texture(texture1, TexCoord).rgb, 1.0);
+    outNormal = normalize(Normal);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec3 aNormal;
+
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+
+void main() {
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    TexCoord = texCoord;
+    gl_Position = proj * view * model * vec4(position, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPos;
+uniform float pointShadowFar;
+
+// Liniowa odleglosc zamiast glebi z rzutowania, zeby kazda sciana mapy porownywala to samo
+void main() {
+    gl_FragDepth = length(FragPos - lightPos) / pointShadowFar;
+}
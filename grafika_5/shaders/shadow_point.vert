@@ -0,0 +1,13 @@
+#version 330 core
+layout(location = 0) in vec3 position;
+
+out vec3 FragPos;
+
+uniform mat4 model;
+uniform mat4 lightViewProj;
+
+void main() {
+    vec4 worldPos = model * vec4(position, 1.0);
+    FragPos = worldPos.xyz;
+    gl_Position = lightViewProj * worldPos;
+}
@@ -8,6 +8,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "../common/profiler.h"
+#include "../common/input_state.h"
+#include "../common/gl_state_cache.h"
+#include "../common/gpu_resources.h"
 
 using namespace std;
 
@@ -113,7 +117,7 @@ GLuint createShader(GLenum shaderType, const char* source) {
     return shader;
 }
 
-int main() {
+int main(int argc, char** argv) {
     sf::ContextSettings settings;
     settings.depthBits = 24;
     settings.stencilBits = 8;
@@ -132,7 +136,8 @@ int main() {
     float cameraSpeed = 0.1f;
     float sensitivity = 0.08f;
     float obrot = 0.0f;
-    sf::Vector2i lastMousePos = sf::Mouse::getPosition(window);
+    sf::Vector2i lastMousePos;
+    bool firstMouse = true;
 
 
     glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f); //
@@ -147,10 +152,19 @@ int main() {
     glCompileShader(fragmentShader);
     check_Shader(fragmentShader, "Fragment");
 
+    // Obiekty GL za uchwytami rejestru - zwalniane na końcu, a pominięte wypisywane jako wycieki
+    GpuResources resources;
+
     GLuint shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glLinkProgram(shaderProgram);
+    // Po linkowaniu shadery nie są już potrzebne
+    glDetachShader(shaderProgram, vertexShader);
+    glDetachShader(shaderProgram, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    ProgramHandle program = resources.adoptProgram(shaderProgram, "model program");
     glUseProgram(shaderProgram);
 
 
@@ -165,13 +179,13 @@ int main() {
         }
     }
 
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    VertexArrayHandle VAO = resources.createVertexArray("model vao");
+    BufferHandle VBO = resources.createBuffer("model vbo");
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindVertexArray(resources.get(VAO));
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(VBO));
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    resources.setBytes(VBO, vertices.size() * sizeof(float));
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -192,75 +206,117 @@ int main() {
 
 
     GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+    GLint uniView = glGetUniformLocation(shaderProgram, "view");
+    GLint uniModel = glGetUniformLocation(shaderProgram, "model");
+
+    // Program, VAO i niezmienione uniformy (projection, model) wysyłane tylko przy faktycznej zmianie
+    GlStateCache state;
+
+    // Strefy profilera; F12 zapisuje 120 klatek do trace.json (chrome://tracing)
+    Profiler profiler;
+    const int inputZone = profiler.zone("input");
+    const int drawZone = profiler.zone("draw");
+    const int sceneGpuZone = profiler.zone("scene", true);
+    const int presentZone = profiler.zone("present");
 
+    // --record/--replay plik: wejście nagrywane lub odtwarzane klatka po klatce, --fixed-step stały krok
+    InputState input(parseInputArgs(argc, argv), { sf::Keyboard::W, sf::Keyboard::S, sf::Keyboard::A, sf::Keyboard::D,
+        sf::Keyboard::Q, sf::Keyboard::E, sf::Keyboard::Right, sf::Keyboard::Left });
 
     bool running = true;
     while (running) {
+        profiler.beginFrame();
 
         elapsed = clock.restart(); 
         float deltaTime = elapsed.asSeconds();
-        float cameraSpeed = 2.5f * deltaTime;
 
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) running = false;
-            if (event.type == sf::Event::KeyPressed) {
-                if (event.key.code == sf::Keyboard::Escape) running = false;
+        {
+            CpuProfileScope inputScope(profiler, inputZone);
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                input.handleEvent(event);
+                if (event.type == sf::Event::Closed) running = false;
+                if (event.type == sf::Event::KeyPressed) {
+                    if (event.key.code == sf::Keyboard::Escape) running = false;
+                    if (event.key.code == sf::Keyboard::F12) profiler.captureTrace("trace.json", 120);
+                }
             }
-        }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::W)) cameraPos += cameraSpeed * cameraFront;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) cameraPos -= cameraSpeed * cameraFront;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::A)) cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))  cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Q))  cameraPos.y += cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::E))  cameraPos.y -= cameraSpeed;
+            // Ruch kamery tylko ze stanu wejścia - przy odtwarzaniu pochodzi z nagrania
+            if (!input.update(window, deltaTime)) running = false;
+            float cameraSpeed = 2.5f * input.deltaTime();
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))  obrot -= cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))  obrot += cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::W)) cameraPos += cameraSpeed * cameraFront;
+            if (input.isKeyPressed(sf::Keyboard::S)) cameraPos -= cameraSpeed * cameraFront;
+            if (input.isKeyPressed(sf::Keyboard::A)) cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::D))  cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::Q))  cameraPos.y += cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::E))  cameraPos.y -= cameraSpeed;
 
+            if (input.isKeyPressed(sf::Keyboard::Right))  obrot -= cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::Left))  obrot += cameraSpeed;
 
-        sf::Vector2i mousePos = sf::Mouse::getPosition(window);
-        float xOffset = (mousePos.x - lastMousePos.x) * sensitivity;
-        float yOffset = (lastMousePos.y - mousePos.y) * sensitivity;
-        lastMousePos = mousePos;
 
-        yaw += xOffset;
-        pitch += yOffset;
+            sf::Vector2i mousePos = input.mousePosition();
+            if (firstMouse) {
+                lastMousePos = mousePos;
+                firstMouse = false;
+            }
+            float xOffset = (mousePos.x - lastMousePos.x) * sensitivity;
+            float yOffset = (lastMousePos.y - mousePos.y) * sensitivity;
+            lastMousePos = mousePos;
 
+            yaw += xOffset;
+            pitch += yOffset;
 
-        if (pitch > 89.0f) pitch = 89.0f;
-        if (pitch < -89.0f) pitch = -89.0f;
 
+            if (pitch > 89.0f) pitch = 89.0f;
+            if (pitch < -89.0f) pitch = -89.0f;
 
-        cameraFront.x = cos(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
-        cameraFront.y = sin(glm::radians(pitch));
-        cameraFront.z = sin(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
-        cameraFront = glm::normalize(cameraFront);
 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(proj));
+            cameraFront.x = cos(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
+            cameraFront.y = sin(glm::radians(pitch));
+            cameraFront.z = sin(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
+            cameraFront = glm::normalize(cameraFront);
+        }
+
+        {
+            CpuProfileScope drawScope(profiler, drawZone);
+            GpuProfileScope sceneScope(profiler, sceneGpuZone);
+            state.useProgram(shaderProgram);
+            state.uniformMatrix4fv(projectionLoc, 1, glm::value_ptr(proj));
 
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        GLint uniView = glGetUniformLocation(shaderProgram, "view");
-        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+            glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+            state.uniformMatrix4fv(uniView, 1, glm::value_ptr(view));
 
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindVertexArray(VAO);
-       // glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.2f, 0.2f));
-        GLint uniModel = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 3);
+            state.bindVertexArray(resources.get(VAO));
+           // glm::mat4 model = glm::mat4(1.0f);
+            glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.2f, 0.2f));
+            state.uniformMatrix4fv(uniModel, 1, glm::value_ptr(model));
+            glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 3);
+        }
 
-        float fps = 1.0f / deltaTime;
-        window.display();
+        {
+            CpuProfileScope presentScope(profiler, presentZone);
+            window.display();
+        }
+        resources.endFrame();
+
+        profiler.endFrame();
+        state.endFrame();
+        if (profiler.reportDue()) {
+            profiler.report(cout);
+            state.report(cout);
+            resources.report(cout);
+        }
     }
 
-    glDeleteProgram(shaderProgram);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    resources.release(program);
+    resources.release(VAO);
+    resources.release(VBO);
 
     return 0;
 }
@@ -11,118 +11,20 @@
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "../common/shader_reload.h"
+#include "../common/profiler.h"
+#include "../common/obj_model.h"
+#include "../common/mesh_normals.h"
+#include "../common/input_state.h"
+#include "../common/upload_scheduler.h"
+#include "../common/chunk_pager.h"
+#include "../common/gpu_resources.h"
+#include "../common/gl_state_cache.h"
+#include "../common/render_queue.h"
+#include <memory>
 using namespace std;
 
 
-const char* vertexSource = R"(
-    #version 330 core
-    layout(location = 0) in vec3 aPos;
-    layout(location = 1) in vec3 aNormal;
-    layout(location = 2) in vec2 aTexCoord;
-
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
-
-    out vec3 FragPos;
-    out vec3 Normal;
-    out vec2 TexCoord;
-
-    void main() {
-        FragPos = vec3(model * vec4(aPos, 1.0));
-        Normal = mat3(transpose(inverse(model))) * aNormal;
-        TexCoord = aTexCoord;
-        gl_Position = projection * view * vec4(FragPos, 1.0);
-    }
-)";
-
-const char* fragmentSource = R"(
-    #version 330 core
-    out vec4 FragColor;
-
-    in vec3 FragPos;
-    in vec3 Normal;
-    in vec2 TexCoord;
-
-    uniform sampler2D texture1;
-
-    void main() {
-        vec3 color = texture(texture1, TexCoord).rgb;
-        FragColor = vec4(color, 1.0);
-    }
-)";
-
-
-struct Vertex { float x, y, z; };
-
-struct TextureCoord { float u, v; };
-
-struct Normal { float nx, ny, nz; };
-
-struct Face {
-    vector<int> vertexIndices;
-    vector<int> texCoordIndices;
-    vector<int> normalIndices;
-};
-
-struct ObjModel {
-    vector<Vertex> vertices;
-    vector<TextureCoord> texCoords;
-    vector<Normal> normals;
-    vector<Face> faces;
-};
-
-ObjModel loadObjModel(const std::string& filePath) {
-    ObjModel model;
-    ifstream file(filePath);
-    if (!file.is_open()) {
-        std::cerr << "Nie można otworzyć pliku: " << filePath << std::endl;
-        return model;
-    }
-
-    string line;
-    while (std::getline(file, line)) {
-        std::istringstream lineStream(line);
-        std::string type;
-        lineStream >> type;
-
-        if (type == "v") {
-            Vertex vertex;
-            lineStream >> vertex.x >> vertex.y >> vertex.z;
-            model.vertices.push_back(vertex);
-        }
-        else if (type == "vt") { 
-            TextureCoord texCoord;
-            lineStream >> texCoord.u >> texCoord.v;
-            model.texCoords.push_back(texCoord);
-        }
-        else if (type == "vn") {
-            Normal normal;
-            lineStream >> normal.nx >> normal.ny >> normal.nz;
-            model.normals.push_back(normal);
-        }
-        else if (type == "f") {
-            Face face;
-            std::string vertexData;
-            while (lineStream >> vertexData) {
-                std::istringstream vertexStream(vertexData);
-                std::string vertexIndex, texCoordIndex, normalIndex;
-                if (std::getline(vertexStream, vertexIndex, '/') &&
-                    std::getline(vertexStream, texCoordIndex, '/') &&
-                    std::getline(vertexStream, normalIndex)) {
-                    face.vertexIndices.push_back(std::stoi(vertexIndex) - 1);
-                    face.texCoordIndices.push_back(std::stoi(texCoordIndex) - 1);
-                    face.normalIndices.push_back(std::stoi(normalIndex) - 1);
-                }
-            }
-            model.faces.push_back(face);
-        }
-    }
-
-    file.close();
-    return model;
-}
-
 void check_Shader(GLuint shader, const string& shaderType) {
     GLint status;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
@@ -147,10 +49,12 @@ GLuint createShader(GLenum shaderType, const char* source) {
     return shader;
 }
 
-bool LoadTexture(const char* filePath, unsigned int& textureID,
+// Piksele wysyła UploadScheduler w kolejnych klatkach, do tego czasu tekstura jest pusta
+bool LoadTexture(const char* filePath, TextureHandle& texture, GpuResources& resources, UploadScheduler& uploads,
     GLenum wrapS = GL_REPEAT, GLenum wrapT = GL_REPEAT,
     GLenum minFilter = GL_LINEAR, GLenum magFilter = GL_LINEAR) {
-    glGenTextures(1, &textureID); 
+    texture = resources.createTexture(filePath);
+    GLuint textureID = resources.get(texture);
     glBindTexture(GL_TEXTURE_2D, textureID); 
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
@@ -160,10 +64,10 @@ bool LoadTexture(const char* filePath, unsigned int& textureID,
 
     int width, height, nrChannels;
     stbi_set_flip_vertically_on_load(true); 
-    unsigned char* data = stbi_load(filePath, &width, &height, &nrChannels, 0);
+    unsigned char* data = stbi_load(filePath, &width, &height, &nrChannels, 3);
     if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        uploads.queueTexture(textureID, width, height, GL_RGB, GL_RGB, 3, data, true);
+        resources.setBytes(texture, (size_t)width * height * 3 * 4 / 3);
         stbi_image_free(data);
         return true;
     }
@@ -176,7 +80,7 @@ bool LoadTexture(const char* filePath, unsigned int& textureID,
 
 
 
-int main() {
+int main(int argc, char** argv) {
     sf::ContextSettings settings;
     settings.depthBits = 24;
     settings.stencilBits = 8;
@@ -195,68 +99,88 @@ int main() {
     float cameraSpeed = 0.1f;
     float sensitivity = 0.08f;
     float obrot = 0.0f;
-    sf::Vector2i lastMousePos = sf::Mouse::getPosition(window);
+    sf::Vector2i lastMousePos;
+    bool firstMouse = true;
 
 
     glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f); 
 
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, nullptr);
-    glCompileShader(vertexShader);
-    check_Shader(vertexShader, "Vertex");
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, nullptr);
-    glCompileShader(fragmentShader);
-    check_Shader(fragmentShader, "Fragment");
+    // Shadery w plikach shaders/ - po zapisaniu zmian kompilują się w tle, a program podmieniany jest po udanym linkowaniu
+    AsyncShaderCompiler shaderCompiler;
+    ShaderFileWatcher shaderWatcher("shaders");
+    vector<ProgramDesc> shaderBatch(1);
+    vector<GLuint> programs;
+    if (!readShaderFile("shaders/model.vert", shaderBatch[0].vertexSource) ||
+        !readShaderFile("shaders/model.frag", shaderBatch[0].fragmentSource))
+        return -1;
+    shaderCompiler.submit(shaderBatch);
+    if (!shaderCompiler.finish(programs)) {
+        cerr << "Shader compilation failed\n";
+        return -1;
+    }
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    // Obiekty GL za uchwytami rejestru; program podmieniony przy przeładowaniu usuwany jest dopiero,
+    // gdy GPU skończy klatkę, która go używała
+    GpuResources resources;
+    ProgramHandle program = resources.adoptProgram(programs[0], "model program");
+    GLuint shaderProgram = programs[0];
     glUseProgram(shaderProgram);
 
 
-    ObjModel model = loadObjModel("stół3.obj");
-    vector<float> vertices;
-    for (const auto& face : model.faces) {
-        for (size_t i = 0; i < face.vertexIndices.size(); ++i) {
-            const Vertex& vertex = model.vertices[face.vertexIndices[i]];
-            vertices.push_back(vertex.x);
-            vertices.push_back(vertex.y);
-            vertices.push_back(vertex.z);
-
-            if (!model.normals.empty()) {
-                const Normal& normal = model.normals[face.normalIndices[i]];
-                vertices.push_back(normal.nx);
-                vertices.push_back(normal.ny);
-                vertices.push_back(normal.nz);
-            }
-
-            if (!model.texCoords.empty()) {
-                const TextureCoord& texCoord = model.texCoords[face.texCoordIndices[i]];
-                vertices.push_back(texCoord.u);
-                vertices.push_back(texCoord.v);
+    // --stream: model większy niż pamięć konwertowany do pliku kawałków i stronicowany wokół kamery
+    // Bufory i tekstury wysyłane w kolejnych klatkach, najwyżej 4 MB na klatkę
+    UploadScheduler uploads;
+
+    ChunkStreamConfig streamConfig = parseChunkStreamArgs(argc, argv);
+    ObjChunkFile chunkFile;
+    unique_ptr<ChunkPager> chunkPager;
+    if (!streamConfig.objPath.empty()) {
+        const string chunkPath = streamConfig.objPath + ".chunks";
+        string error;
+        if (!chunkFile.open(chunkPath, error)) {
+            ThreadPool meshPool;
+            ObjStreamStats stats;
+            if (!convertObjToChunks(streamConfig.objPath, chunkPath, streamConfig.options, meshPool, stats, error) ||
+                !chunkFile.open(chunkPath, error)) {
+                cerr << "Stream: " << error << "\n";
+                return -1;
             }
+            cout << "Stream: " << stats.triangles << " triangles -> " << stats.chunks << " chunks in " << stats.seconds
+                << " s, peak " << (stats.peakBytes >> 20) << " MB\n";
         }
+        chunkPager.reset(new ChunkPager(chunkFile, uploads, streamConfig.loadRadius, streamConfig.gpuBudget));
     }
 
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    ObjModel model = chunkPager ? ObjModel() : loadObjModel("stół3.obj");
+    // Model bez vn dostaje wygładzone normalne, inaczej strumień nie miałby miejsca na normalną
+    if (model.normals.empty()) {
+        ThreadPool meshPool;
+        generateObjNormals(model, meshPool);
+    }
+    vector<float> vertices = buildObjVertexStream(model);
+    const GLsizei vertexStride = (GLsizei)(objVertexStride(model) * sizeof(float));
+
+    VertexArrayHandle VAO = resources.createVertexArray("model vao");
+    BufferHandle VBO = resources.createBuffer("model vbo");
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(resources.get(VAO));
+    glBindBuffer(GL_ARRAY_BUFFER, resources.get(VBO));
+    GLsizei modelVertexCount = 0;
+    uploads.queueBuffer(resources.get(VBO), vertices.data(), vertices.size() * sizeof(float), GL_STATIC_DRAW,
+        [&]() { modelVertexCount = (GLsizei)(vertices.size() * sizeof(float) / vertexStride); });
+    resources.setBytes(VBO, vertices.size() * sizeof(float));
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
     glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // Bez vt atrybut UV zostaje wyłączony (wartość domyślna 0, 0)
+    if (!model.texCoords.empty()) {
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertexStride, (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+    }
 
 
     glBindVertexArray(0);
@@ -269,90 +193,214 @@ int main() {
     GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
 
     GLuint TexCoord = glGetAttribLocation(shaderProgram, "aTexCoord");
-    glEnableVertexAttribArray(TexCoord);
-    glVertexAttribPointer(TexCoord, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
+    if (!model.texCoords.empty()) {
+        glEnableVertexAttribArray(TexCoord);
+        glVertexAttribPointer(TexCoord, 2, GL_FLOAT, GL_FALSE, vertexStride, (void*)(6 * sizeof(GLfloat)));
+    }
 
-    GLuint texture1;
-    if (!LoadTexture("metal.jpg", texture1)) {
+    TextureHandle texture1;
+    if (!LoadTexture("metal.jpg", texture1, resources, uploads)) {
         std::cerr << "Failed to load texture!" << std::endl;
         return -1;
     }
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
+    glBindTexture(GL_TEXTURE_2D, resources.get(texture1));
     GLuint textureLoc = glGetUniformLocation(shaderProgram, "texture1");
     glUniform1i(textureLoc, 0); 
+    GLint uniView = glGetUniformLocation(shaderProgram, "view");
+    GLint uniModel = glGetUniformLocation(shaderProgram, "model");
+    GLint uniAlpha = glGetUniformLocation(shaderProgram, "alpha");
+
+    // Program, VAO, tekstura i niezmienione uniformy (projection, model) wysyłane tylko przy faktycznej zmianie
+    GlStateCache state;
+
+    // --instances N: siatka N x N kopii modelu przez kolejkę rysowania, wypełnianą równolegle;
+    // --transparent K: co K-ta kopia półprzezroczysta (rysowana po nieprzezroczystych, od tyłu)
+    const RenderQueueConfig queueConfig = parseRenderQueueArgs(argc, argv);
+    const float INSTANCE_SPACING = 3.0f;
+    ThreadPool queuePool(queueConfig.instances > 1 ? std::thread::hardware_concurrency() : 1);
+    RenderQueue renderQueue(queuePool.size(), 0.1f, 100.0f);
+
 
+    // Strefy profilera; F12 zapisuje 120 klatek do trace.json (chrome://tracing)
+    Profiler profiler;
+    const int inputZone = profiler.zone("input");
+    const int uploadZone = profiler.zone("upload");
+    const int drawZone = profiler.zone("draw");
+    const int sceneGpuZone = profiler.zone("scene", true);
+    const int presentZone = profiler.zone("present");
+
+    // --record/--replay plik: wejście nagrywane lub odtwarzane klatka po klatce, --fixed-step stały krok
+    InputState input(parseInputArgs(argc, argv), { sf::Keyboard::W, sf::Keyboard::S, sf::Keyboard::A, sf::Keyboard::D,
+        sf::Keyboard::Q, sf::Keyboard::E, sf::Keyboard::Right, sf::Keyboard::Left });
 
     bool running = true;
     while (running) {
+        profiler.beginFrame();
+
+        if (shaderWatcher.changed() &&
+            readShaderFile("shaders/model.vert", shaderBatch[0].vertexSource) &&
+            readShaderFile("shaders/model.frag", shaderBatch[0].fragmentSource))
+            shaderCompiler.submit(shaderBatch);
+
+        vector<GLuint> reloadedPrograms;
+        if (shaderCompiler.poll(reloadedPrograms)) {
+            state.forgetProgram(shaderProgram);
+            resources.release(program);
+            program = resources.adoptProgram(reloadedPrograms[0], "model program");
+            shaderProgram = reloadedPrograms[0];
+            state.useProgram(shaderProgram);
+            projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+            uniView = glGetUniformLocation(shaderProgram, "view");
+            uniModel = glGetUniformLocation(shaderProgram, "model");
+            uniAlpha = glGetUniformLocation(shaderProgram, "alpha");
+            state.uniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0);
+            cout << "Shaders reloaded\n";
+        }
 
         elapsed = clock.restart();
         float deltaTime = elapsed.asSeconds();
-        float cameraSpeed = 2.5f * deltaTime;
 
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) running = false;
-            if (event.type == sf::Event::KeyPressed) {
-                if (event.key.code == sf::Keyboard::Escape) running = false;
+        {
+            CpuProfileScope inputScope(profiler, inputZone);
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                input.handleEvent(event);
+                if (event.type == sf::Event::Closed) running = false;
+                if (event.type == sf::Event::KeyPressed) {
+                    if (event.key.code == sf::Keyboard::Escape) running = false;
+                    if (event.key.code == sf::Keyboard::F12) profiler.captureTrace("trace.json", 120);
+                }
             }
-        }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::W)) cameraPos += cameraSpeed * cameraFront;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) cameraPos -= cameraSpeed * cameraFront;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::A)) cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))  cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Q))  cameraPos.y += cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::E))  cameraPos.y -= cameraSpeed;
+            // Ruch kamery tylko ze stanu wejścia - przy odtwarzaniu pochodzi z nagrania
+            if (!input.update(window, deltaTime)) running = false;
+            float cameraSpeed = 2.5f * input.deltaTime();
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))  obrot -= cameraSpeed;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))  obrot += cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::W)) cameraPos += cameraSpeed * cameraFront;
+            if (input.isKeyPressed(sf::Keyboard::S)) cameraPos -= cameraSpeed * cameraFront;
+            if (input.isKeyPressed(sf::Keyboard::A)) cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::D))  cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::Q))  cameraPos.y += cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::E))  cameraPos.y -= cameraSpeed;
 
+            if (input.isKeyPressed(sf::Keyboard::Right))  obrot -= cameraSpeed;
+            if (input.isKeyPressed(sf::Keyboard::Left))  obrot += cameraSpeed;
 
-        sf::Vector2i mousePos = sf::Mouse::getPosition(window);
-        float xOffset = (mousePos.x - lastMousePos.x) * sensitivity;
-        float yOffset = (lastMousePos.y - mousePos.y) * sensitivity;
-        lastMousePos = mousePos;
 
-        yaw += xOffset;
-        pitch += yOffset;
+            sf::Vector2i mousePos = input.mousePosition();
+            if (firstMouse) {
+                lastMousePos = mousePos;
+                firstMouse = false;
+            }
+            float xOffset = (mousePos.x - lastMousePos.x) * sensitivity;
+            float yOffset = (lastMousePos.y - mousePos.y) * sensitivity;
+            lastMousePos = mousePos;
 
+            yaw += xOffset;
+            pitch += yOffset;
 
-        if (pitch > 89.0f) pitch = 89.0f;
-        if (pitch < -89.0f) pitch = -89.0f;
 
+            if (pitch > 89.0f) pitch = 89.0f;
+            if (pitch < -89.0f) pitch = -89.0f;
 
-        cameraFront.x = cos(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
-        cameraFront.y = sin(glm::radians(pitch));
-        cameraFront.z = sin(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
-        cameraFront = glm::normalize(cameraFront);
 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(proj));
+            cameraFront.x = cos(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
+            cameraFront.y = sin(glm::radians(pitch));
+            cameraFront.z = sin(glm::radians(yaw + obrot)) * cos(glm::radians(pitch));
+            cameraFront = glm::normalize(cameraFront);
+        }
 
+        {
+            CpuProfileScope uploadScope(profiler, uploadZone);
+            uploads.update();
+        }
 
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        GLint uniView = glGetUniformLocation(shaderProgram, "view");
-        glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view));
+        {
+            CpuProfileScope drawScope(profiler, drawZone);
+            GpuProfileScope sceneScope(profiler, sceneGpuZone);
+            state.useProgram(shaderProgram);
+            state.uniformMatrix4fv(projectionLoc, 1, glm::value_ptr(proj));
 
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+            state.uniformMatrix4fv(uniView, 1, glm::value_ptr(view));
 
-        glBindVertexArray(VAO);
-        glm::mat4 model = glm::mat4(1.0f);
-        GLint uniModel = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(model));
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 3);
 
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+            if (chunkPager) {
+                state.bindTexture(0, GL_TEXTURE_2D, resources.get(texture1));
+                state.bindVertexArray(resources.get(VAO));
+                glm::mat4 model = glm::mat4(1.0f);
+                state.uniformMatrix4fv(uniModel, 1, glm::value_ptr(model));
+                chunkPager->update(cameraPos, input.deltaTime());
+                chunkPager->draw();
+                // Pager wiąże VAO kawałków sam
+                state.invalidateBindings();
+            }
+            else {
+                renderQueue.begin();
+                // Do czasu wysłania bufora modelu nie ma czego rysować
+                if (modelVertexCount > 0) {
+                    const int side = queueConfig.instances;
+                    DrawCommand base;
+                    base.program = shaderProgram;
+                    base.vertexArray = resources.get(VAO);
+                    base.texture = resources.get(texture1);
+                    base.modelLocation = uniModel;
+                    base.alphaLocation = uniAlpha;
+                    base.count = modelVertexCount;
+                    queuePool.parallelFor((size_t)side * side, 64, [&](size_t begin, size_t end, unsigned thread) {
+                        for (size_t i = begin; i < end; ++i) {
+                            glm::vec3 position((float)(i % side) - (side - 1) * 0.5f, 0.0f, (float)(i / side) - (side - 1) * 0.5f);
+                            position *= INSTANCE_SPACING;
+                            DrawCommand command = base;
+                            glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+                            std::memcpy(command.model, glm::value_ptr(model), sizeof(command.model));
+                            bool transparent = queueConfig.transparentEvery > 0 && i % queueConfig.transparentEvery == 0;
+                            command.alpha = transparent ? 0.5f : 1.0f;
+                            renderQueue.push(thread, transparent ? RenderLayer::Transparent : RenderLayer::Opaque,
+                                glm::dot(position - cameraPos, cameraFront), command);
+                        }
+                    });
+                }
+                renderQueue.sort();
+                renderQueue.submit(state);
+            }
+        }
 
-        float fps = 1.0f / deltaTime;
-        window.display();
+        {
+            CpuProfileScope presentScope(profiler, presentZone);
+            window.display();
+        }
+        resources.endFrame();
+
+        profiler.endFrame();
+        state.endFrame();
+        if (profiler.reportDue()) {
+            profiler.report(cout);
+            resources.report(cout);
+            state.report(cout);
+            if (!chunkPager)
+                renderQueue.report(cout);
+            const UploadStats& upload = uploads.statistics();
+            cout << "Upload: " << (upload.frameBytes >> 10) << " KB last frame, max " << (upload.maxFrameBytes >> 10) << " KB / "
+                << upload.maxFrameMilliseconds << " ms per frame, " << (upload.pendingBytes >> 10) << " KB pending\n";
+            if (chunkPager) {
+                const ChunkPagerStats& stream = chunkPager->statistics();
+                cout << "Stream: " << stream.residentCells << " cells, " << stream.residentChunks << " chunks resident ("
+                    << (stream.residentBytes >> 20) << " MB), I/O queue " << stream.queueDepth << ", stall frames "
+                    << stream.stallFrames << ", evictions " << stream.evictions << "\n";
+            }
+        }
     }
 
-    glDeleteProgram(shaderProgram);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    resources.release(program);
+    resources.release(texture1);
+    resources.release(VAO);
+    resources.release(VBO);
 
     return 0;
 }
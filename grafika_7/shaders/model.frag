@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+
+uniform sampler2D texture1;
+uniform float alpha = 1.0;
+
+void main() {
+    vec3 color = texture(texture1, TexCoord).rgb;
+    FragColor = vec4(color, alpha);
+}
@@ -1,11 +1,44 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_primitives.h>
+#include "../common/game_loop.h"
+#include "../common/batch2d.h"
+#include "../common/entities2d.h"
+#include "../common/layers2d.h"
+
+// Kwadraty do testu wydajnosci: --squares N, --immediate rysuje kazdy osobnym al_draw_filled_rectangle.
+// Pozycje i predkosci w tablicach SoA (Entities2D), aktualizowane wektorowo na wszystkich watkach.
+const float BENCH_SQUARE_SIZE = 4;
 
 int main(int argc, char** argv)
 {
+    int bench_squares = 0;
+    bool immediate = false;
+    // --poll: dawna petla (al_rest + najwyzej jedno zdarzenie na klatke) do porownania, --stats: raport co 2 s
+    bool poll_loop = false;
+    bool show_stats = false;
+    // --full-redraw: wszystkie warstwy dynamiczne i caly ekran skladany co klatke, jak przed warstwami
+    bool full_redraw = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--squares") == 0 && i + 1 < argc)
+            bench_squares = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--immediate") == 0)
+            immediate = true;
+        else if (strcmp(argv[i], "--poll") == 0)
+            poll_loop = true;
+        else if (strcmp(argv[i], "--stats") == 0)
+            show_stats = true;
+        else if (strcmp(argv[i], "--full-redraw") == 0)
+            full_redraw = true;
+    }
+
     ALLEGRO_DISPLAY* display = NULL;
     ALLEGRO_EVENT_QUEUE* event_queue = NULL;
+    ALLEGRO_TIMER* timer = NULL;
 
     al_init_primitives_addon();
 
@@ -14,6 +47,10 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // Domyslnie vsync zamiast al_rest; --uncapped wylacza synchronizacje (1 - wymuszone wlaczenie, 2 - wylaczenie)
+    PresentMode present_mode = parsePresentMode(argc, argv);
+    al_set_new_display_option(ALLEGRO_VSYNC, present_mode == PresentMode::VSync ? 1 : 2, ALLEGRO_SUGGEST);
+
     display = al_create_display(640, 480);
     if (!display) {
         fprintf(stderr, "failed to create display!\n");
@@ -27,39 +64,216 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // Petla sterowana timerem: watek spi w al_wait_for_event do tiku albo wejscia. Bez vsync (--uncapped)
+    // timer nie jest tworzony i klatki rysowane sa bez czekania.
+    if (!poll_loop && present_mode == PresentMode::VSync) {
+        timer = al_create_timer(1.0 / 60.0);
+        if (!timer) {
+            fprintf(stderr, "failed to create timer!\n");
+            al_destroy_event_queue(event_queue);
+            al_destroy_display(display);
+            return -1;
+        }
+        al_register_event_source(event_queue, al_get_timer_event_source(timer));
+    }
+
     al_register_event_source(event_queue, al_get_display_event_source(display));
+    // Klawiatura i mysz tylko do pomiaru opoznienia od zdarzenia wejscia do wyswietlenia klatki
+    if (al_install_keyboard())
+        al_register_event_source(event_queue, al_get_keyboard_event_source());
+    if (al_install_mouse())
+        al_register_event_source(event_queue, al_get_mouse_event_source());
 
     bool running = true;
     float square_x = 50;
     float square_y = 350;
-    float square_speed = 2;
+    // Piksele na sekunde - dawne 2 px na klatke przy ~60 FPS
+    float square_speed = 120;
+    float previous_square_x = square_x;
+    float draw_x = square_x;
+
+    Entities2D squares;
+    squares.resize(bench_squares);
+    std::vector<ALLEGRO_COLOR> square_colors(bench_squares);
+    for (int i = 0; i < bench_squares; ++i) {
+        squares.x[i] = (float)(rand() % (640 - (int)BENCH_SQUARE_SIZE));
+        squares.y[i] = (float)(rand() % (480 - (int)BENCH_SQUARE_SIZE));
+        squares.vx[i] = (float)(rand() % 200 - 100);
+        squares.vy[i] = (float)(rand() % 200 - 100);
+        square_colors[i] = al_map_rgb(55 + rand() % 200, 55 + rand() % 200, 55 + rand() % 200);
+    }
+    ThreadPool pool;
+    if (bench_squares > 0) {
+        printf("%d squares, %s update on %u threads\n", bench_squares, Entities2D::simdPath(), pool.size());
+    }
+
+    // Ruch w stalych krokach 1/60 s niezaleznie od FPS, kwadrat rysowany w pozycji interpolowanej miedzy krokami
+    FixedTimestep timestep(1.0 / 60.0);
+    double last_time = al_get_time();
+
+    // Wszystkie ksztalty ida przez Batch2D - jedno al_draw_indexed_prim na stan zamiast wywolania na ksztalt
+    Batch2D batch;
+    int immediate_calls = 0;
+
+    // Scena w warstwach: statyczne ksztalty rysowane raz do bitmapy, kwadraty testowe i czerwony kwadrat
+    // odswiezane tylko tam, gdzie sie zmienily
+    LayerStack layers(640, 480, al_map_rgb(0, 0, 0));
+    int squares_layer = layers.addLayer(LayerKind::Dynamic, [&](Batch2D& layer_batch) {
+        if (immediate) {
+            for (int i = 0; i < bench_squares; ++i) {
+                al_draw_filled_rectangle(squares.x[i], squares.y[i], squares.x[i] + BENCH_SQUARE_SIZE, squares.y[i] + BENCH_SQUARE_SIZE, square_colors[i]);
+            }
+            immediate_calls += bench_squares;
+        }
+        else if (bench_squares > 0) {
+            // Wierzcholki zapisywane prosto z tablic SoA do bufora wsadu, kawalkami na watkach puli
+            Batch2D::QuadSpan span = layer_batch.appendQuads(bench_squares);
+            pool.parallelFor(bench_squares, Entities2D::CHUNK, [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; ++i) {
+                    Batch2D::setRect(span, i, squares.x[i], squares.y[i], squares.x[i] + BENCH_SQUARE_SIZE, squares.y[i] + BENCH_SQUARE_SIZE, square_colors[i]);
+                }
+            });
+        }
+    });
+    int static_layer = layers.addLayer(LayerKind::Static, [](Batch2D& layer_batch) {
+        layer_batch.fillRect(200, 50, 300, 120, al_map_rgb(0, 0, 255));
+        layer_batch.line(350, 50, 450, 150, al_map_rgb(0, 255, 0), 5);
+        layer_batch.triangle(480, 50, 540, 150, 600, 50, al_map_rgb(255, 255, 0), 5);
+    });
+    int square_layer = layers.addLayer(LayerKind::Dynamic, [&](Batch2D& layer_batch) {
+        layer_batch.fillRect(draw_x, square_y, draw_x + 100, square_y + 100, al_map_rgb(255, 0, 0));
+    });
+    if (full_redraw)
+        layers.setKind(static_layer, LayerKind::Dynamic);
+
+    double report_time = last_time;
+    double update_seconds = 0;
+    double draw_seconds = 0;
+    int report_frames = 0;
+    double redrawn_sum = 0;
+    clock_t report_cpu = clock();
+    double input_time = -1;
+    double latency_sum = 0;
+    double latency_max = 0;
+    int latency_count = 0;
+
+    bool redraw = true;
+    auto handle_event = [&](const ALLEGRO_EVENT& event) {
+        switch (event.type) {
+        case ALLEGRO_EVENT_DISPLAY_CLOSE:
+            running = false;
+            break;
+        case ALLEGRO_EVENT_TIMER:
+            redraw = true;
+            break;
+        case ALLEGRO_EVENT_KEY_DOWN:
+        case ALLEGRO_EVENT_MOUSE_AXES:
+        case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
+            // Najstarsze wejscie, ktore jeszcze nie trafilo na ekran
+            if (input_time < 0)
+                input_time = event.any.timestamp;
+            break;
+        }
+    };
+
+    const char* loop_name = poll_loop ? "poll" : timer ? "timer" : "uncapped";
+    if (timer)
+        al_start_timer(timer);
 
     while (running) {
-        al_clear_to_color(al_map_rgb(0, 0, 0));
+        ALLEGRO_EVENT event;
+        if (poll_loop) {
+            al_rest(0.016);
+            if (al_get_next_event(event_queue, &event))
+                handle_event(event);
+            redraw = true;
+        }
+        else {
+            // Wszystkie zalegle zdarzenia na raz - seria ruchow myszy nie opoznia zamkniecia okna
+            if (timer) {
+                al_wait_for_event(event_queue, &event);
+                handle_event(event);
+            }
+            while (al_get_next_event(event_queue, &event))
+                handle_event(event);
+            if (!timer)
+                redraw = true;
+        }
+        // Kilka zaleglych tikow daje jedna klatke; FixedTimestep i tak nadrabia symulacje.
+        // Petla --poll rysuje w kazdym obiegu jak dawniej, niezaleznie od kolejki
+        if (!running || !redraw || (!poll_loop && !al_is_event_queue_empty(event_queue)))
+            continue;
+        redraw = false;
 
-        al_draw_filled_rectangle(200, 50, 300, 120, al_map_rgb(0, 0, 255));
-        al_draw_line(350, 50, 450, 150, al_map_rgb(0, 255, 0), 5);
-        al_draw_triangle(480, 50, 540, 150, 600, 50, al_map_rgb(255, 255, 0), 5);
-        al_draw_filled_rectangle(square_x, square_y, square_x + 100, square_y + 100, al_map_rgb(255, 0, 0));
+        double now = al_get_time();
+        int steps = timestep.advance(now - last_time);
+        last_time = now;
+        for (int i = 0; i < steps; ++i) {
+            previous_square_x = square_x;
+            square_x += square_speed * timestep.step();
 
-        square_x += square_speed;
+            if (square_x + 100 >= 640 || square_x <= 0) {
+                square_speed = -square_speed;
+            }
 
-        if (square_x + 100 >= 640 || square_x <= 0) {
-            square_speed = -square_speed;
+            squares.update(timestep.step(), 0, 0, 640 - BENCH_SQUARE_SIZE, 480 - BENCH_SQUARE_SIZE, &pool);
         }
+        draw_x = interpolate(previous_square_x, square_x, timestep.alpha());
+        double draw_start = al_get_time();
+
+        if (full_redraw)
+            layers.markDirty();
+        if (bench_squares > 0)
+            layers.markChanged(squares_layer);
+        layers.markChanged(square_layer, draw_x, square_y, draw_x + 100, square_y + 100);
+        layers.render(batch);
+        redrawn_sum += layers.redrawnFraction();
 
         al_flip_display();
-        al_rest(0.016);
 
-  
-        ALLEGRO_EVENT event;
-        if (al_get_next_event(event_queue, &event)) {
-            if (event.type == ALLEGRO_EVENT_DISPLAY_CLOSE) {
-                running = false;
+        // Raport co 2 s: czas aktualizacji (kroki symulacji), rysowania z flip i liczba wywolan rysujacych,
+        // opoznienie wejscie-ekran oraz zuzycie procesora (czas CPU procesu / czas rzeczywisty)
+        double frame_end = al_get_time();
+        update_seconds += draw_start - now;
+        draw_seconds += frame_end - draw_start;
+        ++report_frames;
+        if (input_time >= 0) {
+            double latency = frame_end - input_time;
+            latency_sum += latency;
+            if (latency > latency_max)
+                latency_max = latency;
+            ++latency_count;
+            input_time = -1;
+        }
+        if ((bench_squares > 0 || show_stats) && frame_end - report_time >= 2.0) {
+            clock_t cpu_now = clock();
+            printf("[%s loop] %.1f FPS, CPU %.0f%%, input-to-present avg %.2f max %.2f ms (%d inputs), draw %.3f ms, redrawn %.1f%% of screen\n",
+                loop_name, report_frames / (frame_end - report_time),
+                100.0 * (double)(cpu_now - report_cpu) / CLOCKS_PER_SEC / (frame_end - report_time),
+                latency_count > 0 ? latency_sum * 1000.0 / latency_count : 0.0, latency_max * 1000.0, latency_count,
+                draw_seconds * 1000.0 / report_frames, redrawn_sum * 100.0 / report_frames);
+            if (bench_squares > 0) {
+                printf("%d squares (%s): %.1f FPS, update %.3f ms, draw %.3f ms, %.1f draw calls/frame\n",
+                    bench_squares, immediate ? "immediate" : "batched", report_frames / (frame_end - report_time),
+                    update_seconds * 1000.0 / report_frames, draw_seconds * 1000.0 / report_frames,
+                    (double)(batch.drawCalls() + immediate_calls) / report_frames);
             }
+            report_cpu = cpu_now;
+            latency_sum = 0;
+            latency_max = 0;
+            latency_count = 0;
+            report_time = frame_end;
+            update_seconds = 0;
+            draw_seconds = 0;
+            report_frames = 0;
+            redrawn_sum = 0;
+            immediate_calls = 0;
+            batch.resetStats();
         }
     }
 
+    if (timer)
+        al_destroy_timer(timer);
     al_destroy_event_queue(event_queue);
     al_destroy_display(display);
 